@@ -0,0 +1,175 @@
+#ifndef _TKLB_ALLOC_STATS
+#define _TKLB_ALLOC_STATS
+
+#include "../types/TTypes.hpp"
+#include "../util/TThreadTag.hpp"
+
+#ifndef TKLB_NO_STDLIB
+
+#include <atomic>
+
+namespace tklb { namespace memory {
+
+	/**
+	 * @brief Always on allocation accounting per allocator name.
+	 * @details Allocators report to the entry of their NAME when TKLB_ALLOC_STATS
+	 *          is defined. Every counter is a relaxed atomic, so recording costs a
+	 *          few uncontended atomic adds and never locks. Names are registered
+	 *          once into a fixed table, lookups are cached per NAME type.
+	 *
+	 *          snapshot() can be called from any thread at any time,
+	 *          the counters of an entry are read one by one so they might be
+	 *          off by the allocations happening during the read.
+	 */
+	class AllocStats {
+	public:
+		using Size = SizeT;
+
+		static constexpr Size Buckets = 32;		///< Histogram buckets, one per power of two
+		static constexpr Size MaxNames = 64;	///< Further names share the overflow entry
+
+		struct Snapshot {
+			const char* name = nullptr;
+			Size allocations = 0;
+			Size frees = 0;
+			Size bytes = 0;					///< Currently allocated
+			Size peak = 0;					///< Highest bytes so far
+			Size audioAllocations = 0;		///< Allocations from threads tagged ThreadTag::Audio
+			Size audioFrees = 0;
+			Size histogram[Buckets] = { };	///< Allocation count for sizes in [2^i, 2^(i+1))
+
+			/**
+			 * @brief Allocations not freed yet, a leak if it's not 0 at shutdown
+			 */
+			Size outstanding() const { return allocations - frees; }
+		};
+
+	private:
+		using Counter = std::atomic<Size>;
+		static constexpr auto Relaxed = std::memory_order_relaxed;
+
+		std::atomic<const char*> mName = { nullptr };
+		Counter mAllocations = { 0 };
+		Counter mFrees = { 0 };
+		Counter mBytes = { 0 };
+		Counter mPeak = { 0 };
+		Counter mAudioAllocations = { 0 };
+		Counter mAudioFrees = { 0 };
+		Counter mHistogram[Buckets] = { };
+
+		static AllocStats* table() {
+			static AllocStats entries[MaxNames];
+			return entries;
+		}
+
+		static AllocStats& overflow() {
+			static AllocStats entry;
+			return entry;
+		}
+
+		static bool equal(const char* a, const char* b) {
+			if (a == b) { return true; }
+			while (*a != '\0' && *a == *b) { a++; b++; }
+			return *a == *b;
+		}
+
+		static Size bucket(Size bytes) {
+			Size index = 0;
+			while (1 < bytes && index < Buckets - 1) {
+				bytes >>= 1;
+				index++;
+			}
+			return index;
+		}
+
+		static bool audio() { return ThreadTagScope::current() == ThreadTag::Audio; }
+
+	public:
+		AllocStats() = default;
+		AllocStats(const AllocStats&) = delete;
+		AllocStats& operator=(const AllocStats&) = delete;
+
+		/**
+		 * @brief Looks up or registers the entry for a name. Lock free.
+		 * @param name Needs to outlive the stats, usually a literal
+		 */
+		static AllocStats& find(const char* name) {
+			AllocStats* entries = table();
+			for (Size i = 0; i < MaxNames; i++) {
+				const char* current = entries[i].mName.load(std::memory_order_acquire);
+				if (current == nullptr) {
+					if (entries[i].mName.compare_exchange_strong(current, name, std::memory_order_acq_rel)) {
+						return entries[i];
+					}
+					// current now holds the name another thread registered first
+				}
+				if (equal(current, name)) { return entries[i]; }
+			}
+			return overflow(); // ! Too many names
+		}
+
+		/**
+		 * @brief Entry for an allocator name type, only the first call searches
+		 */
+		template <class NAME>
+		static AllocStats& of() {
+			static AllocStats& entry = find(NAME::Name);
+			return entry;
+		}
+
+		void allocated(Size bytes) {
+			mAllocations.fetch_add(1, Relaxed);
+			mHistogram[bucket(bytes)].fetch_add(1, Relaxed);
+			const Size now = mBytes.fetch_add(bytes, Relaxed) + bytes;
+			Size peak = mPeak.load(Relaxed);
+			while (peak < now && !mPeak.compare_exchange_weak(peak, now, Relaxed)) { }
+			if (audio()) { mAudioAllocations.fetch_add(1, Relaxed); }
+		}
+
+		void freed(Size bytes) {
+			mFrees.fetch_add(1, Relaxed);
+			mBytes.fetch_sub(bytes, Relaxed);
+			if (audio()) { mAudioFrees.fetch_add(1, Relaxed); }
+		}
+
+		Snapshot snapshot() const {
+			Snapshot result;
+			result.name = mName.load(std::memory_order_acquire);
+			result.allocations = mAllocations.load(Relaxed);
+			result.frees = mFrees.load(Relaxed);
+			result.bytes = mBytes.load(Relaxed);
+			result.peak = mPeak.load(Relaxed);
+			result.audioAllocations = mAudioAllocations.load(Relaxed);
+			result.audioFrees = mAudioFrees.load(Relaxed);
+			for (Size i = 0; i < Buckets; i++) {
+				result.histogram[i] = mHistogram[i].load(Relaxed);
+			}
+			return result;
+		}
+
+		/**
+		 * @brief Snapshot of every registered name, safe to call from a monitoring thread
+		 * @param out Array with room for max snapshots
+		 * @return Number of snapshots written
+		 */
+		static Size snapshot(Snapshot* out, Size max) {
+			Size count = 0;
+			AllocStats* entries = table();
+			for (Size i = 0; i < MaxNames && count < max; i++) {
+				if (entries[i].mName.load(std::memory_order_acquire) == nullptr) { break; }
+				out[count++] = entries[i].snapshot();
+			}
+			AllocStats& rest = overflow();
+			if (count < max && rest.mAllocations.load(Relaxed) != 0) {
+				out[count] = rest.snapshot();
+				out[count++].name = "Overflow";
+			}
+			return count;
+		}
+	};
+
+} } // namespace tklb::memory
+
+#endif // TKLB_NO_STDLIB
+
+#endif // _TKLB_ALLOC_STATS
@@ -3,6 +3,7 @@
 
 #include "./TMemory.hpp"	// tklb_malloc
 #include "../util/TLimits.hpp"
+#include "../util/TTraits.hpp"
 
 #ifdef TKLB_USE_PROFILER
 	#include "../util/TProfiler.hpp"
@@ -11,6 +12,18 @@
 	#define TKLB_PROFILER_FREE_L(ptr, name)
 #endif // TKLB_USE_PROFILER
 
+#if defined(TKLB_ALLOC_STATS) && !defined(TKLB_NO_STDLIB)
+	#include "./TAllocStats.hpp"
+	/**
+	 * @brief Account allocations per allocator name, see AllocStats
+	 */
+	#define TKLB_STATS_MALLOC(size, name)		tklb::memory::AllocStats::of<name>().allocated(size);
+	#define TKLB_STATS_FREE(ptr, size, name)	if (ptr != nullptr) { tklb::memory::AllocStats::of<name>().freed(size); }
+#else
+	#define TKLB_STATS_MALLOC(size, name)
+	#define TKLB_STATS_FREE(ptr, size, name)
+#endif // TKLB_ALLOC_STATS
+
 namespace tklb {
 	/**
 	 * @brief Names to the allocator are passed by type
@@ -38,14 +51,70 @@ namespace tklb {
 				if (AddressableElements < n) { return nullptr; } // ! allocation too large
 			#endif
 
+			TKLB_REALTIME_CHECK(Allocate);
 			const auto bytes = n * sizeof(T);
 			if (auto ptr = static_cast<T*>(tklb_malloc(bytes))) {
 				TKLB_PROFILER_MALLOC_L(ptr, bytes, NAME::Name)
+				TKLB_STATS_MALLOC(bytes, NAME)
+				return ptr;
+			}
+			return nullptr;
+		}
+
+		/**
+		* @brief Allocate aligned memory without padding it manually
+		* @param alignment Power of two
+		*/
+		T* allocate(SizeT n, SizeT alignment) const noexcept {
+			#ifndef TKLB_RELEASE
+				if (AddressableElements < n) { return nullptr; } // ! allocation too large
+			#endif
+
+			TKLB_REALTIME_CHECK(Allocate);
+			const auto bytes = n * sizeof(T);
+			if (auto ptr = static_cast<T*>(tklb_malloc_aligned(bytes, alignment))) {
+				TKLB_PROFILER_MALLOC_L(ptr, bytes, NAME::Name)
+				TKLB_STATS_MALLOC(bytes, NAME)
 				return ptr;
 			}
 			return nullptr;
 		}
 
+		/**
+		* @brief Resize memory from the unaligned allocate() and keep its contents.
+		*        Goes through tklb_realloc when available, which can grow in place,
+		*        allocates, copies and frees otherwise.
+		* @param n Current element count
+		* @param size New element count, not 0
+		*/
+		T* reallocate(T* ptr, SizeT n, SizeT size) const noexcept {
+			(void) n;
+			#ifdef TKLB_HAS_REALLOC
+				#ifndef TKLB_RELEASE
+					if (AddressableElements < size) { return nullptr; } // ! allocation too large
+				#endif
+
+				TKLB_REALTIME_CHECK(Allocate);
+				const auto bytes = size * sizeof(T);
+				if (auto moved = static_cast<T*>(tklb_realloc(ptr, bytes))) {
+					if (ptr != nullptr) { TKLB_PROFILER_FREE_L(ptr, NAME::Name) }
+					TKLB_STATS_FREE(ptr, n * sizeof(T), NAME)
+					TKLB_PROFILER_MALLOC_L(moved, bytes, NAME::Name)
+					TKLB_STATS_MALLOC(bytes, NAME)
+					return moved;
+				}
+				return nullptr;
+			#else
+				T* moved = allocate(size);
+				if (moved == nullptr) { return nullptr; }
+				if (ptr != nullptr) {
+					memory::copy(moved, ptr, (n < size ? n : size) * sizeof(T));
+					deallocate(ptr, n);
+				}
+				return moved;
+			#endif
+		}
+
 		/**
 		* @brief Free memory
 		*
@@ -54,11 +123,35 @@ namespace tklb {
 		*/
 		void deallocate(T* ptr, SizeT n) const noexcept {
 			(void) n;
+			if (ptr != nullptr) { TKLB_REALTIME_CHECK(Free); }
 			TKLB_PROFILER_FREE_L(ptr, NAME::Name)
+			TKLB_STATS_FREE(ptr, n * sizeof(T), NAME)
 			tklb_free(ptr);
 		}
 
+		/**
+		* @brief Free memory from the aligned allocate()
+		*/
+		void deallocate(T* ptr, SizeT n, SizeT alignment) const noexcept {
+			(void) n;
+			(void) alignment;
+			if (ptr != nullptr) { TKLB_REALTIME_CHECK(Free); }
+			TKLB_PROFILER_FREE_L(ptr, NAME::Name)
+			TKLB_STATS_FREE(ptr, n * sizeof(T), NAME)
+			tklb_free_aligned(ptr);
+		}
+
 	};
+
+	/**
+	 * @brief Whether an allocator can resize with reallocate(ptr, n, size)
+	 */
+	template <class ALLOCATOR, class = void>
+	struct CanReallocate : traits::Value<false> { };
+
+	template <class ALLOCATOR>
+	struct CanReallocate<ALLOCATOR, decltype(void(ALLOCATOR().reallocate(nullptr, SizeT(0), SizeT(0))))> :
+		traits::Value<true> { };
 }
 
 #endif // _TKLB_ALLOCATOR
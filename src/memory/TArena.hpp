@@ -0,0 +1,209 @@
+#ifndef _TKLB_ARENA
+#define _TKLB_ARENA
+
+#include "../types/TTypes.hpp"
+#include "./TNew.hpp"
+#include "./TMemory.hpp"
+#include "./TAllocator.hpp"
+#include "../util/TMath.hpp"
+#include "../util/TAssert.h"
+
+namespace tklb { namespace memory {
+
+	/**
+	 * @brief Bump allocator for short lived scratch memory.
+	 * @details Allocating only moves an offset forward, nothing is freed individually.
+	 *          Instead the offset is rewound to a marker or reset completely,
+	 *          typically once per audio block. Processing nodes can take their
+	 *          temporary buffers from a shared arena instead of each keeping them
+	 *          as members, so a large graph only needs as much scratch memory as
+	 *          the deepest chain of nodes alive at the same time.
+	 *
+	 *          Each thread can bind an arena, ArenaAllocator uses the bound one.
+	 *          Not thread safe, an arena belongs to one thread at a time.
+	 */
+	class Arena {
+		using Size = SizeT;
+		using Byte = unsigned char;
+
+		Byte* mMemory = nullptr;
+		Size mSize = 0;
+		Size mOffset = 0;
+		Size mPeak = 0;
+		bool mOwned = false;
+
+		static Arena*& bound() {
+			static thread_local Arena* arena = nullptr;
+			return arena;
+		}
+
+	public:
+		static constexpr Size DefaultAlignment = 2 * sizeof(void*);
+
+		using Marker = Size;
+
+		/**
+		 * @brief Rewinds the arena to where it was at construction
+		 */
+		class Scope {
+			Arena& mArena;
+			Marker mMarker;
+		public:
+			Scope(Arena& arena) : mArena(arena), mMarker(arena.mark()) { }
+			~Scope() { mArena.rewind(mMarker); }
+			Scope(const Scope&) = delete;
+			Scope& operator=(const Scope&) = delete;
+		};
+
+		/**
+		 * @brief Binds an arena to the calling thread for its lifetime,
+		 *        restores the previously bound one afterwards
+		 */
+		class Bind {
+			Arena* mPrevious;
+		public:
+			Bind(Arena& arena) : mPrevious(bound()) { bound() = &arena; }
+			~Bind() { bound() = mPrevious; }
+			Bind(const Bind&) = delete;
+			Bind& operator=(const Bind&) = delete;
+		};
+
+		Arena() = default;
+
+		/**
+		 * @brief Use borrowed memory
+		 */
+		Arena(void* memory, Size size) : mMemory(reinterpret_cast<Byte*>(memory)), mSize(size) { }
+
+		/**
+		 * @brief Allocate the memory with tklb_malloc, check capacity() for failure
+		 */
+		Arena(Size size) { resize(size); }
+
+		Arena(const Arena&) = delete;
+		Arena& operator=(const Arena&) = delete;
+
+		~Arena() {
+			TKLB_ASSERT(bound() != this)
+			if (mOwned) { tklb_free(mMemory); }
+		}
+
+		/**
+		 * @brief Replaces the memory, everything allocated before becomes invalid.
+		 *        Not realtime safe.
+		 * @return False if the allocation failed
+		 */
+		bool resize(Size size) {
+			if (mOwned) { tklb_free(mMemory); }
+			mMemory = size == 0 ? nullptr : reinterpret_cast<Byte*>(tklb_malloc(size));
+			mOwned = mMemory != nullptr;
+			mSize = mOwned ? size : 0;
+			mOffset = mPeak = 0;
+			return mOwned || size == 0;
+		}
+
+		/**
+		 * @param align Power of two
+		 * @return nullptr if there's not enough space left
+		 */
+		void* allocate(Size bytes, Size align = DefaultAlignment) {
+			TKLB_ASSERT((align & (align - 1)) == 0)
+			const Pointer start = Pointer(mMemory) + mOffset;
+			const Pointer aligned = (start + align - 1) & ~Pointer(align - 1);
+			const Size end = mOffset + Size(aligned - start) + bytes;
+			if (mSize < end) { return nullptr; } // ! Arena too small, see peak()
+			mOffset = end;
+			mPeak = mOffset < mPeak ? mPeak : mOffset;
+			return reinterpret_cast<void*>(aligned);
+		}
+
+		/**
+		 * @brief Allocate and default construct objects.
+		 *        No destructors are called when rewinding.
+		 */
+		template <class T>
+		T* create(Size count = 1) {
+			void* memory = allocate(sizeof(T) * count, alignof(T));
+			if (memory == nullptr) { return nullptr; }
+			T* objects = reinterpret_cast<T*>(memory);
+			for (Size i = 0; i < count; i++) { new (objects + i) T(); }
+			return objects;
+		}
+
+		Marker mark() const { return mOffset; }
+
+		/**
+		 * @brief Frees everything allocated after the marker
+		 */
+		void rewind(Marker marker) {
+			TKLB_ASSERT(marker <= mOffset)
+			mOffset = marker;
+		}
+
+		/**
+		 * @brief Frees everything, call once per block
+		 */
+		void reset() { mOffset = 0; }
+
+		Size used() const { return mOffset; }
+
+		Size capacity() const { return mSize; }
+
+		/**
+		 * @brief Highest usage so far, useful to size the arena
+		 */
+		Size peak() const { return mPeak; }
+
+		/**
+		 * @brief The arena bound to the calling thread or nullptr
+		 */
+		static Arena* current() { return bound(); }
+	};
+
+	/**
+	 * @brief HeapBuffer compatible allocator taking memory from the arena bound
+	 *        to the calling thread. Freeing does nothing, the memory is reclaimed
+	 *        when the arena is rewound. Buffers using it must not outlive that.
+	 * @tparam T Element to allocate
+	 * @tparam NAME In case the allocation are tracked, the allocator can have a name
+	 */
+	template <class T = unsigned char, class NAME = DefaultAllocatorName>
+	struct ArenaAllocator {
+		typedef T value_type;
+
+		constexpr ArenaAllocator() = default;
+		constexpr ArenaAllocator(const ArenaAllocator&) = default;
+
+		template <class U, class NAME2>
+		constexpr ArenaAllocator(const ArenaAllocator<U, NAME2>&) { }
+
+		T* allocate(SizeT n) const noexcept {
+			// At least pointer aligned, HeapBuffer relies on it to align further
+			return allocate(n, SizeT(Arena::DefaultAlignment));
+		}
+
+		T* allocate(SizeT n, SizeT alignment) const noexcept {
+			Arena* arena = Arena::current();
+			TKLB_ASSERT(arena != nullptr) // ! No arena bound to this thread
+			if (arena == nullptr) { return nullptr; }
+			const auto bytes = n * sizeof(T);
+			auto ptr = static_cast<T*>(arena->allocate(bytes, max(SizeT(alignof(T)), alignment)));
+			if (ptr != nullptr) { TKLB_STATS_MALLOC(bytes, NAME) }
+			return ptr;
+		}
+
+		void deallocate(T* ptr, SizeT n) const noexcept {
+			(void) ptr;
+			(void) n;
+			TKLB_STATS_FREE(ptr, n * sizeof(T), NAME)
+		}
+
+		void deallocate(T* ptr, SizeT n, SizeT alignment) const noexcept {
+			(void) alignment;
+			deallocate(ptr, n);
+		}
+	};
+
+} } // namespace tklb::memory
+
+#endif // _TKLB_ARENA
@@ -17,6 +17,7 @@
 #endif
 
 #include "../util/TAssert.h"
+#include "../util/TRealtimeGuard.hpp"
 
 /**
  * @brief Main allocation function.
@@ -34,6 +35,38 @@ void* tklb_malloc(tklb::SizeT bytes);
  */
 void tklb_free(void* ptr);
 
+/**
+ * @brief Resizes memory from tklb_malloc and keeps its contents like realloc.
+ *        Only available when TKLB_HAS_REALLOC is defined, which is the case
+ *        for the default implementation and TKLB_MEMORY_CHECK.
+ *        Define TKLB_CUSTOM_REALLOC when providing it along TKLB_CUSTOM_MALLOC.
+ * @param ptr Memory to resize or nullptr to allocate
+ * @param bytes New size, not 0
+ * @return void* Resized memory or nullptr when it failed, ptr stays valid then
+ */
+void* tklb_realloc(void* ptr, tklb::SizeT bytes);
+
+#if (!defined(TKLB_NO_STDLIB) && !defined(TKLB_CUSTOM_MALLOC)) || defined(TKLB_CUSTOM_REALLOC)
+	#define TKLB_HAS_REALLOC
+#endif
+
+/**
+ * @brief Aligned allocation function. Use TKLB_MALLOC_ALIGNED.
+ *        Uses posix_memalign or _aligned_malloc by default.
+ *        With TKLB_CUSTOM_MALLOC or TKLB_MEMORY_CHECK it over allocates with
+ *        tklb_malloc instead, unless TKLB_CUSTOM_MALLOC_ALIGNED is defined
+ *        and the user provides both aligned functions as well.
+ * @param bytes Bytes to allocate
+ * @param alignment Power of two
+ * @return void* Memory aligned to alignment
+ */
+void* tklb_malloc_aligned(tklb::SizeT bytes, tklb::SizeT alignment);
+
+/**
+ * @brief Frees memory from tklb_malloc_aligned. Use TKLB_FREE_ALIGNED.
+ */
+void tklb_free_aligned(void* ptr);
+
 #if !defined(TKLB_NO_STDLIB) && defined(TKLB_IMPL) && !defined(TKLB_CUSTOM_MALLOC)
 	#ifdef TKLB_MEMORY_CHECK
 		#include "./TMemoryCheck.hpp"
@@ -166,16 +199,105 @@ namespace tklb { namespace memory {
 		const auto ptr = reinterpret_cast<char*>(dst);
 		set<char>(ptr, bytes, 0);
 	}
+
+	/**
+	 * @brief Extra bytes an allocation needs to be aligned with alignAllocation()
+	 */
+	static constexpr SizeT alignOverhead(SizeT alignment) {
+		return alignment + sizeof(void*);
+	}
+
+	/**
+	 * @brief Aligns an unaligned allocation and stores its address in front
+	 *        of the result, so it can be recovered with alignedOrigin()
+	 * @param allocation At least alignOverhead() bytes larger than needed
+	 * @param alignment Power of two
+	 */
+	static inline void* alignAllocation(void* allocation, SizeT alignment) {
+		if (allocation == nullptr) { return nullptr; }
+		TKLB_ASSERT((alignment & (alignment - 1)) == 0)
+		const Pointer start = Pointer(allocation) + sizeof(void*);
+		const Pointer aligned = (start + alignment - 1) & ~Pointer(alignment - 1);
+		reinterpret_cast<void**>(aligned)[-1] = allocation;
+		return reinterpret_cast<void*>(aligned);
+	}
+
+	/**
+	 * @brief The original allocation of memory aligned by alignAllocation()
+	 */
+	static inline void* alignedOrigin(void* aligned) {
+		return reinterpret_cast<void**>(aligned)[-1];
+	}
 } } // tklb::memory
 
+#if !defined(TKLB_NO_STDLIB) && defined(TKLB_IMPL) && !defined(TKLB_CUSTOM_MALLOC)
+	#ifdef TKLB_MEMORY_CHECK
+		void* tklb_realloc(void* ptr, tklb::SizeT bytes) {
+			if (ptr == nullptr) { return tklb_malloc(bytes); }
+			// Always moves so the magic blocks are rebuilt
+			const auto result = tklb::memory::check::MagicBlock::check(ptr);
+			TKLB_ASSERT(!result.overrun && !result.underrun)
+			void* moved = tklb_malloc(bytes);
+			if (moved == nullptr) { return nullptr; }
+			tklb::memory::copy(moved, ptr, result.size < bytes ? result.size : bytes);
+			tklb_free(ptr);
+			return moved;
+		}
+	#else // TKLB_MEMORY_CHECK
+		void* tklb_realloc(void* ptr, tklb::SizeT bytes) {
+			return realloc(ptr, bytes);
+		}
+	#endif // TKLB_MEMORY_CHECK
+#endif // realloc impl
+
+#if defined(TKLB_IMPL) && !defined(TKLB_CUSTOM_MALLOC_ALIGNED)
+	#if !defined(TKLB_NO_STDLIB) && !defined(TKLB_CUSTOM_MALLOC) && !defined(TKLB_MEMORY_CHECK)
+		#ifdef _WIN32
+			#include <malloc.h>
+
+			void* tklb_malloc_aligned(tklb::SizeT bytes, tklb::SizeT alignment) {
+				return _aligned_malloc(bytes, alignment);
+			}
+
+			void tklb_free_aligned(void* ptr) {
+				_aligned_free(ptr);
+			}
+		#else
+			void* tklb_malloc_aligned(tklb::SizeT bytes, tklb::SizeT alignment) {
+				// posix_memalign needs at least pointer alignment
+				if (alignment < sizeof(void*)) { alignment = sizeof(void*); }
+				void* ptr = nullptr;
+				if (posix_memalign(&ptr, alignment, bytes) != 0) { return nullptr; }
+				return ptr;
+			}
+
+			void tklb_free_aligned(void* ptr) {
+				free(ptr);
+			}
+		#endif
+	#else
+		void* tklb_malloc_aligned(tklb::SizeT bytes, tklb::SizeT alignment) {
+			using namespace tklb::memory;
+			return alignAllocation(tklb_malloc(bytes + alignOverhead(alignment)), alignment);
+		}
+
+		void tklb_free_aligned(void* ptr) {
+			if (ptr == nullptr) { return; }
+			tklb_free(tklb::memory::alignedOrigin(ptr));
+		}
+	#endif
+#endif // aligned memory impl
+
 
 #ifndef TKLB_MALLOC // TODO TKLB memory tracer should take a detour
-	#define TKLB_MALLOC(size)		tklb_malloc(size);
-	#define TKLB_FREE(ptr)			tklb_free(ptr);
+	#define TKLB_MALLOC(size)		(TKLB_REALTIME_CHECK(Allocate), tklb_malloc(size));
+	#define TKLB_FREE(ptr)			(TKLB_REALTIME_CHECK(Free), tklb_free(ptr));
+	#define TKLB_MALLOC_ALIGNED(size, alignment)	(TKLB_REALTIME_CHECK(Allocate), tklb_malloc_aligned(size, alignment));
+	#define TKLB_FREE_ALIGNED(ptr)	(TKLB_REALTIME_CHECK(Free), tklb_free_aligned(ptr));
 	#define TKLB_CALLOC(num, size) 	notImplemented; // TODO TKLB
-	#define TKLB_NEW_PARAM(T, ...)	tklb::memory::create<T>(__VA_ARGS__);
-	#define TKLB_NEW(T)				tklb::memory::create<T>();
-	#define TKLB_DELETE(T, ptr)		tklb::memory::dispose<T>(ptr);
+	#define TKLB_NEW_PARAM(T, ...)	(TKLB_REALTIME_CHECK(Allocate), tklb::memory::create<T>(__VA_ARGS__));
+	#define TKLB_NEW(T)				(TKLB_REALTIME_CHECK(Allocate), tklb::memory::create<T>());
+	#define TKLB_DELETE(T, ptr)		(TKLB_REALTIME_CHECK(Free), tklb::memory::dispose<T>(ptr));
 #endif // TKLB_MALLOC
 
 #endif // _TKLB_MEMORY
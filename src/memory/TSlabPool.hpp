@@ -0,0 +1,364 @@
+#ifndef _TKLB_SLAB_POOL
+#define _TKLB_SLAB_POOL
+
+#include "../types/TTypes.hpp"
+#include "./TMemory.hpp"
+#include "./TAllocator.hpp"
+#include "../util/TAssert.h"
+
+#ifndef TKLB_NO_STDLIB
+
+#include <mutex>
+
+namespace tklb { namespace memory {
+
+	/**
+	 * @brief Allocator for many small allocations of repeating sizes.
+	 * @details Requests are rounded up to one of a few size classes,
+	 *          each class carves its objects from large slabs taken from tklb_malloc.
+	 *          Every thread keeps a small cache of free objects per class, so most
+	 *          allocations and frees don't touch any shared state.
+	 *          Caches refill from and spill to the shared lists in batches,
+	 *          one lock per batch instead of one per object.
+	 *          Requests larger than the largest class go straight to tklb_malloc.
+	 *          Slabs are only given back when the pool is destroyed or release() is called.
+	 *
+	 *          Meant to be used as a single instance, see instance().
+	 *          A thread using more than one pool flushes its cache when switching.
+	 *          Threads flush their cache when they exit, other pools need to
+	 *          be flushed manually before being destroyed.
+	 */
+	class SlabPool {
+		using Size = SizeT;
+		using Byte = unsigned char;
+		using Mutex = std::mutex;
+		using Lock = std::lock_guard<Mutex>;
+
+	public:
+		static constexpr Size Classes = 28;
+		static constexpr Size MaxSize = 4096;		///< Largest size class
+		static constexpr Size SlabSize = 64 * 1024;	///< Bytes taken from tklb_malloc at once
+		static constexpr Size HeaderSize = 16;		///< Keeps the class, slabs are aligned to it so objects are too
+
+	private:
+		static constexpr unsigned int Large = ~0u;	///< Header marking allocations bypassing the classes
+
+		struct Node { Node* next; };
+
+		struct Class {
+			Mutex mutex;
+			Node* free = nullptr;		///< Shared free list
+			Byte* bump = nullptr;		///< Untouched space in the newest slab
+			Byte* bumpEnd = nullptr;
+		};
+
+		struct ThreadCache {
+			SlabPool* pool = nullptr;
+			Node* free[Classes] = { };
+			Size count[Classes] = { };
+		};
+
+		/**
+		 * @brief The cache of each thread, flushed when the thread exits
+		 */
+		struct LocalCache {
+			ThreadCache cache;
+
+			~LocalCache() {
+				if (cache.pool != nullptr) { cache.pool->flush(cache); }
+				gone() = true;
+			}
+		};
+
+		/**
+		 * @brief Set once the thread's cache is destroyed, static destructors
+		 *        running after that use the shared lists directly
+		 */
+		static bool& gone() {
+			static thread_local bool gone = false;
+			return gone;
+		}
+
+		Class mClasses[Classes];
+		Mutex mSlabMutex;
+		Byte* mSlabs = nullptr;		///< Linked by their first bytes
+		Size mSlabCount = 0;
+
+		/**
+		 * @brief 16 byte steps up to 128, four steps per power of two after
+		 */
+		static Size classSize(Size index) {
+			if (index < 8) { return (index + 1) * 16; }
+			const Size octave = (index - 8) / 4;
+			const Size step = (index - 8) % 4;
+			return (Size(128) << octave) + (step + 1) * (Size(32) << octave);
+		}
+
+		static Size classOf(Size bytes) {
+			if (bytes <= 128) { return bytes == 0 ? 0 : (bytes - 1) / 16; }
+			Size index = 8;
+			while (classSize(index) < bytes) { index++; }
+			return index;
+		}
+
+		/**
+		 * @brief Objects moved between a cache and the shared list at once
+		 */
+		static Size batchSize(Size index) {
+			const Size batch = 8192 / classSize(index);
+			return batch < 4 ? 4 : (64 < batch ? 64 : batch);
+		}
+
+		static unsigned int& header(void* ptr) {
+			return *reinterpret_cast<unsigned int*>(reinterpret_cast<Byte*>(ptr) - HeaderSize);
+		}
+
+		ThreadCache* cache() {
+			if (gone()) { return nullptr; }
+			static thread_local LocalCache local;
+			ThreadCache& cache = local.cache;
+			if (cache.pool != this) {
+				if (cache.pool != nullptr) { cache.pool->flush(cache); }
+				cache.pool = this;
+			}
+			return &cache;
+		}
+
+		Byte* newSlab() {
+			Lock lock(mSlabMutex);
+			Byte* slab = reinterpret_cast<Byte*>(tklb_malloc_aligned(SlabSize, HeaderSize));
+			if (slab == nullptr) { return nullptr; }
+			*reinterpret_cast<Byte**>(slab) = mSlabs;
+			mSlabs = slab;
+			mSlabCount++;
+			return slab;
+		}
+
+		/**
+		 * @brief Moves a batch from the shared list into the cache
+		 */
+		bool refill(ThreadCache& cache, Size index) {
+			Class& sizeClass = mClasses[index];
+			const Size stride = HeaderSize + classSize(index);
+			const Size batch = batchSize(index);
+			Lock lock(sizeClass.mutex);
+			Size got = 0;
+			while (got < batch && sizeClass.free != nullptr) {
+				Node* node = sizeClass.free;
+				sizeClass.free = node->next;
+				node->next = cache.free[index];
+				cache.free[index] = node;
+				got++;
+			}
+			while (got < batch) {
+				if (sizeClass.bump == nullptr || sizeClass.bumpEnd < sizeClass.bump + stride) {
+					Byte* slab = newSlab();
+					if (slab == nullptr) { break; } // ! Out of memory
+					sizeClass.bump = slab + HeaderSize;
+					sizeClass.bumpEnd = slab + SlabSize;
+				}
+				Node* node = reinterpret_cast<Node*>(sizeClass.bump + HeaderSize);
+				header(node) = unsigned(index);
+				sizeClass.bump += stride;
+				node->next = cache.free[index];
+				cache.free[index] = node;
+				got++;
+			}
+			cache.count[index] += got;
+			return got != 0;
+		}
+
+		/**
+		 * @brief Moves count objects from the cache back to the shared list
+		 */
+		void spill(ThreadCache& cache, Size index, Size count) {
+			if (count == 0) { return; }
+			// Unlink the batch before locking
+			Node* first = cache.free[index];
+			Node* last = first;
+			for (Size i = 1; i < count; i++) { last = last->next; }
+			cache.free[index] = last->next;
+			cache.count[index] -= count;
+
+			Class& sizeClass = mClasses[index];
+			Lock lock(sizeClass.mutex);
+			last->next = sizeClass.free;
+			sizeClass.free = first;
+		}
+
+		void* take(ThreadCache& cache, Size index) {
+			if (cache.free[index] == nullptr && !refill(cache, index)) {
+				return nullptr; // ! Out of memory
+			}
+			Node* node = cache.free[index];
+			cache.free[index] = node->next;
+			cache.count[index]--;
+			return node;
+		}
+
+		void flush(ThreadCache& cache) {
+			for (Size i = 0; i < Classes; i++) {
+				spill(cache, i, cache.count[i]);
+			}
+		}
+
+	public:
+		SlabPool() = default;
+		SlabPool(const SlabPool&) = delete;
+		SlabPool& operator=(const SlabPool&) = delete;
+
+		~SlabPool() { release(); }
+
+		/**
+		 * @brief Pool shared by all SlabAllocators
+		 */
+		static SlabPool& instance() {
+			static SlabPool pool;
+			return pool;
+		}
+
+		void* allocate(Size bytes) {
+			if (MaxSize < bytes) {
+				void* ptr = tklb_malloc(bytes + HeaderSize);
+				if (ptr == nullptr) { return nullptr; }
+				ptr = reinterpret_cast<Byte*>(ptr) + HeaderSize;
+				header(ptr) = Large;
+				return ptr;
+			}
+			const Size index = classOf(bytes);
+			ThreadCache* local = cache();
+			if (local == nullptr) {
+				// Thread is shutting down, go through a temporary cache
+				ThreadCache temporary;
+				void* ptr = take(temporary, index);
+				flush(temporary);
+				return ptr;
+			}
+			return take(*local, index);
+		}
+
+		void deallocate(void* ptr) {
+			if (ptr == nullptr) { return; }
+			const unsigned int index = header(ptr);
+			if (index == Large) {
+				tklb_free(reinterpret_cast<Byte*>(ptr) - HeaderSize);
+				return;
+			}
+			TKLB_ASSERT(index < Classes)
+			ThreadCache* local = cache();
+			ThreadCache temporary;
+			ThreadCache& target = local == nullptr ? temporary : *local;
+			Node* node = reinterpret_cast<Node*>(ptr);
+			node->next = target.free[index];
+			target.free[index] = node;
+			target.count[index]++;
+			const Size batch = batchSize(index);
+			if (2 * batch < target.count[index]) { spill(target, index, batch); }
+			if (local == nullptr) { flush(temporary); }
+		}
+
+		/**
+		 * @brief Returns everything the calling thread has cached to the shared lists.
+		 *        Useful before a thread goes idle for a long time.
+		 */
+		void flush() {
+			ThreadCache* local = cache();
+			if (local != nullptr) { flush(*local); }
+		}
+
+		/**
+		 * @brief Gives all slabs back to tklb_malloc.
+		 *        Every allocation needs to be freed before and every
+		 *        other thread which used the pool needs to have flushed.
+		 */
+		void release() {
+			ThreadCache* own = cache();
+			if (own != nullptr) {
+				for (Size i = 0; i < Classes; i++) {
+					own->free[i] = nullptr;
+					own->count[i] = 0;
+				}
+				own->pool = nullptr;
+			}
+			for (Size i = 0; i < Classes; i++) {
+				mClasses[i].free = nullptr;
+				mClasses[i].bump = mClasses[i].bumpEnd = nullptr;
+			}
+			Lock lock(mSlabMutex);
+			while (mSlabs != nullptr) {
+				Byte* next = *reinterpret_cast<Byte**>(mSlabs);
+				tklb_free_aligned(mSlabs);
+				mSlabs = next;
+			}
+			mSlabCount = 0;
+		}
+
+		/**
+		 * @brief Slabs taken from tklb_malloc so far
+		 */
+		Size slabs() {
+			Lock lock(mSlabMutex);
+			return mSlabCount;
+		}
+	};
+
+	/**
+	 * @brief HeapBuffer compatible allocator using the shared SlabPool
+	 * @tparam T Element to allocate
+	 * @tparam NAME In case the allocation are tracked, the allocator can have a name
+	 */
+	template <class T = unsigned char, class NAME = DefaultAllocatorName>
+	struct SlabAllocator {
+		typedef T value_type;
+
+		constexpr SlabAllocator() = default;
+		constexpr SlabAllocator(const SlabAllocator&) = default;
+
+		template <class U, class NAME2>
+		constexpr SlabAllocator(const SlabAllocator<U, NAME2>&) { }
+
+		T* allocate(SizeT n) const noexcept {
+			const auto bytes = n * sizeof(T);
+			if (auto ptr = static_cast<T*>(SlabPool::instance().allocate(bytes))) {
+				TKLB_PROFILER_MALLOC_L(ptr, bytes, NAME::Name)
+				TKLB_STATS_MALLOC(bytes, NAME)
+				return ptr;
+			}
+			return nullptr;
+		}
+
+		/**
+		 * @brief Classes are only 16 byte aligned, larger alignments are padded
+		 */
+		T* allocate(SizeT n, SizeT alignment) const noexcept {
+			if (alignment <= SlabPool::HeaderSize) { return allocate(n); }
+			const auto bytes = n * sizeof(T);
+			void* allocation = SlabPool::instance().allocate(bytes + alignOverhead(alignment));
+			if (auto ptr = static_cast<T*>(alignAllocation(allocation, alignment))) {
+				TKLB_PROFILER_MALLOC_L(ptr, bytes, NAME::Name)
+				TKLB_STATS_MALLOC(bytes, NAME)
+				return ptr;
+			}
+			return nullptr;
+		}
+
+		void deallocate(T* ptr, SizeT n) const noexcept {
+			(void) n;
+			TKLB_PROFILER_FREE_L(ptr, NAME::Name)
+			TKLB_STATS_FREE(ptr, n * sizeof(T), NAME)
+			SlabPool::instance().deallocate(ptr);
+		}
+
+		void deallocate(T* ptr, SizeT n, SizeT alignment) const noexcept {
+			if (alignment <= SlabPool::HeaderSize || ptr == nullptr) { return deallocate(ptr, n); }
+			TKLB_PROFILER_FREE_L(ptr, NAME::Name)
+			TKLB_STATS_FREE(ptr, n * sizeof(T), NAME)
+			SlabPool::instance().deallocate(alignedOrigin(ptr));
+		}
+	};
+
+} } // namespace tklb::memory
+
+#endif // TKLB_NO_STDLIB
+
+#endif // _TKLB_SLAB_POOL
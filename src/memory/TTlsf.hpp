@@ -0,0 +1,546 @@
+#ifndef _TKLB_TLSF
+#define _TKLB_TLSF
+
+#include "../types/TTypes.hpp"
+#include "../types/TSpinLock.hpp"
+#include "../types/TLockGuard.hpp"
+#include "./TMemory.hpp"
+#include "./TAllocator.hpp"
+#include "../util/TAssert.h"
+
+#if defined(_MSC_VER) && !defined(TKLB_NO_STDLIB)
+	#include <intrin.h>
+#endif
+
+namespace tklb { namespace memory {
+
+	/**
+	 * @brief Two-Level Segregated Fit allocator managing a chunk of memory
+	 *        provided beforehand.
+	 * @details Free blocks are sorted into lists by size, the first level splits
+	 *          by powers of two, the second level linearly inside each power of two.
+	 *          Two bitmaps track which lists have blocks, so finding a fitting
+	 *          block is a couple of bit scans instead of a search.
+	 *          Freed blocks are merged with their free neighbours right away.
+	 *          Allocating and freeing take constant time no matter how
+	 *          fragmented the pool is, which makes it usable on the audio thread.
+	 *          The worst case waste is 1/32 of a block due to the rounding in
+	 *          the second level.
+	 *
+	 *          Each block is preceded by its size, the lowest bits flag whether
+	 *          the block and the one before it are free. Free blocks store the
+	 *          list links in their payload and their address in the last word,
+	 *          so the following block can find them when merging.
+	 */
+	class Tlsf {
+		using Size = SizeT;
+		using Byte = unsigned char;
+		using Mutex = SpinLock;
+		using Lock = LockGuard<Mutex>;
+		using Bitmap = unsigned int;
+
+		static constexpr Size AlignLog2 = sizeof(void*) == 8 ? 3 : 2;
+		static constexpr Size Align = Size(1) << AlignLog2;	///< Alignment of every allocation, same as FixedPool
+		static constexpr Size SlLog2 = 5;
+		static constexpr Size SlCount = Size(1) << SlLog2;	///< Second level lists per power of two
+		static constexpr Size FlShift = SlLog2 + AlignLog2;
+		static constexpr Size FlMax = sizeof(void*) == 8 ? 32 : 30;
+		static constexpr Size FlCount = FlMax - FlShift + 1;
+		static constexpr Size SmallBlock = Size(1) << FlShift;	///< Blocks below go in the first list linearly
+
+		static_assert(SlCount <= sizeof(Bitmap) * 8, "Second level bitmap too small");
+		static_assert(FlCount <= sizeof(Bitmap) * 8, "First level bitmap too small");
+
+		struct Block {
+			Block* prevPhysical;	///< Only valid if the previous block is free, lives in its payload
+			Size size;				///< Payload size and the flags
+			Block* nextFree;		///< Only valid if this block is free
+			Block* prevFree;
+		};
+
+		static constexpr Size FreeBit = 1;
+		static constexpr Size PrevFreeBit = 2;
+		static constexpr Size Overhead = sizeof(Size);			///< Space used by an allocated block
+		static constexpr Size PayloadOffset = sizeof(Block*) + sizeof(Size);
+		static constexpr Size MinBlock = sizeof(Block) - sizeof(Block*);
+		static constexpr Size MaxBlock = Size(1) << FlMax;
+
+		Mutex mMutex;
+		Bitmap mFlBitmap = 0;
+		Bitmap mSlBitmap[FlCount] = { };
+		Block* mFree[FlCount][SlCount] = { };
+		Size mCapacity = 0;
+		Size mAllocated = 0;
+		Block* mFirst = nullptr;
+
+		/**
+		 * @brief Index of the lowest set bit
+		 */
+		static inline Size findFirstSet(Bitmap value) {
+			TKLB_ASSERT(value != 0)
+		#if defined(__GNUC__) || defined(__clang__)
+			return Size(__builtin_ctz(value));
+		#elif defined(_MSC_VER) && !defined(TKLB_NO_STDLIB)
+			unsigned long index;
+			_BitScanForward(&index, value);
+			return Size(index);
+		#else
+			Size index = 0;
+			while ((value & 1) == 0) { value >>= 1; index++; }
+			return index;
+		#endif
+		}
+
+		/**
+		 * @brief Index of the highest set bit
+		 */
+		static inline Size findLastSet(Size value) {
+			TKLB_ASSERT(value != 0)
+		#if defined(__GNUC__) || defined(__clang__)
+			return Size(sizeof(unsigned long long) * 8 - 1 - __builtin_clzll((unsigned long long) value));
+		#elif defined(_MSC_VER) && !defined(TKLB_NO_STDLIB) && defined(_WIN64)
+			unsigned long index;
+			_BitScanReverse64(&index, value);
+			return Size(index);
+		#else
+			Size index = 0;
+			while (value >>= 1) { index++; }
+			return index;
+		#endif
+		}
+
+		static inline Size alignUp(Size value, Size align) {
+			return (value + align - 1) & ~(align - 1);
+		}
+
+		static inline Size sizeOf(const Block* block) { return block->size & ~(FreeBit | PrevFreeBit); }
+
+		static inline void setSize(Block* block, Size size) {
+			block->size = size | (block->size & (FreeBit | PrevFreeBit));
+		}
+
+		static inline bool isFree(const Block* block) { return (block->size & FreeBit) != 0; }
+
+		static inline Byte* payload(const Block* block) {
+			return (Byte*) block + PayloadOffset;
+		}
+
+		static inline Block* fromPayload(const void* ptr) {
+			return (Block*) ((const Byte*) ptr - PayloadOffset);
+		}
+
+		/**
+		 * @brief The following block, its header overlaps the last word of this one
+		 */
+		static inline Block* next(const Block* block) {
+			return (Block*) (payload(block) + sizeOf(block) - sizeof(Block*));
+		}
+
+		static inline Block* linkNext(Block* block) {
+			Block* following = next(block);
+			following->prevPhysical = block;
+			return following;
+		}
+
+		static inline void markFree(Block* block) {
+			linkNext(block)->size |= PrevFreeBit;
+			block->size |= FreeBit;
+		}
+
+		static inline void markUsed(Block* block) {
+			next(block)->size &= ~PrevFreeBit;
+			block->size &= ~FreeBit;
+		}
+
+		/**
+		 * @brief List indices for a size
+		 */
+		static inline void mapping(Size size, Size& fl, Size& sl) {
+			if (size < SmallBlock) {
+				fl = 0;
+				sl = size >> AlignLog2;
+			} else {
+				const Size last = findLastSet(size);
+				sl = (size >> (last - SlLog2)) ^ SlCount;
+				fl = last - (FlShift - 1);
+			}
+		}
+
+		/**
+		 * @brief Rounds up to the next list, so any block found there fits
+		 */
+		static inline void mappingSearch(Size size, Size& fl, Size& sl) {
+			if (SmallBlock <= size) {
+				size += (Size(1) << (findLastSet(size) - SlLog2)) - 1;
+			}
+			mapping(size, fl, sl);
+		}
+
+		Block* search(Size& fl, Size& sl) const {
+			if (FlCount <= fl) { return nullptr; } // ! Rounded past the largest block
+			Bitmap slMap = mSlBitmap[fl] & (~Bitmap(0) << sl);
+			if (slMap == 0) {
+				const Bitmap flMap = fl + 1 < FlCount ? mFlBitmap & (~Bitmap(0) << (fl + 1)) : 0;
+				if (flMap == 0) { return nullptr; } // ! Out of memory
+				fl = findFirstSet(flMap);
+				slMap = mSlBitmap[fl];
+			}
+			sl = findFirstSet(slMap);
+			return mFree[fl][sl];
+		}
+
+		void insert(Block* block) {
+			Size fl, sl;
+			mapping(sizeOf(block), fl, sl);
+			Block* head = mFree[fl][sl];
+			block->nextFree = head;
+			block->prevFree = nullptr;
+			if (head != nullptr) { head->prevFree = block; }
+			mFree[fl][sl] = block;
+			mFlBitmap |= Bitmap(1) << fl;
+			mSlBitmap[fl] |= Bitmap(1) << sl;
+		}
+
+		void remove(Block* block) {
+			Size fl, sl;
+			mapping(sizeOf(block), fl, sl);
+			if (block->nextFree != nullptr) { block->nextFree->prevFree = block->prevFree; }
+			if (block->prevFree != nullptr) {
+				block->prevFree->nextFree = block->nextFree;
+				return;
+			}
+			mFree[fl][sl] = block->nextFree;
+			if (block->nextFree == nullptr) {
+				mSlBitmap[fl] &= ~(Bitmap(1) << sl);
+				if (mSlBitmap[fl] == 0) { mFlBitmap &= ~(Bitmap(1) << fl); }
+			}
+		}
+
+		static inline bool canSplit(const Block* block, Size size) {
+			return sizeof(Block) + size <= sizeOf(block);
+		}
+
+		/**
+		 * @brief Cuts the block at size and returns the free rest
+		 */
+		static Block* split(Block* block, Size size) {
+			Block* rest = (Block*) (payload(block) + size - sizeof(Block*));
+			rest->size = sizeOf(block) - (size + Overhead);
+			setSize(block, size);
+			markFree(rest);
+			return rest;
+		}
+
+		/**
+		 * @brief Merges the following block into this one
+		 */
+		static Block* absorb(Block* block, Block* following) {
+			block->size += sizeOf(following) + Overhead;
+			linkNext(block);
+			return block;
+		}
+
+		Block* mergePrev(Block* block) {
+			if ((block->size & PrevFreeBit) == 0) { return block; }
+			Block* previous = block->prevPhysical;
+			TKLB_ASSERT(isFree(previous))
+			remove(previous);
+			return absorb(previous, block);
+		}
+
+		Block* mergeNext(Block* block) {
+			Block* following = next(block);
+			if (!isFree(following)) { return block; }
+			remove(following);
+			return absorb(block, following);
+		}
+
+		/**
+		 * @brief Gives the end of a free block back to the lists
+		 */
+		void trimFree(Block* block, Size size) {
+			if (!canSplit(block, size)) { return; }
+			Block* rest = split(block, size);
+			linkNext(block);
+			rest->size |= PrevFreeBit;
+			insert(rest);
+		}
+
+		/**
+		 * @brief Gives the end of a used block back to the lists
+		 */
+		void trimUsed(Block* block, Size size) {
+			if (!canSplit(block, size)) { return; }
+			Block* rest = split(block, size);
+			rest->size &= ~PrevFreeBit;
+			insert(mergeNext(rest));
+		}
+
+		/**
+		 * @brief Gives the start of a free block back to the lists, used to align allocations
+		 */
+		Block* trimFreeLeading(Block* block, Size size) {
+			Block* rest = block;
+			if (canSplit(block, size)) {
+				rest = split(block, size - Overhead);
+				linkNext(block);
+				rest->size |= PrevFreeBit;
+				insert(block);
+			}
+			return rest;
+		}
+
+		void* prepareUsed(Block* block, Size size) {
+			trimFree(block, size);
+			markUsed(block);
+			mAllocated += sizeOf(block) + Overhead;
+			return payload(block);
+		}
+
+		static inline Size adjustSize(Size size) {
+			if (size == 0 || MaxBlock <= size) { return 0; }
+			return alignUp(size < MinBlock ? MinBlock : size, Align);
+		}
+
+	public:
+		/**
+		 * @param pool Memory to manage, needs to outlive the allocator
+		 * @param size Size of the memory in bytes
+		 */
+		Tlsf(void* pool, Size size) {
+			const Size start = alignUp(Pointer(pool), Align);
+			const Size lost = start - Pointer(pool);
+			if (size < lost + 2 * Overhead + MinBlock) {
+				TKLB_ASSERT(false)
+				return; // ! Pool too small
+			}
+			Size bytes = (size - lost - 2 * Overhead) & ~(Align - 1);
+			if (MaxBlock - Align < bytes) { bytes = MaxBlock - Align; }
+
+			// The first block's prevPhysical lies before the pool but is never used
+			Block* block = (Block*) (start - sizeof(Block*));
+			block->size = bytes | FreeBit;
+			insert(block);
+			mFirst = block;
+			mCapacity = bytes;
+
+			// Zero sized sentinel so the last block never merges past the end
+			Block* sentinel = linkNext(block);
+			sentinel->size = PrevFreeBit;
+		}
+
+		Tlsf(const Tlsf&) = delete;
+		Tlsf& operator=(const Tlsf&) = delete;
+
+		~Tlsf() {
+			TKLB_ASSERT(mAllocated == 0)
+		}
+
+		/**
+		 * @brief Bytes allocated including the per block overhead
+		 */
+		Size allocated() const { return mAllocated; }
+
+		/**
+		 * @brief Bytes left, a single allocation of this size can still fail due to fragmentation
+		 */
+		Size free() const { return mCapacity - mAllocated; }
+
+		/**
+		 * @brief Space usable at ptr, might be more than requested
+		 */
+		static Size usableSize(const void* ptr) {
+			return ptr == nullptr ? 0 : sizeOf(fromPayload(ptr));
+		}
+
+		/**
+		 * @return Memory aligned to the pointer width or nullptr if there's no space
+		 */
+		void* allocate(Size size) {
+			const Size adjusted = adjustSize(size);
+			if (adjusted == 0) { return nullptr; }
+			Size fl, sl;
+			mappingSearch(adjusted, fl, sl);
+			Lock lock(mMutex);
+			Block* block = search(fl, sl);
+			if (block == nullptr) { return nullptr; } // ! No memory left
+			TKLB_ASSERT(adjusted <= sizeOf(block))
+			remove(block);
+			return prepareUsed(block, adjusted);
+		}
+
+		/**
+		 * @param align Power of two
+		 * @return Memory aligned to align or nullptr if there's no space
+		 */
+		void* allocate(Size size, Size align) {
+			TKLB_ASSERT((align & (align - 1)) == 0)
+			if (align <= Align) { return allocate(size); }
+			const Size adjusted = adjustSize(size);
+			if (adjusted == 0) { return nullptr; }
+			// Enough space to align and put the gap back as a free block
+			const Size gapMinimum = sizeof(Block);
+			const Size withGap = adjustSize(adjusted + 2 * align + gapMinimum);
+			if (withGap == 0) { return nullptr; }
+			Size fl, sl;
+			mappingSearch(withGap, fl, sl);
+			Lock lock(mMutex);
+			Block* block = search(fl, sl);
+			if (block == nullptr) { return nullptr; } // ! No memory left
+			remove(block);
+
+			const Pointer start = Pointer(payload(block));
+			Pointer aligned = alignUp(start, align);
+			Size gap = aligned - start;
+			if (gap != 0 && gap < gapMinimum) {
+				// Too small for a free block, move to the next aligned address
+				const Size missing = gapMinimum - gap;
+				aligned = alignUp(aligned + (align < missing ? missing : align), align);
+				gap = aligned - start;
+			}
+			if (gap != 0) { block = trimFreeLeading(block, gap); }
+			TKLB_ASSERT(Pointer(payload(block)) % align == 0)
+			return prepareUsed(block, adjusted);
+		}
+
+		void deallocate(void* ptr) {
+			if (ptr == nullptr) { return; }
+			Block* block = fromPayload(ptr);
+			TKLB_ASSERT(!isFree(block)) // ! Double free
+			#ifdef TKLB_MEMORY_CHECK
+				// Pattern to spot use after free
+				set<Byte>(payload(block), sizeOf(block) - sizeof(Block*), 123);
+			#endif
+			Lock lock(mMutex);
+			mAllocated -= sizeOf(block) + Overhead;
+			markFree(block);
+			block = mergePrev(block);
+			block = mergeNext(block);
+			insert(block);
+		}
+
+		/**
+		 * @brief Grows or shrinks in place if the following block allows it,
+		 *        otherwise moves the memory. Acts like realloc.
+		 */
+		void* reallocate(void* ptr, Size size) {
+			if (ptr == nullptr) { return allocate(size); }
+			if (size == 0) {
+				deallocate(ptr);
+				return nullptr;
+			}
+			const Size adjusted = adjustSize(size);
+			if (adjusted == 0) { return nullptr; }
+			Block* block = fromPayload(ptr);
+			const Size current = sizeOf(block);
+			{
+				Lock lock(mMutex);
+				Block* following = next(block);
+				const Size combined = current + sizeOf(following) + Overhead;
+				if (adjusted <= current || (isFree(following) && adjusted <= combined)) {
+					if (current < adjusted) {
+						mergeNext(block);
+						markUsed(block);
+					}
+					trimUsed(block, adjusted);
+					mAllocated += sizeOf(block);
+					mAllocated -= current;
+					return ptr;
+				}
+			}
+			void* moved = allocate(size);
+			if (moved == nullptr) { return nullptr; }
+			copy(moved, ptr, current < size ? current : size);
+			deallocate(ptr);
+			return moved;
+		}
+
+		/**
+		 * @brief Walks all blocks and checks their links and flags, for debugging.
+		 *        Not thread safe.
+		 * @return False if the pool is corrupt
+		 */
+		bool check() const {
+			if (mFirst == nullptr) { return false; }
+			bool prevFree = false;
+			Size used = 0;
+			for (const Block* block = mFirst; sizeOf(block) != 0; block = next(block)) {
+				const bool free = isFree(block);
+				if (((block->size & PrevFreeBit) != 0) != prevFree) { return false; }
+				if (free && prevFree) { return false; } // Should have been merged
+				if (free && next(block)->prevPhysical != block) { return false; }
+				if (!free) { used += sizeOf(block) + Overhead; }
+				prevFree = free;
+			}
+			return used == mAllocated;
+		}
+	};
+
+	/**
+	 * @brief HeapBuffer compatible allocator using a Tlsf pool
+	 * @tparam POOL Type with a static Tlsf& pool() function
+	 * @tparam T Element to allocate
+	 * @tparam NAME In case the allocation are tracked, the allocator can have a name
+	 */
+	template <class POOL, class T = unsigned char, class NAME = DefaultAllocatorName>
+	struct TlsfAllocator {
+		typedef T value_type;
+
+		constexpr TlsfAllocator() = default;
+		constexpr TlsfAllocator(const TlsfAllocator&) = default;
+
+		template <class U, class NAME2>
+		constexpr TlsfAllocator(const TlsfAllocator<POOL, U, NAME2>&) { }
+
+		T* allocate(SizeT n) const noexcept {
+			const auto bytes = n * sizeof(T);
+			if (auto ptr = static_cast<T*>(POOL::pool().allocate(bytes))) {
+				TKLB_PROFILER_MALLOC_L(ptr, bytes, NAME::Name)
+				TKLB_STATS_MALLOC(bytes, NAME)
+				return ptr;
+			}
+			return nullptr;
+		}
+
+		T* allocate(SizeT n, SizeT alignment) const noexcept {
+			const auto bytes = n * sizeof(T);
+			if (auto ptr = static_cast<T*>(POOL::pool().allocate(bytes, alignment))) {
+				TKLB_PROFILER_MALLOC_L(ptr, bytes, NAME::Name)
+				TKLB_STATS_MALLOC(bytes, NAME)
+				return ptr;
+			}
+			return nullptr;
+		}
+
+		/**
+		 * @brief Grows in place if the following block is free
+		 */
+		T* reallocate(T* ptr, SizeT n, SizeT size) const noexcept {
+			(void) n;
+			const auto bytes = size * sizeof(T);
+			if (auto moved = static_cast<T*>(POOL::pool().reallocate(ptr, bytes))) {
+				if (ptr != nullptr) { TKLB_PROFILER_FREE_L(ptr, NAME::Name) }
+				TKLB_STATS_FREE(ptr, n * sizeof(T), NAME)
+				TKLB_PROFILER_MALLOC_L(moved, bytes, NAME::Name)
+				TKLB_STATS_MALLOC(bytes, NAME)
+				return moved;
+			}
+			return nullptr;
+		}
+
+		void deallocate(T* ptr, SizeT n) const noexcept {
+			(void) n;
+			TKLB_PROFILER_FREE_L(ptr, NAME::Name)
+			TKLB_STATS_FREE(ptr, n * sizeof(T), NAME)
+			POOL::pool().deallocate(ptr);
+		}
+
+		void deallocate(T* ptr, SizeT n, SizeT alignment) const noexcept {
+			(void) alignment;
+			deallocate(ptr, n);
+		}
+	};
+
+} } // namespace tklb::memory
+
+#endif // _TKLB_TLSF
@@ -0,0 +1,265 @@
+#ifndef _TKLB_CONCURRENT_HANDLE_BUFFER
+#define _TKLB_CONCURRENT_HANDLE_BUFFER
+
+#include "./THeapBuffer.hpp"
+
+#ifndef TKLB_NO_STDLIB
+
+#include <atomic>
+
+namespace tklb {
+	/**
+	 * @brief HandleBuffer which can be used from several threads at once without locks.
+	 * @details The capacity is fixed, create fails once all slots are taken.
+	 *          Free slots form a lock free stack whose head is a handle, so the
+	 *          generation bits double as the tag against the ABA problem.
+	 *          Each slot has an atomic state with the generation and whether it's
+	 *          alive, at() validates against it.
+	 *
+	 *          remove() only retires an element, it stays constructed until collect()
+	 *          finds no reader left which entered its ReadScope before the element was retired.
+	 *          So pointers from at() or iterate() stay valid for the whole ReadScope even if
+	 *          another thread removes the element.
+	 *          Like EventBus, readers count themselves per epoch parity. collect() flips the
+	 *          epoch and only waits for the readers of the previous one, so elements get
+	 *          collected even if new ReadScopes keep starting all the time.
+	 *          Readers never wait, collect() simply retries on the next call.
+	 *          Everything but collect() and the destructor is realtime safe.
+	 * @tparam T type to store, the destructor runs on the thread calling collect()
+	 * @tparam Handle type to index elements
+	 * @tparam GenerationBits At what bit to split the Handle for validation, defaults to 8 bits.
+	 */
+	template <class T, typename Handle = unsigned int, int GenerationBits = 8, class ALLOCATOR = DefaultAllocator<>>
+	class ConcurrentHandleBuffer {
+		static constexpr Handle MaskBits 		= sizeof(Handle) * 8 - GenerationBits;
+		static constexpr Handle MaskIndex		= (Handle(1) << MaskBits) - 1;
+		static constexpr Handle MaskGeneration	= ~MaskIndex;
+		static constexpr Handle NextGeneration	= MaskIndex + 1;
+
+		/**
+		 * @brief Lower bits of a slot state, the generation sits above MaskBits
+		 */
+		enum Status : Handle {
+			Free = 0,
+			Alive = 1,
+			Retired = 2		///< Removed, waiting for collect()
+		};
+
+		struct Slot {
+			std::atomic<Handle> state = { Free };	///< Generation | Status
+			std::atomic<Handle> next = { 0 };		///< Handle of the next slot in the free or retired stack
+			alignas(T) char value[sizeof(T)];		///< Space for the element
+		};
+
+		HeapBuffer<Slot, 0, ALLOCATOR> mSlots;
+		std::atomic<Handle> mFree = { InvalidHandle };		///< Head of the free stack
+		std::atomic<Handle> mRetired = { InvalidHandle };	///< Head of the retired stack
+		std::atomic<Handle> mCount = { 0 };
+		mutable std::atomic<Handle> mEpoch = { 0 };
+		mutable std::atomic<Handle> mReaders[2] = { };	///< ReadScopes per epoch parity
+		std::atomic<bool> mCollecting = { false };
+		Handle mWaiting = InvalidHandle;	///< Taken from the retired stack, waits for the readers of mWaitParity
+		Handle mWaitParity = 0;
+
+		/**
+		 * @brief Destroys a list of retired elements and puts their slots on the free stack
+		 */
+		Handle destroy(Handle handle) {
+			Handle destroyed = 0;
+			while (handle != InvalidHandle) {
+				const Handle index = handle & MaskIndex;
+				Slot& slot = mSlots[index];
+				const Handle next = slot.next.load();
+				value(index)->~T();
+				const Handle generation = Handle((handle & MaskGeneration) + NextGeneration);
+				slot.state.store(generation | Free, std::memory_order_release);
+				push(mFree, index | generation, index | generation);
+				handle = next;
+				destroyed++;
+			}
+			return destroyed;
+		}
+
+		T* value(Handle index) const {
+			return (T*) mSlots[index].value;
+		}
+
+		void push(std::atomic<Handle>& head, Handle first, Handle last) {
+			Handle top = head.load();
+			do {
+				mSlots[last & MaskIndex].next.store(top);
+			} while (!head.compare_exchange_weak(top, first));
+		}
+
+	public:
+		static constexpr Handle InvalidHandle = ~0;
+
+		/**
+		 * @brief Marks the calling thread as reading for its lifetime,
+		 *        retired elements aren't destroyed in the meantime.
+		 *        Can be nested and used from any number of threads.
+		 */
+		class ReadScope {
+			const ConcurrentHandleBuffer& mBuffer;
+			Handle mParity;
+		public:
+			ReadScope(const ConcurrentHandleBuffer& buffer) : mBuffer(buffer) {
+				while (true) {
+					mParity = mBuffer.mEpoch.load() & 1;
+					mBuffer.mReaders[mParity]++;
+					// collect() might have flipped the epoch before seeing the count
+					if ((mBuffer.mEpoch.load() & 1) == mParity) { break; }
+					mBuffer.mReaders[mParity]--;
+				}
+			}
+			~ReadScope() { mBuffer.mReaders[mParity]--; }
+			ReadScope(const ReadScope&) = delete;
+			ReadScope& operator=(const ReadScope&) = delete;
+		};
+
+		ConcurrentHandleBuffer(Handle size) { resize(size); }
+		ConcurrentHandleBuffer() { }
+
+		ConcurrentHandleBuffer(const ConcurrentHandleBuffer&) = delete;
+		ConcurrentHandleBuffer& operator=(const ConcurrentHandleBuffer&) = delete;
+
+		~ConcurrentHandleBuffer() { resize(0); }
+
+		/**
+		 * @brief Number of slots
+		 */
+		Handle size() const { return mSlots.size(); }
+
+		/**
+		 * @brief Number of live elements, retired ones don't count
+		 */
+		Handle count() const { return mCount.load(std::memory_order_relaxed); }
+
+		/**
+		 * @brief Sets the capacity, destroys all elements.
+		 *        Not thread safe, only call it while no other thread uses the buffer.
+		 */
+		bool resize(Handle size) {
+			TKLB_ASSERT(size < MaskIndex) // Needs to be smaller than MaskIndex!
+			for (Handle i = 0; i < mSlots.size(); i++) {
+				if ((mSlots[i].state.load() & MaskIndex) != Free) { value(i)->~T(); }
+			}
+			mFree = InvalidHandle;
+			mRetired = InvalidHandle;
+			mWaiting = InvalidHandle;
+			mCount = 0;
+			if (!mSlots.resize(0) || !mSlots.resize(size)) { return false; }
+			for (Handle i = 0; i < size; i++) {
+				mSlots[i].next.store(i + 1 < size ? i + 1 : InvalidHandle, std::memory_order_relaxed);
+			}
+			if (size != 0) { mFree = 0; }
+			return true;
+		}
+
+		/**
+		 * @brief Get pointer for a handle, only use it inside a ReadScope
+		 *        when other threads might remove the element.
+		 * @return T* nullptr if the handle is invalid or the element was removed.
+		 */
+		T* at(const Handle& handle) const {
+			if (handle == InvalidHandle) { return nullptr; }
+			const Handle index = handle & MaskIndex;
+			if (mSlots.size() <= index) { return nullptr; }
+			// Sequentially consistent so it can't move before entering a ReadScope
+			const Handle state = mSlots[index].state.load();
+			if (state != ((handle & MaskGeneration) | Alive)) { return nullptr; }
+			return value(index);
+		}
+
+		bool has(const Handle& handle) const { return at(handle) != nullptr; }
+
+		/**
+		 * @brief Takes a free slot and calls the default constructor for T
+		 * @return Handle A valid handle, InvalidHandle if all slots are taken
+		 */
+		Handle create() {
+			Handle top = mFree.load(std::memory_order_acquire);
+			do {
+				if (top == InvalidHandle) { return InvalidHandle; }
+				// The slot might get taken in the meantime, the generation in top catches that
+			} while (!mFree.compare_exchange_weak(
+				top, mSlots[top & MaskIndex].next.load(std::memory_order_relaxed),
+				std::memory_order_acquire, std::memory_order_acquire
+			));
+			const Handle index = top & MaskIndex;
+			new (value(index)) T();
+			mCount.fetch_add(1, std::memory_order_relaxed);
+			mSlots[index].state.store((top & MaskGeneration) | Alive, std::memory_order_release);
+			return top;
+		}
+
+		/**
+		 * @brief Invalidates the handle, the element is destroyed later by collect().
+		 *        Never blocks or frees memory.
+		 * @return true if the handle was valid
+		 */
+		bool remove(const Handle& handle) {
+			if (handle == InvalidHandle) { return false; }
+			const Handle index = handle & MaskIndex;
+			if (mSlots.size() <= index) { return false; }
+			Handle expected = (handle & MaskGeneration) | Alive;
+			const Handle retired = (handle & MaskGeneration) | Retired;
+			if (!mSlots[index].state.compare_exchange_strong(expected, retired)) {
+				return false; // Already removed or a old handle
+			}
+			mCount.fetch_sub(1, std::memory_order_relaxed);
+			push(mRetired, handle, handle);
+			return true;
+		}
+
+		/**
+		 * @brief Destroys the retired elements and frees their slots
+		 *        once the ReadScopes which were active when they got retired ended.
+		 *        Never waits, returns right away if another thread is collecting.
+		 * @return Handle Number of elements destroyed
+		 */
+		Handle collect() {
+			if (mCollecting.exchange(true)) { return 0; }
+			Handle destroyed = 0;
+			if (mWaiting != InvalidHandle && mReaders[mWaitParity].load() == 0) {
+				destroyed += destroy(mWaiting);
+				mWaiting = InvalidHandle;
+			}
+			if (mWaiting == InvalidHandle) {
+				mWaiting = mRetired.exchange(InvalidHandle);
+				if (mWaiting != InvalidHandle) {
+					// Readers entering from now on can't reach anything on the taken stack
+					// and count themselves with the other parity
+					mWaitParity = mEpoch.fetch_add(1) & 1;
+					if (mReaders[mWaitParity].load() == 0) {
+						destroyed += destroy(mWaiting);
+						mWaiting = InvalidHandle;
+					}
+				}
+			}
+			mCollecting = false;
+			return destroyed;
+		}
+
+		/**
+		 * @brief Calls func for each live element inside a ReadScope.
+		 *        Walks all slots, elements created or removed meanwhile might be skipped.
+		 * @param func Func A lambda called for each valid element
+		 */
+		template <class Func>
+		void iterate(Func&& func) {
+			ReadScope scope(*this);
+			for (Handle i = 0; i < mSlots.size(); i++) {
+				const Handle state = mSlots[i].state.load();
+				if ((state & MaskIndex) == Alive) {
+					func(*value(i), i | (state & MaskGeneration));
+				}
+			}
+		}
+	};
+
+} // namespace tklb
+
+#endif // TKLB_NO_STDLIB
+
+#endif // _TKLB_CONCURRENT_HANDLE_BUFFER
@@ -1,59 +1,175 @@
 #ifndef _TKLB_DELEGATE
 #define _TKLB_DELEGATE
 
+#include "./TTypes.hpp"
+#include "../util/TTraits.hpp"
+#include "../memory/TNew.hpp"
+
 namespace tklb {
 	/**
-	 * Stripped down version of this delegate implementation
+	 * Based on this delegate implementation
 	 * https://github.com/marcmo/delegates/tree/f0938dac2ad779226ef637da350e964ac8008ba5
-	 * Stripped return value, const and free function version
-	 * TODO tklb add return type back in
+	 * extended with inline storage for small callables.
 	 */
 
-	template<typename... Parameters>
-	class BaseDelegate {
-	protected:
-		using Callback = void (*)(void*, Parameters...);
-		void* mContext; 			// Object instance
-		Callback mCallback;			// Static function in factory to make the call to the correct type
+	template<typename Signature, SizeT STORAGE = sizeof(void*) * 2>
+	class Delegate;
+
+	/**
+	 * @brief Type erased callable which never allocates and is trivially copyable.
+	 *        Holds a free function, a (const) member function with its object
+	 *        or a trivially copyable lambda/functor of up to STORAGE bytes.
+	 *        A call costs one indirect call, same as a function pointer.
+	 * @tparam R Return type
+	 * @tparam STORAGE Bytes for inline lambdas, defaults to two pointers
+	 *         which fits a lambda capturing two references
+	 */
+	template<typename R, typename... Parameters, SizeT STORAGE>
+	class Delegate<R(Parameters...), STORAGE> {
 	public:
-		BaseDelegate(void* context, Callback func) : mContext(context), mCallback(func) { }
-		void operator()(Parameters... parameters) const {
-			(*mCallback)(mContext, parameters...);
+		using Function = R (*)(Parameters...);
+		using Callback = R (*)(void*, Parameters...);	///< Context and the parameters
+
+	private:
+		using Invoke = R (*)(void*, Parameters...);		///< Storage and the parameters
+
+		/**
+		 * @brief Layout of a delegate created from a context and a callback
+		 */
+		struct Bound {
+			void* context;
+			Callback callback;
+		};
+
+		static constexpr SizeT Size = sizeof(Bound) < STORAGE ? STORAGE : sizeof(Bound);
+
+		alignas(void*) mutable unsigned char mStorage[Size] = { };
+		Invoke mInvoke = nullptr;
+
+		template<Function Func>
+		static R callFunction(void*, Parameters... parameters) {
+			return Func(parameters...);
 		}
-		bool valid() const { return mCallback != nullptr; }
-	};
 
-	template<typename... Parameters>
-	struct Delegate;
+		static R callPointer(void* storage, Parameters... parameters) {
+			return (*static_cast<Function*>(storage))(parameters...);
+		}
+
+		static R callBound(void* storage, Parameters... parameters) {
+			Bound* bound = static_cast<Bound*>(storage);
+			return bound->callback(bound->context, parameters...);
+		}
+
+		template<class T, R (T::*Func)(Parameters...)>
+		static R callMember(void* storage, Parameters... parameters) {
+			return ((*static_cast<T**>(storage))->*Func)(parameters...);
+		}
 
-	template<typename... Parameters>
-	struct Delegate<void(Parameters...)> : public BaseDelegate<Parameters...> {
-		using Base = BaseDelegate<Parameters...> ;
-		Delegate(void* context, typename Base::Callback func) : Base(context, func) { }
-		Delegate() : Base(nullptr, nullptr) { }
+		template<class T, R (T::*Func)(Parameters...) const>
+		static R callConstMember(void* storage, Parameters... parameters) {
+			return ((*static_cast<const T**>(storage))->*Func)(parameters...);
+		}
+
+		template<class Func>
+		static R callFunctor(void* storage, Parameters... parameters) {
+			return (*static_cast<Func*>(storage))(parameters...);
+		}
+
+		template<class Value>
+		void store(const Value& value, Invoke invoke) {
+			static_assert(sizeof(Value) <= Size, "Callable too big, raise STORAGE");
+			static_assert(alignof(Value) <= alignof(void*), "Callable alignment not supported");
+			static_assert(traits::IsTriviallyCopyable<Value>::value, "Callable needs to be trivially copyable");
+			new (mStorage) Value(value);
+			mInvoke = invoke;
+		}
 
+	public:
+		Delegate() { }
+
+		/**
+		 * @brief Calls func with the context as first argument
+		 */
+		Delegate(void* context, Callback func) {
+			if (func == nullptr) { return; }
+			store(Bound { context, func }, &callBound);
+		}
+
+		/**
+		 * @brief Free function known at runtime
+		 */
+		Delegate(Function func) {
+			if (func == nullptr) { return; }
+			store(func, &callPointer);
+		}
+
+		/**
+		 * @brief Lambda or functor, copied into the delegate
+		 */
+		template<class Func>
+		Delegate(const Func& func) {
+			store(func, &callFunctor<Func>);
+		}
+
+		/**
+		 * @brief Free function known at compile time, doesn't need any storage
+		 */
+		template<Function Func>
+		static Delegate function() {
+			Delegate delegate;
+			delegate.mInvoke = &callFunction<Func>;
+			return delegate;
+		}
+
+		template<class T, R (T::*Func)(Parameters...)>
+		static Delegate member(T* object) {
+			Delegate delegate;
+			delegate.store(object, &callMember<T, Func>);
+			return delegate;
+		}
+
+		template<class T, R (T::*Func)(Parameters...) const>
+		static Delegate member(const T* object) {
+			Delegate delegate;
+			delegate.store(object, &callConstMember<T, Func>);
+			return delegate;
+		}
+
+		R operator()(Parameters... parameters) const {
+			return mInvoke(mStorage, parameters...);
+		}
+
+		bool valid() const { return mInvoke != nullptr; }
 	};
 
 	/**
-	 * A factory is needed to ba able to convert the void pointer back
-	 * to the object and call the member function
+	 * A factory is needed to deduce the types from the member function pointer
+	 * before it can be passed as a template argument
 	 */
-	template<typename T, typename... Parameters>
+	template<typename R, typename T, typename... Parameters>
 	struct DelegateFactory {
-		template<void (T::*Func)(Parameters...)>
-		static void Call(void* context, Parameters... parameters) {
-			(static_cast<T*>(context)->*Func)(parameters...);
+		template<R (T::*Func)(Parameters...)>
+		inline static Delegate<R(Parameters...)> Create(T* context) {
+			return Delegate<R(Parameters...)>::template member<T, Func>(context);
 		}
+	};
 
-		template<void (T::*Func)(Parameters...)>
-		inline static Delegate<void(Parameters...)> Create(T* context) {
-			return Delegate<void(Parameters...)>(context, &DelegateFactory::Call<Func>);
+	template<typename R, typename T, typename... Parameters>
+	struct DelegateFactoryConst {
+		template<R (T::*Func)(Parameters...) const>
+		inline static Delegate<R(Parameters...)> Create(const T* context) {
+			return Delegate<R(Parameters...)>::template member<T, Func>(context);
 		}
 	};
 
-	template<typename T, typename... Parameters>
-	DelegateFactory<T, Parameters...> MakeDelegate(void (T::*)(Parameters...)) {
-		return DelegateFactory<T, Parameters...>();
+	template<typename R, typename T, typename... Parameters>
+	DelegateFactory<R, T, Parameters...> MakeDelegate(R (T::*)(Parameters...)) {
+		return DelegateFactory<R, T, Parameters...>();
+	}
+
+	template<typename R, typename T, typename... Parameters>
+	DelegateFactoryConst<R, T, Parameters...> MakeDelegate(R (T::*)(Parameters...) const) {
+		return DelegateFactoryConst<R, T, Parameters...>();
 	}
 
 	#define TKLB_DELEGATE(func, thisPrtRef) (tklb::MakeDelegate(func).Create<func>(&thisPrtRef))
@@ -5,6 +5,12 @@
 
 #include "./TMutexDummy.hpp"
 #include "./TDelegate.hpp"
+#include "./TSpinLock.hpp"
+
+#ifndef TKLB_NO_STDLIB
+	#include <atomic>
+	#include <thread>
+#endif
 
 #ifndef TKLB_ASSERT
 	#define TKLB_ASSERT(cond)
@@ -12,27 +18,302 @@
 
 namespace tklb {
 	/**
+	 * @brief Calls the subscribers of an event when it's fired.
+	 * @details Each event has an immutable snapshot of its subscribers.
+	 *          Firing reads the current snapshot without locking or waiting,
+	 *          so it's safe from the audio thread.
+	 *          Subscribing publishes a new snapshot, the old one is freed once
+	 *          no fireEvent might still be reading it.
+	 *          Unsubscribing waits for running fireEvent calls so the callback isn't
+	 *          called after the Subscription is gone. Therefore a Subscription of
+	 *          this bus must not be destroyed from inside one of its callbacks.
 	 *
+	 *          Events can also be delivered later, see setDelivery(). fireEvent then
+	 *          copies the parameters into a preallocated queue and dispatch() calls
+	 *          the subscribers on whichever thread calls it.
+	 * @tparam MutexType Serializes subscribing, needs to be a real mutex
+	 *         if subscriptions change from more than one thread
+	 * @tparam PAYLOAD Bytes available for the parameters of a queued event
 	 */
-	template <int EVENT_COUNT, typename EventId = int, class MutexType = MutexDummy>
+	template <int EVENT_COUNT, typename EventId = int, class MutexType = MutexDummy, SizeT PAYLOAD = 32>
 	class EventBus {
 		class BaseSubscription;
-		using Subscriptions = HeapBuffer<BaseSubscription*>;
+		using Size = SizeT;
+
+	#ifndef TKLB_NO_STDLIB
+		template <typename V>
+		using Atomic = std::atomic<V>;
+	#else
+		template <typename V>
+		using Atomic = V;
+	#endif
+
+		/**
+		 * @brief Never changed once published, the subscribers follow it in memory
+		 */
+		struct Snapshot {
+			Size count;
+			Snapshot* retired;		///< Next snapshot waiting to be freed
+			BaseSubscription** subscribers() { return reinterpret_cast<BaseSubscription**>(this + 1); }
+		};
 
-		Subscriptions mEvents[EVENT_COUNT];
+		Atomic<Snapshot*> mEvents[EVENT_COUNT] = { };
+		Atomic<unsigned int> mEpoch = { 0 };
+		Atomic<unsigned int> mReaders[2] = { };	///< fireEvent calls running, per epoch parity
+		Snapshot* mRetired = nullptr;			///< Guarded by mMutex
 		MutexType mMutex;
 		using Lock = typename MutexType::Lock;
 
+	public:
+		enum class Delivery {
+			Immediate = 0,	///< Subscribers are called by fireEvent
+			Queued,			///< Every event is queued until dispatch()
+			/**
+			 * Only the last event since the previous dispatch() is delivered.
+			 * A producer firing while another one writes the same event waits
+			 * up to MaxCoalescedSpins pauses so the later value still wins,
+			 * after that it's dropped and counted in overflows().
+			 */
+			Coalesced
+		};
+
+	private:
+	#ifndef TKLB_NO_STDLIB
+		using Invoke = void (*)(EventBus&, const void*);
+		static constexpr Size PayloadAlignment = 16;
+		static constexpr Size PayloadWords = (PAYLOAD + sizeof(unsigned int) - 1) / sizeof(unsigned int);
+		static constexpr int MaxCoalescedSpins = 256;
+
+		/**
+		 * @brief Element of the bounded multi producer queue, the sequence tells
+		 *        whether it's free to write or ready to read for the current lap
+		 */
+		struct Cell {
+			std::atomic<Size> sequence = { 0 };
+			Invoke invoke = nullptr;
+			alignas(PayloadAlignment) unsigned char payload[PAYLOAD];
+		};
+
+		/**
+		 * @brief Last value of a coalesced event, guarded by a sequence lock so
+		 *        dispatch() never blocks the producer
+		 */
+		struct Latest {
+			std::atomic<bool> writing = { false };		///< Producers only wait a bounded time for each other
+			std::atomic<bool> pending = { false };
+			std::atomic<unsigned int> sequence = { 0 };	///< Odd while written
+			std::atomic<Invoke> invoke = { nullptr };
+			std::atomic<unsigned int> payload[PayloadWords] = { };
+		};
+
+		Delivery mDelivery[EVENT_COUNT] = { };
+		HeapBuffer<Cell> mQueue;
+		std::atomic<Size> mEnqueue = { 0 };
+		Size mDequeue = 0;						///< Only touched by dispatch()
+		Latest mLatest[EVENT_COUNT];
+		std::atomic<Size> mOverflows = { 0 };
+		std::atomic<Size> mCoalesced = { 0 };
+
+		template <class Func>
+		static void invoke(EventBus& bus, const void* payload) {
+			(*reinterpret_cast<const Func*>(payload))(bus);
+		}
+
+		template <class Func>
+		void post(const EventId eventId, const Func& func, traits::Value<false>) {
+			(void) eventId;
+			TKLB_ASSERT(false) // ! Parameters need to be trivially copyable and fit into PAYLOAD
+			func(*this);
+		}
+
+		template <class Func>
+		void post(const EventId eventId, const Func& func, traits::Value<true>) {
+			if (mDelivery[eventId] == Delivery::Coalesced) {
+				store(eventId, func);
+			} else {
+				enqueue(func);
+			}
+		}
+
+		template <class Func>
+		void enqueue(const Func& func) {
+			const Size size = mQueue.size();
+			if (size == 0) { mOverflows++; return; }
+			Size position = mEnqueue.load(std::memory_order_relaxed);
+			Cell* cell;
+			while (true) {
+				cell = &mQueue[position & (size - 1)];
+				const Size sequence = cell->sequence.load(std::memory_order_acquire);
+				const long long lap = static_cast<long long>(sequence - position);
+				if (lap == 0) {
+					if (mEnqueue.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+						break;
+					}
+				} else if (lap < 0) {
+					mOverflows++; // Full
+					return;
+				} else {
+					position = mEnqueue.load(std::memory_order_relaxed);
+				}
+			}
+			new (cell->payload) Func(func);
+			cell->invoke = &invoke<Func>;
+			cell->sequence.store(position + 1, std::memory_order_release);
+		}
+
+		template <class Func>
+		void store(const EventId eventId, const Func& func) {
+			Latest& latest = mLatest[eventId];
+			// Writing only takes a copy of the payload, so wait a little for the
+			// other producer instead of dropping the newer value
+			int spins = 0;
+			while (latest.writing.exchange(true, std::memory_order_acquire)) {
+				if (MaxCoalescedSpins <= spins) {
+					mOverflows++; // The other producer got preempted while writing
+					return;
+				}
+				while (latest.writing.load(std::memory_order_relaxed) && spins < MaxCoalescedSpins) {
+					SpinLockBase::pause();
+					spins++;
+				}
+			}
+			alignas(PayloadAlignment) unsigned int words[PayloadWords] = { };
+			memory::copy(words, &func, sizeof(Func));
+			const unsigned int sequence = latest.sequence.load(std::memory_order_relaxed);
+			latest.sequence.store(sequence + 1, std::memory_order_relaxed);
+			// Release keeps the odd sequence ahead of the payload
+			for (Size i = 0; i < PayloadWords; i++) {
+				latest.payload[i].store(words[i], std::memory_order_release);
+			}
+			latest.invoke.store(&invoke<Func>, std::memory_order_release);
+			latest.sequence.store(sequence + 2, std::memory_order_release);
+			if (latest.pending.exchange(true, std::memory_order_acq_rel)) {
+				mCoalesced++; // Replaced a value nobody saw
+			}
+			latest.writing.store(false, std::memory_order_release);
+		}
+
+		/**
+		 * @brief Reads a coalesced event, gives up after a few tries if producers keep writing
+		 */
+		bool load(Latest& latest, unsigned int* words, Invoke& func) {
+			for (int attempt = 0; attempt < 8; attempt++) {
+				const unsigned int sequence = latest.sequence.load(std::memory_order_acquire);
+				if (sequence & 1) { continue; }
+				// Acquire keeps the second sequence read behind the payload
+				for (Size i = 0; i < PayloadWords; i++) {
+					words[i] = latest.payload[i].load(std::memory_order_acquire);
+				}
+				func = latest.invoke.load(std::memory_order_acquire);
+				if (latest.sequence.load(std::memory_order_relaxed) == sequence) { return true; }
+			}
+			return false;
+		}
+	#endif // TKLB_NO_STDLIB
+
+		template<typename... Parameters>
+		void deliver(const EventId eventId, Parameters... param) {
+			if (mEvents[eventId] == nullptr) { return; } // nothing to protect
+			const unsigned int parity = mEpoch & 1;
+			mReaders[parity]++;
+			Snapshot* snapshot = mEvents[eventId];
+			const Size count = snapshot == nullptr ? 0 : snapshot->count;
+			for (Size i = 0; i < count; i++) {
+				#ifdef TKLB_MEMORY_CHECK
+					auto sub = dynamic_cast<Subscription<Parameters...>*>(snapshot->subscribers()[i]);
+					TKLB_ASSERT(sub != nullptr)
+				#else
+					auto sub = reinterpret_cast<Subscription<Parameters...>*>(snapshot->subscribers()[i]);
+				#endif // TKLB_MEMORY_CHECK
+				sub->mCallback(param...);
+			}
+			mReaders[parity]--;
+		}
+
+		/**
+		 * @brief Copies the current snapshot with sub added or removed and publishes it
+		 * @return false if there was nothing to remove
+		 */
+		bool publish(BaseSubscription* sub, const EventId eventId, bool add) {
+			Snapshot* old = mEvents[eventId];
+			const Size count = old == nullptr ? 0 : old->count;
+			Size found = count;
+			for (Size i = 0; i < count; i++) {
+				if (old->subscribers()[i] == sub) { found = i; break; }
+			}
+			if (!add && found == count) { return false; }
+			const Size size = add ? count + 1 : count - 1;
+
+			Snapshot* next = nullptr;
+			if (size != 0) {
+				void* memory = TKLB_MALLOC(sizeof(Snapshot) + sizeof(BaseSubscription*) * size)
+				TKLB_ASSERT(memory != nullptr)
+				next = reinterpret_cast<Snapshot*>(memory);
+				next->count = size;
+				next->retired = nullptr;
+				Size j = 0;
+				for (Size i = 0; i < count; i++) {
+					if (add || i != found) { next->subscribers()[j++] = old->subscribers()[i]; }
+				}
+				if (add) { next->subscribers()[j] = sub; }
+			}
+			mEvents[eventId] = next;
+
+			if (old != nullptr) {
+				old->retired = mRetired;
+				mRetired = old;
+			}
+			return true;
+		}
+
+		/**
+		 * @brief Waits until every fireEvent which started before returned.
+		 *        Two rounds, since a reader might have read the epoch right before the
+		 *        first flip and still registered with the old parity.
+		 */
+		void synchronize() {
+			for (int round = 0; round < 2; round++) {
+				const unsigned int epoch = mEpoch;
+				mEpoch = epoch + 1;
+				while (mReaders[epoch & 1] != 0) {
+					#ifndef TKLB_NO_STDLIB
+						std::this_thread::yield();
+					#endif
+				}
+			}
+		}
+
+		/**
+		 * @brief Frees the retired snapshots, waits for readers or only frees them
+		 *        if there are none right now
+		 */
+		void reclaim(bool wait) {
+			if (mRetired == nullptr) { return; }
+			if (wait) {
+				synchronize();
+			} else if (mReaders[0] != 0 || mReaders[1] != 0) {
+				return; // Next time
+			}
+			while (mRetired != nullptr) {
+				Snapshot* next = mRetired->retired;
+				TKLB_FREE(mRetired)
+				mRetired = next;
+			}
+		}
+
 		void addSubscriber(BaseSubscription* sub, const EventId eventId) {
 			TKLB_ASSERT(eventId < EVENT_COUNT)
 			Lock lock(mMutex);
-			mEvents[eventId].push(sub);
+			publish(sub, eventId, true);
+			reclaim(false);
 		}
 
 		void removeSubscriber(BaseSubscription* sub, const EventId eventId) {
 			TKLB_ASSERT(eventId < EVENT_COUNT)
 			Lock lock(mMutex);
-			mEvents[eventId].remove(sub);
+			if (publish(sub, eventId, false)) {
+				reclaim(true);
+			}
 		}
 
 		class BaseSubscription {
@@ -42,7 +323,18 @@ namespace tklb {
 
 	public:
 		EventBus() { }
-		~EventBus() { }
+
+		/**
+		 * @brief All Subscriptions need to be gone before
+		 */
+		~EventBus() {
+			for (int i = 0; i < EVENT_COUNT; i++) {
+				TKLB_ASSERT(mEvents[i] == nullptr)
+				Snapshot* snapshot = mEvents[i];
+				if (snapshot != nullptr) { TKLB_FREE(snapshot) }
+			}
+			reclaim(true);
+		}
 
 		template<typename... Parameters>
 		class Subscription : public BaseSubscription {
@@ -56,32 +348,108 @@ namespace tklb {
 			~Subscription();
 		};
 
+		/**
+		 * @brief Calls all subscribers of the event or queues it, never locks or allocates
+		 */
 		template<typename... Parameters>
 		void fireEvent(const EventId eventId, Parameters... param) {
 			TKLB_ASSERT(eventId < EVENT_COUNT)
-			if (mEvents[eventId].size() == 0) { return; } // don't even wait for lock
-			Lock lock(mMutex);
-			for (typename Subscriptions::Size i = 0; i < mEvents[eventId].size(); i++) {
-				#ifdef TKLB_MEMORY_CHECK
-					auto sub = dynamic_cast<Subscription<Parameters...>*>(mEvents[eventId][i]);
-					TKLB_ASSERT(sub != nullptr)
-				#else
-					auto sub = reinterpret_cast<Subscription<Parameters...>*>(mEvents[eventId][i]);
-				#endif // TKLB_MEMORY_CHECK
-				sub->mCallback(param...);
+		#ifndef TKLB_NO_STDLIB
+			if (mDelivery[eventId] != Delivery::Immediate) {
+				if (mEvents[eventId] == nullptr) { return; } // Nobody listens
+				auto call = [eventId, param...](EventBus& bus) {
+					bus.template deliver<Parameters...>(eventId, param...);
+				};
+				using Call = decltype(call);
+				post(eventId, call, traits::Value<
+					traits::IsTriviallyCopyable<Call>::value && sizeof(Call) <= PAYLOAD
+					&& alignof(Call) <= PayloadAlignment
+				>());
+				return;
 			}
+		#endif // TKLB_NO_STDLIB
+			deliver<Parameters...>(eventId, param...);
 		}
+
+	#ifndef TKLB_NO_STDLIB
+		/**
+		 * @brief Preallocates the queue for Delivery::Queued events
+		 * @param queueSize Rounded up to the next power of two
+		 */
+		explicit EventBus(Size queueSize) {
+			Size size = 1;
+			while (size < queueSize) { size *= 2; }
+			mQueue.resize(size);
+			for (Size i = 0; i < size; i++) {
+				mQueue[i].sequence.store(i, std::memory_order_relaxed);
+			}
+		}
+
+		/**
+		 * @brief How fireEvent delivers the event, set it before firing from other threads.
+		 *        Queued and Coalesced need the parameters to be trivially copyable
+		 *        and fit into PAYLOAD. Queued events also need a queue size.
+		 */
+		void setDelivery(const EventId eventId, Delivery delivery) {
+			TKLB_ASSERT(eventId < EVENT_COUNT)
+			mDelivery[eventId] = delivery;
+		}
+
+		/**
+		 * @brief Calls the subscribers of queued events, then of coalesced events.
+		 *        Only one thread may dispatch at a time.
+		 *        Stops after one lap through the queue so producers can't keep it busy forever.
+		 * @return Size Number of events delivered
+		 */
+		Size dispatch() {
+			Size delivered = 0;
+			const Size size = mQueue.size();
+			for (Size i = 0; i < size; i++) {
+				Cell& cell = mQueue[mDequeue & (size - 1)];
+				if (cell.sequence.load(std::memory_order_acquire) != mDequeue + 1) { break; }
+				cell.invoke(*this, cell.payload);
+				cell.sequence.store(mDequeue + size, std::memory_order_release);
+				mDequeue++;
+				delivered++;
+			}
+
+			for (int i = 0; i < EVENT_COUNT; i++) {
+				Latest& latest = mLatest[i];
+				if (!latest.pending.exchange(false, std::memory_order_acquire)) { continue; }
+				alignas(PayloadAlignment) unsigned int words[PayloadWords];
+				Invoke func;
+				if (!load(latest, words, func)) {
+					latest.pending = true; // Next time
+					continue;
+				}
+				func(*this, words);
+				delivered++;
+			}
+			return delivered;
+		}
+
+		/**
+		 * @brief Events dropped because the queue was full or another thread
+		 *        was stuck writing the same coalesced event
+		 */
+		Size overflows() const { return mOverflows.load(std::memory_order_relaxed); }
+
+		/**
+		 * @brief Coalesced events replaced before they were dispatched
+		 */
+		Size coalesced() const { return mCoalesced.load(std::memory_order_relaxed); }
+	#endif // TKLB_NO_STDLIB
 	}; // class EventBus
 
-	template <int EVENT_COUNT, typename EventId, class MutexType>
+	template <int EVENT_COUNT, typename EventId, class MutexType, SizeT PAYLOAD>
 	template<typename... Parameters>
-	EventBus<EVENT_COUNT, EventId, MutexType>::Subscription<Parameters...>::~Subscription() {
+	EventBus<EVENT_COUNT, EventId, MutexType, PAYLOAD>::Subscription<Parameters...>::~Subscription() {
 		Subscription::mBus->removeSubscriber(this, Subscription::mEventId);
 	}
 
-	template <int EVENT_COUNT, typename EventId, class MutexType>
+	template <int EVENT_COUNT, typename EventId, class MutexType, SizeT PAYLOAD>
 	template<typename... Parameters>
-	EventBus<EVENT_COUNT, EventId, MutexType>::Subscription<Parameters...>::Subscription(
+	EventBus<EVENT_COUNT, EventId, MutexType, PAYLOAD>::Subscription<Parameters...>::Subscription(
 		EventBus* bus, const EventId eventId, const Callback&& callback
 	) : mCallback(callback), mBus(bus), mEventId(eventId) {
 		TKLB_ASSERT(bus != nullptr)
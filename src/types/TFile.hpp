@@ -0,0 +1,235 @@
+/**
+ * @file TFile.hpp
+ * @author Tobias Kozel
+ * @brief Read only file access, either memory mapped or streamed
+ * @version 0.1
+ * @date 2023-03-08
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+
+#ifndef _TKLB_FILE
+#define _TKLB_FILE
+
+#include "./TTypes.hpp"
+#include "../util/TAssert.h"
+
+#ifndef TKLB_NO_STDLIB
+
+#include <stdio.h>
+
+#ifdef _WIN32
+	#ifndef WIN32_LEAN_AND_MEAN
+		#define WIN32_LEAN_AND_MEAN
+	#endif
+	#ifndef NOMINMAX
+		#define NOMINMAX
+	#endif
+	#include <windows.h>
+#else
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+	#include <fcntl.h>
+	#include <unistd.h>
+#endif
+
+namespace tklb {
+	/**
+	 * @brief Read only view of a whole file mapped into memory.
+	 * @details Opening only maps the address range, pages are loaded
+	 *          by the OS on first access and shared with every other
+	 *          process mapping the same file. Opening a large sample bank
+	 *          costs the same as opening a small file.
+	 *          Parts of the file can be handed to codecs with a MemorySource
+	 *          pointing into data().
+	 */
+	class MappedFile {
+		const char* mData = nullptr;
+		SizeT mSize = 0;
+	#ifdef _WIN32
+		HANDLE mFile = INVALID_HANDLE_VALUE;
+		HANDLE mMapping = nullptr;
+	#endif
+
+	public:
+		MappedFile() = default;
+		MappedFile(const MappedFile&) = delete;
+		MappedFile& operator=(const MappedFile&) = delete;
+
+		MappedFile(const char* path) { open(path); }
+
+		~MappedFile() { close(); }
+
+		/**
+		 * @brief Maps the file
+		 * @return False if the file doesn't exist, is empty or can't be mapped
+		 */
+		bool open(const char* path) {
+			close();
+		#ifdef _WIN32
+			mFile = CreateFileA(
+				path, GENERIC_READ, FILE_SHARE_READ, nullptr,
+				OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr
+			);
+			if (mFile == INVALID_HANDLE_VALUE) { return false; }
+			LARGE_INTEGER size;
+			if (!GetFileSizeEx(mFile, &size) || size.QuadPart <= 0 ||
+				SizeT(-1) < (unsigned long long) size.QuadPart
+			) {
+				close();
+				return false; // ! Empty or too large for the address space
+			}
+			mMapping = CreateFileMappingA(mFile, nullptr, PAGE_READONLY, 0, 0, nullptr);
+			if (mMapping == nullptr) {
+				close();
+				return false;
+			}
+			mData = static_cast<const char*>(MapViewOfFile(mMapping, FILE_MAP_READ, 0, 0, 0));
+			if (mData == nullptr) {
+				close();
+				return false;
+			}
+			mSize = SizeT(size.QuadPart);
+		#else
+			const int file = ::open(path, O_RDONLY);
+			if (file < 0) { return false; }
+			struct stat info;
+			if (fstat(file, &info) != 0 || info.st_size <= 0 ||
+				SizeT(-1) < (unsigned long long) info.st_size
+			) {
+				::close(file);
+				return false; // ! Empty or too large for the address space
+			}
+			void* data = mmap(nullptr, SizeT(info.st_size), PROT_READ, MAP_SHARED, file, 0);
+			// The mapping keeps the file alive
+			::close(file);
+			if (data == MAP_FAILED) { return false; }
+			mData = static_cast<const char*>(data);
+			mSize = SizeT(info.st_size);
+		#endif
+			return true;
+		}
+
+		void close() {
+		#ifdef _WIN32
+			if (mData != nullptr) { UnmapViewOfFile(mData); }
+			if (mMapping != nullptr) { CloseHandle(mMapping); }
+			if (mFile != INVALID_HANDLE_VALUE) { CloseHandle(mFile); }
+			mMapping = nullptr;
+			mFile = INVALID_HANDLE_VALUE;
+		#else
+			if (mData != nullptr) { munmap(const_cast<char*>(mData), mSize); }
+		#endif
+			mData = nullptr;
+			mSize = 0;
+		}
+
+		/**
+		 * @brief Hint that a range will be read soon so the OS can
+		 *        start loading it, avoids page faults on the audio thread
+		 */
+		void prefetch(SizeT offset, SizeT bytes) const {
+			if (mData == nullptr || mSize <= offset) { return; }
+			bytes = mSize - offset < bytes ? mSize - offset : bytes;
+		#ifdef _WIN32
+			(void) bytes; // PrefetchVirtualMemory needs Windows 8, leave it to the OS
+		#else
+			// madvise needs a page aligned start
+			const SizeT page = SizeT(sysconf(_SC_PAGESIZE));
+			const SizeT start = offset - offset % page;
+			madvise(const_cast<char*>(mData) + start, bytes + offset - start, MADV_WILLNEED);
+		#endif
+		}
+
+		bool isOpen() const { return mData != nullptr; }
+
+		const char* data() const { return mData; }
+
+		SizeT size() const { return mSize; }
+	};
+
+	/**
+	 * @brief Buffered sequential file reader.
+	 *        Fallback for files which can't be mapped, only the stdio buffer is held in memory.
+	 */
+	class FileStream {
+		FILE* mFile = nullptr;
+		SizeT mSize = 0;
+		SizeT mPosition = 0;
+
+		static bool seekTo(FILE* file, SizeT position, int origin = SEEK_SET) {
+		#ifdef _WIN32
+			return _fseeki64(file, (long long) position, origin) == 0;
+		#else
+			return fseeko(file, off_t(position), origin) == 0;
+		#endif
+		}
+
+		static SizeT tellOf(FILE* file) {
+		#ifdef _WIN32
+			return SizeT(_ftelli64(file));
+		#else
+			return SizeT(ftello(file));
+		#endif
+		}
+
+	public:
+		FileStream() = default;
+		FileStream(const FileStream&) = delete;
+		FileStream& operator=(const FileStream&) = delete;
+
+		FileStream(const char* path) { open(path); }
+
+		~FileStream() { close(); }
+
+		bool open(const char* path) {
+			close();
+			mFile = fopen(path, "rb");
+			if (mFile == nullptr) { return false; }
+			if (!seekTo(mFile, 0, SEEK_END)) {
+				close();
+				return false;
+			}
+			mSize = tellOf(mFile);
+			seekTo(mFile, 0);
+			mPosition = 0;
+			return true;
+		}
+
+		void close() {
+			if (mFile != nullptr) { fclose(mFile); }
+			mFile = nullptr;
+			mSize = mPosition = 0;
+		}
+
+		/**
+		 * @brief Read from the current position
+		 * @return Bytes read, less than requested at the end
+		 */
+		SizeT read(void* data, SizeT bytes) {
+			if (mFile == nullptr) { return 0; }
+			const SizeT got = fread(data, 1, bytes, mFile);
+			mPosition += got;
+			return got;
+		}
+
+		bool seek(SizeT position) {
+			if (mFile == nullptr || mSize < position) { return false; }
+			if (position == mPosition) { return true; }
+			if (!seekTo(mFile, position)) { return false; }
+			mPosition = position;
+			return true;
+		}
+
+		SizeT tell() const { return mPosition; }
+
+		bool isOpen() const { return mFile != nullptr; }
+
+		SizeT size() const { return mSize; }
+	};
+} // namespace tklb
+
+#endif // TKLB_NO_STDLIB
+
+#endif // _TKLB_FILE
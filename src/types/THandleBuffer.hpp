@@ -8,6 +8,11 @@ namespace tklb {
 	 * @brief A handle buffer to store elements in.
 	 *        Each space in the buffer has a generation counter which is increased each time a element
 	 *        is removed from that spot, so the old handle becomes invalid and access is portected.
+	 * @details Elements live in fixed size chunks which never move, so growing keeps handles
+	 *          and pointers to elements valid. The bookkeeping is kept apart from the elements:
+	 *          one word per slot with the generation and either the next free slot or the
+	 *          position in a dense array of live handles. Iterating walks the dense array,
+	 *          so it only touches live elements.
 	 * @tparam T type to store
 	 * @tparam Handle type to index elements
 	 * @tparam GenerationBits At what bit to split the Handle for validation, defaults to 8 bits.
@@ -17,39 +22,117 @@ namespace tklb {
 	template <class T, typename Handle = unsigned int, int GenerationBits = 8, class ALLOCATOR = DefaultAllocator<>>
 	class HandleBuffer {
 		static constexpr Handle MaskBits 		= sizeof(Handle) * 8 - GenerationBits;
-		static constexpr Handle MaskIndex		= (1 << MaskBits) - 1;
+		static constexpr Handle MaskIndex		= (Handle(1) << MaskBits) - 1;
 		static constexpr Handle MaskGeneration	= ~MaskIndex;
+		static constexpr Handle ChunkBits		= 6;
+		static constexpr Handle ChunkMask		= (Handle(1) << ChunkBits) - 1;
 
-		struct Element {
-			Handle next;				///< Linked list next element and the current generation number
-			char value[sizeof(T)];		///< Space for the element
+		struct Storage {
+			alignas(T) char value[sizeof(T)];	///< Space for the element
 		};
 
-		HeapBuffer<Element, 0, ALLOCATOR> mElements;
-		Handle mStart = 0;				///< Points to the first free element
-		Handle mFree = 0;				///< Number of free slots
+		using Chunk = HeapBuffer<Storage, 0, ALLOCATOR>;
+
+		HeapBuffer<Chunk, 0, ALLOCATOR> mChunks;	///< Element storage, doesn't move once allocated
+		HeapBuffer<Handle, 0, ALLOCATOR> mSlots;	///< Generation and next free slot or dense index per slot
+		HeapBuffer<Handle, 0, ALLOCATOR> mDense;	///< Handles of all live elements
+		Handle mStart = MaskIndex;				///< Points to the first free slot
+		Handle mLimit = MaskIndex;				///< Maximum number of live elements
+
+		T* value(Handle index) const {
+			return (T*) mChunks[index >> ChunkBits][index & ChunkMask].value;
+		}
+
+		/**
+		 * @brief The slot is in use when its dense entry points back at it
+		 */
+		bool alive(Handle index) const {
+			const Handle dense = mSlots[index] & MaskIndex;
+			return dense < mDense.size() && (mDense[dense] & MaskIndex) == index;
+		}
+
+		/**
+		 * @brief Adds chunks until there are at least size slots, new slots are put
+		 *        in front of the free list in order
+		 */
+		bool grow(Handle size) {
+			if (mLimit < size) { return false; }
+			const Handle chunks = (size + ChunkMask) >> ChunkBits;
+			const Handle first = mSlots.size();
+			if (chunks <= mChunks.size()) { return true; }
+			const Handle last = chunks << ChunkBits;
+			if (MaskIndex <= last - 1) { return false; } // MaskIndex marks the end of the free list
+			if (!mChunks.resize(chunks)) { return false; }
+			for (Handle i = 0; i < chunks; i++) {
+				if (mChunks[i].size() == 0 && !mChunks[i].resize(ChunkMask + 1)) { return false; }
+			}
+			if (!mSlots.resize(last)) { return false; }
+			for (Handle i = first; i < last; i++) {
+				mSlots[i] = i + 1; // Generation starts at 0
+			}
+			mSlots[last - 1] = mStart;
+			mStart = first;
+			return true;
+		}
+
+		void prefetch(Handle dense) const {
+		#if defined(__GNUC__) || defined(__clang__)
+			if (dense < mDense.size()) {
+				__builtin_prefetch(value(mDense[dense] & MaskIndex));
+			}
+		#else
+			(void) dense;
+		#endif
+		}
 
 	public:
 		HandleBuffer(Handle size) { resize(size); }
 		HandleBuffer() { }
+		~HandleBuffer() { clear(); }
+
+		HandleBuffer(const HandleBuffer&) = delete;
+		HandleBuffer& operator=(const HandleBuffer&) = delete;
 
 		static constexpr Handle InvalidHandle = ~0;
-		Handle size() const { return mElements.size(); }
-		Handle free() const { return mFree; }
 
 		/**
-		 * @brief Resize buffer, does not maintain existing data or handles for now !
+		 * @brief Number of slots, used or not
 		 */
-		void resize(Handle size) {
-			TKLB_ASSERT(size < MaskIndex) // Needs to be smaller than MaskIndex!
+		Handle size() const { return mSlots.size(); }
 
-			mElements.resize(size);
+		/**
+		 * @brief Number of slots left before the buffer has to grow
+		 */
+		Handle free() const { return mSlots.size() - mDense.size(); }
 
-			for (Handle i = 0; i < size; i++) {
-				mElements[i].next = i + 1;
-			}
-			mElements.last().next = MaskIndex; // last has no next
-			mFree = size;
+		/**
+		 * @brief Number of live elements
+		 */
+		Handle count() const { return mDense.size(); }
+
+		/**
+		 * @brief Handles of all live elements, in iteration order.
+		 *        Invalidated by create and remove.
+		 */
+		const Handle* handles() const { return mDense.data(); }
+
+		/**
+		 * @brief Makes sure there are at least size slots.
+		 *        Existing elements and their handles stay valid.
+		 * @return false if the limit was hit or the allocation failed
+		 */
+		bool resize(Handle size) {
+			if (!grow(size)) { return false; }
+			return mDense.reserve(mSlots.size());
+		}
+
+		/**
+		 * @brief Caps the number of live elements, create fails instead of growing past it.
+		 *        Already allocated slots are kept.
+		 */
+		void setLimit(Handle limit) {
+			TKLB_ASSERT(limit <= MaskIndex)
+			mLimit = limit;
 		}
 
 		/**
@@ -61,18 +144,13 @@ namespace tklb {
 			if (handle == InvalidHandle) { return nullptr; }
 
 			const Handle index = handle & MaskIndex;
+			if (mSlots.size() <= index) { return nullptr; }
 
-			TKLB_ASSERT(index != MaskIndex) // can't index this, see constructor
-			if (mElements.size() <  index) { return nullptr; }
-
-			const Element& element = mElements[index];
-			const Handle currentGeneration = element.next & MaskGeneration;
-			if (currentGeneration == MaskGeneration) { return nullptr; } // referencing unitialized element
+			const Handle slot = mSlots[index];
+			if ((handle & MaskGeneration) != (slot & MaskGeneration)) { return nullptr; } // referencing removed element
+			if (!alive(index)) { return nullptr; } // referencing a free slot
 
-			const Handle accessedGeneration = handle & MaskGeneration;
-			if (accessedGeneration != currentGeneration) { return nullptr; } // referencing removed element
-
-			return (T*) (element.value);
+			return value(index);
 		}
 
 		bool has(const Handle& handle) const { return at(handle) != nullptr; }
@@ -81,22 +159,43 @@ namespace tklb {
 		inline T& operator[](const Handle& handle) { return *at(handle); }
 
 		/**
-		 * @brief Looks for a free spot and will call the default constructor for T
-		 * @return Handle A valid handle if there was space left, InvalidHandle otherwise.
+		 * @brief Takes a free spot and will call the default constructor for T.
+		 *        Grows the buffer if there is no space left.
+		 * @return Handle A valid handle, InvalidHandle if the limit is reached or allocating failed.
 		 */
 		Handle create() {
-			// TODO resize would be in order
-			if (mStart == MaskIndex) { return InvalidHandle; } // No more space
-			TKLB_ASSERT(mFree != 0) // Means there's a logic error
+			if (mLimit <= mDense.size()) { return InvalidHandle; }
+			if (mStart == MaskIndex) {
+				if (!resize(mSlots.size() + 1)) { return InvalidHandle; }
+			}
+			if (!mDense.reserve(mSlots.size())) { return InvalidHandle; }
 			const Handle index = mStart;
-			auto& element = mElements[index];
-			new (element.value) T();
+			Handle& slot = mSlots[index];
+			new (value(index)) T();
 
-			// remove the element from the linked list
-			mStart = element.next & MaskIndex;
-			mFree--;
+			// remove the slot from the free list and point it to its dense entry
+			mStart = slot & MaskIndex;
+			const Handle handle = index | (slot & MaskGeneration);
+			slot = (slot & MaskGeneration) | mDense.size();
+			mDense.push(handle);
+			return handle;
+		}
 
-			return index | (element.next & MaskGeneration);
+		/**
+		 * @brief Creates count elements, only grows once
+		 * @param handles Receives a handle for each created element
+		 * @return Handle Number of elements created, less than count if the limit is reached
+		 */
+		Handle create(Handle* handles, Handle count) {
+			const Handle needed = mDense.size() + count;
+			if (mSlots.size() < needed) {
+				resize(mLimit < needed ? mLimit : needed);
+			}
+			for (Handle i = 0; i < count; i++) {
+				handles[i] = create();
+				if (handles[i] == InvalidHandle) { return i; }
+			}
+			return count;
 		}
 
 		/**
@@ -111,41 +210,60 @@ namespace tklb {
 			element->~T();
 
 			const Handle index = handle & MaskIndex;
-			Element& slot = mElements[index];
+			Handle& slot = mSlots[index];
+
+			// Fill the gap in the dense array with the last live handle
+			const Handle dense = slot & MaskIndex;
+			const Handle moved = mDense.last();
+			mDense[dense] = moved;
+			Handle& movedSlot = mSlots[moved & MaskIndex];
+			movedSlot = (movedSlot & MaskGeneration) | dense;
+			mDense.resize(mDense.size() - 1, false);
 
 			// Invalidate the handle by incremening the generation
-			Handle generation = ((slot.next & MaskGeneration) >> MaskBits);
-			generation += 1;
-			if (generation == MaskGeneration) {
-				// last generation is skipped because it signals a uninitialzed element
-				generation = 0;
-			}
-			generation = (generation << MaskBits);
+			const Handle generation = (slot & MaskGeneration) + (MaskIndex + 1);
 
-			// insert the free element back into the list
-			slot.next = generation | index;
+			// insert the free slot back into the list
+			slot = generation | mStart;
 			mStart = index;
-
-			mFree++;
 			return true;
 		}
 
 		/**
-		 * @brief Since the buffer is continuos, but might contain gaps/invalid elements
-		 *        iterating needs to be done via this function.
-		 * @tparam
+		 * @brief Removes count elements
+		 * @return Handle Number of handles which were valid
+		 */
+		Handle remove(const Handle* handles, Handle count) {
+			Handle removed = 0;
+			for (Handle i = 0; i < count; i++) {
+				if (remove(handles[i])) { removed++; }
+			}
+			return removed;
+		}
+
+		/**
+		 * @brief Removes all elements, keeps the slots
+		 */
+		void clear() {
+			while (mDense.size() != 0) { remove(mDense.last()); }
+		}
+
+		/**
+		 * @brief Calls func for each live element, walks the dense array from the back
+		 *        so func may remove the element it's called with.
+		 *        Elements created from within func aren't visited.
 		 * @param func Func A lambda called for each valid element
 		 */
 		template <class Func>
-		constexpr void iterate(Func&& func) {
-			Handle itemsLeft = mElements.size() - mFree;
-			for (Handle i = 0; i < mElements.size(); i++) {
-				if (itemsLeft == 0) { return; } // early out
-				const Element& element = mElements[i];
-				if ((element.next & MaskGeneration) != MaskGeneration) {
-					func(*((T*) mElements[i].value), i | (element.next & MaskGeneration));
-					itemsLeft--;
-				}
+		void iterate(Func&& func) {
+			static constexpr Handle Ahead = 4;
+			for (Handle i = 0; i < Ahead; i++) {
+				prefetch(mDense.size() - 1 - i);
+			}
+			for (Handle i = mDense.size(); i != 0; i--) {
+				prefetch(i - 1 - Ahead);
+				const Handle handle = mDense[i - 1];
+				func(*value(handle & MaskIndex), handle);
 			}
 		}
 	};
@@ -15,20 +15,43 @@
 #endif
 
 namespace tklb {
+	/**
+	 * @brief Inline storage for the small buffer optimization of HeapBuffer.
+	 *        Empty when there's no inline capacity, so it costs nothing as a base.
+	 */
+	template <typename T, SizeT COUNT, SizeT ALIGNMENT>
+	class HeapBufferInline {
+		alignas(alignof(T) < ALIGNMENT ? ALIGNMENT : alignof(T)) unsigned char mStorage[COUNT * sizeof(T)];
+	protected:
+		T* inlineData() { return reinterpret_cast<T*>(mStorage); }
+		const T* inlineData() const { return reinterpret_cast<const T*>(mStorage); }
+	};
+
+	template <typename T, SizeT ALIGNMENT>
+	class HeapBufferInline<T, 0, ALIGNMENT> {
+	protected:
+		T* inlineData() { return nullptr; }
+		const T* inlineData() const { return nullptr; }
+	};
+
 	/**
 	 * @brief Basically a bad std::vector without exceptions which can also work with borrowed memory.
 	 * @tparam T Element type. Needs to have a default contructor
 	 * @tparam ALIGNMENT Memory alignment in bytes needs to be a power of 2. Defaults to 0 for no alignment
 	 * @tparam ALLOCATOR Normal allocator class defaults to non basic malloc/free wrapper
 	 * @tparam SIZE Size type used for index, defaults to unsigned int to save some space
+	 * @tparam INLINE Elements stored in the object itself before the allocator is used,
+	 *                so short lists never touch the heap. Defaults to 0.
 	 */
 	template <
 		typename T = unsigned char,
 		SizeT ALIGNMENT = 0,
 		class ALLOCATOR = DefaultAllocator<>,
-		typename SIZE = unsigned int
+		typename SIZE = unsigned int,
+		SizeT INLINE = 0
 	>
-	class HeapBuffer {
+	class HeapBuffer : private HeapBufferInline<T, INLINE, ALIGNMENT> {
+		using Storage = HeapBufferInline<T, INLINE, ALIGNMENT>;
 	public:
 		/**
 		 * @brief everything using the heapbuffer uses this type to address elements.
@@ -51,6 +74,28 @@ namespace tklb {
 		 */
 		static constexpr Size ChunkSize = 16;
 
+		/**
+		 * @brief Elements which fit without allocating
+		 */
+		static constexpr Size Inline = INLINE;
+
+		/**
+		 * @brief Elements are moved with memcpy instead of move constructing
+		 *        and destroying them, see traits::IsTriviallyRelocatable.
+		 *        Elements which can't be moved at all are still copied bitwise
+		 *        like it has always been done.
+		 */
+		static constexpr bool Relocatable =
+			traits::IsTriviallyRelocatable<T>::value || !traits::IsMoveConstructible<T>::value;
+
+		/**
+		 * @brief Relocatable elements are resized with the allocators
+		 *        reallocate() if it has one, which might not even need to move them.
+		 *        The alignment isn't kept by it.
+		 */
+		static constexpr bool Reallocates =
+			Alignment == 0 && CanReallocate<ALLOCATOR>::value && Relocatable;
+
 	private:
 		T* mBuf = nullptr;		// Underlying buffer
 		Size mSize = 0;			// elements in buffer
@@ -80,32 +125,23 @@ namespace tklb {
 		 * @brief Copy Constructor, calls set()
 		 * Failed allocations have to be checked
 		 */
-		template <int Alignment2, class Allocator2, typename Size2>
-		HeapBuffer(const HeapBuffer<T, Alignment2, Allocator2, Size2>& source) { set(source); }
+		template <SizeT Alignment2, class Allocator2, typename Size2, SizeT Inline2>
+		HeapBuffer(const HeapBuffer<T, Alignment2, Allocator2, Size2, Inline2>& source) { set(source); }
 
 		HeapBuffer(const T* data, Size size) { set(data, size); }
 
 		/**
 		 * @brief Move contructor, will mark the original buffer as injected
 		 */
-		HeapBuffer(HeapBuffer&& source) :
-			mBuf(source.mBuf),
-			mSize(source.mSize),
-			mRealSize(source.mRealSize)
-		{
-			TKLB_ASSERT_STATE(IS_CONST = source.IS_CONST)
-			source.disown();
-		}
+		HeapBuffer(HeapBuffer&& source) { take(source); }
 
 		/**
-		 * @brief Move operator (to existing instance)
+		 * @brief Move operator (to existing instance), frees the current content first
 		 */
 		HeapBuffer& operator= (HeapBuffer&& source) {
-			TKLB_ASSERT_STATE(IS_CONST = source.IS_CONST)
-			mBuf = source.mBuf;
-			mSize = source.mSize;
-			mRealSize = source.mRealSize;
-			source.disown();
+			if (this == &source) { return *this; }
+			if (!injected()) { resize(0); }
+			take(source);
 			return *this;
 		}
 
@@ -123,8 +159,8 @@ namespace tklb {
 		 * contructors will called
 		 * @return True on success
 		 */
-		template <int Alignment2, class Allocator2, typename Size2>
-		bool set(const HeapBuffer<T, Alignment2, Allocator2, Size2>& source) {
+		template <SizeT Alignment2, class Allocator2, typename Size2, SizeT Inline2>
+		bool set(const HeapBuffer<T, Alignment2, Allocator2, Size2, Inline2>& source) {
 			return set(source.data(), source.size());
 		}
 
@@ -179,6 +215,7 @@ namespace tklb {
 		void disown() {
 			if (empty()) { return; }
 			TKLB_ASSERT(mRealSize != 0)
+			TKLB_ASSERT(!isInline()) // ! Inline memory can't outlive the buffer
 			mRealSize = 0;
 		}
 
@@ -229,7 +266,7 @@ namespace tklb {
 		 * @return Whether the allocation was succesful
 		 */
 		bool reserve(const Size size) {
-			if (size  < mRealSize) { return true; }
+			if (size <= mRealSize) { return true; }
 			return allocate(size);
 		}
 
@@ -242,12 +279,13 @@ namespace tklb {
 		 * @return Whether the allocation was successful
 		 */
 		bool resize(const Size size, const bool downsize = true) {
-			const Size chunked = closestChunkSize(size, ChunkSize);
+			const Size chunked = (0 < size && size <= Inline) ? Inline : closestChunkSize(size, ChunkSize);
 
 			if (size < mSize && mBuf != nullptr && !injected()) { // downsize means destroy objects
 				for (Size i = size; i < mSize; i++) {
 					mBuf[i].~T();
 				}
+				mSize = size; // So only live objects are relocated
 			}
 
 			if (mRealSize < chunked || (downsize && (mRealSize > chunked)) ) {
@@ -269,21 +307,21 @@ namespace tklb {
 
 		/**
 		 * @brief Push the object to the back of the buffer
-		 * TODO tklb move version
 		 */
 		bool push(const T& object) {
-			Size newSize = mSize + 1;
-			if (mRealSize < newSize) {
-				if (allocate(closestChunkSize(newSize, ChunkSize))) {
-					new (mBuf + mSize) T(object);
-				} else {
-					TKLB_ASSERT(false)
-					return false; // ! Allocation failed
-				}
-			} else {
-				new (mBuf + mSize) T(object);
-			}
-			mSize = newSize;
+			if (!grow()) { return false; } // ! Allocation failed
+			new (mBuf + mSize) T(object);
+			mSize++;
+			return true;
+		}
+
+		/**
+		 * @brief Move the object to the back of the buffer
+		 */
+		bool push(T&& object) {
+			if (!grow()) { return false; } // ! Allocation failed
+			new (mBuf + mSize) T(traits::move(object));
+			mSize++;
 			return true;
 		}
 
@@ -306,7 +344,7 @@ namespace tklb {
 			if (mSize <= index) { return false; }
 			mBuf[index].~T(); // Call destructor
 			if (index != mSize - 1) { // fill the gap with the last element
-				memory::copy(mBuf + index, mBuf + (mSize - 1), sizeof(T));
+				relocate(mBuf + index, mBuf + (mSize - 1), 1);
 			}
 			mSize--;
 			return true;
@@ -346,6 +384,11 @@ namespace tklb {
 		 */
 		bool injected() const { return mRealSize == 0 && 0 < mSize && mBuf != nullptr; }
 
+		/**
+		 * @brief Whether the elements are stored in the object itself
+		 */
+		bool isInline() const { return Inline != 0 && mBuf == Storage::inlineData(); }
+
 		/**
 		 * @brief Returns the amount of elements in the container
 		 */
@@ -372,6 +415,18 @@ namespace tklb {
 			return ((size / chunk) + 1) * chunk;
 		}
 
+		/**
+		 * @brief Capacity when growing to at least size while pushing.
+		 *        Grows by half the current capacity so pushing n elements
+		 *        only copies O(n) elements in total.
+		 */
+		Size grownSize(Size size) const {
+			if (size <= Inline) { return Inline; }
+			const Size geometric = mRealSize + mRealSize / 2;
+			const Size chunked = closestChunkSize(size, ChunkSize);
+			return chunked < geometric ? geometric : chunked;
+		}
+
 		static constexpr bool isAligned(const void* ptr) {
 			return
 				(ptr == nullptr) ?
@@ -382,62 +437,116 @@ namespace tklb {
 
 	private:
 		/**
-		 * @brief Allocated the exact size requsted and copies existing objects.
-		 * Will not call their destructors or constructors!
+		 * @brief Moves count objects to uninitialized memory, the source is left uninitialized
+		 */
+		static void relocate(T* destination, T* source, Size count) {
+			relocate(destination, source, count, traits::Value<Relocatable>());
+		}
+
+		static void relocate(T* destination, T* source, Size count, traits::Value<true>) {
+			memory::copy(destination, source, count * sizeof(T));
+		}
+
+		static void relocate(T* destination, T* source, Size count, traits::Value<false>) {
+			for (Size i = 0; i < count; i++) {
+				new (destination + i) T(traits::move(source[i]));
+				source[i].~T();
+			}
+		}
+
+		/**
+		 * @brief Makes room for one more element when pushing
+		 */
+		bool grow() {
+			if (mSize < mRealSize) { return true; }
+			if (allocate(grownSize(mSize + 1))) { return true; }
+			TKLB_ASSERT(false)
+			return false;
+		}
+
+		/**
+		 * @brief Takes over the memory of another buffer.
+		 *        Inline elements are relocated since the memory can't move.
+		 */
+		void take(HeapBuffer& source) {
+			TKLB_ASSERT_STATE(IS_CONST = source.IS_CONST)
+			mSize = source.mSize;
+			mRealSize = source.mRealSize;
+			if (source.isInline()) {
+				mBuf = Storage::inlineData();
+				relocate(mBuf, source.mBuf, mSize);
+				source.mBuf = nullptr;
+				source.mSize = source.mRealSize = 0;
+				return;
+			}
+			mBuf = source.mBuf;
+			source.disown();
+		}
+
+		T* reallocate(Size chunk, traits::Value<true>) {
+			return reinterpret_cast<T*>(ALLOCATOR().reallocate(
+				reinterpret_cast<unsigned char*>(mBuf), mRealSize * sizeof(T), chunk * sizeof(T)
+			));
+		}
+
+		T* reallocate(Size, traits::Value<false>) { return nullptr; }
+
+		/**
+		 * @brief Allocated the exact size requsted and relocates existing objects.
+		 * Sizes up to Inline use the inline storage instead.
+		 * Objects in borrowed memory are copied bitwise and left alone.
 		 */
 		bool allocate(Size chunk) noexcept {
 			T* oldBuf = mBuf;
-			if (0 < chunk) {
+			const bool owned = oldBuf != nullptr && !injected() && mRealSize > 0;
+			// Only owned heap memory goes back to the allocator
+			const bool onHeap = owned && !isInline();
+
+			if (0 < chunk && chunk <= Inline) {
+				chunk = Inline;
+				mBuf = Storage::inlineData();
+			} else if (0 < chunk && Reallocates && onHeap) {
+				// Contents are kept by the allocator, the old memory is gone on success
+				T* newBuf = reallocate(chunk, traits::Value<Reallocates>());
+				if (newBuf == nullptr) {
+					TKLB_ASSERT(false);
+					return false; // ! Allocation failed, the old buffer is still intact
+				}
+				mBuf = newBuf;
+				mRealSize = chunk;
+				return true;
+			} else if (0 < chunk) {
 				const Size bytes = chunk * sizeof(T);
-				// TODO tklb Consider using realloc
-				void* newBuf = ALLOCATOR().allocate(bytes + Alignment);
+				// The allocator takes care of the alignment, so there's no padding
+				void* newBuf = Alignment == 0 ?
+					ALLOCATOR().allocate(bytes) : ALLOCATOR().allocate(bytes, Alignment);
 				if (newBuf == nullptr) {
 					TKLB_ASSERT(false);
 					return false;
 				}
-				if (Alignment != 0) {
-					// Mask with zeroes at the end to floor the pointer to an aligned block
-					constexpr Pointer mask = ~(Pointer(Alignment - 1));
-					const Pointer pointer = reinterpret_cast<Pointer>(newBuf);
-					// This is the next smallest aligned address.
-					const Pointer floored = pointer & mask;
-
-					// the address is below the actual
-					// allocated space and we need to jump to the next aligned address.
-					const Pointer aligned = floored + Alignment;
-
-					// Now there's a gap between the allocation and aligned address.
-					// It needs to be large enough to store a pointer
-					// malloc aligns to sizeof(void*), so this should always be the case.
-					TKLB_ASSERT(sizeof(Pointer) <= (aligned - pointer))
-
-					newBuf = reinterpret_cast<void*>(aligned);
-					// Now store the ptr of the original allocation right before
-					// the aligned one, so it can be accessed again for freeing it up.
-					Pointer* original = reinterpret_cast<Pointer*>(newBuf) - 1;
-					*(original) = pointer;
-					TKLB_ASSERT(isAligned(newBuf))
-				}
-
-
-				if (0 < mSize && oldBuf != nullptr && newBuf != nullptr) {
-					// copy existing content
-					// TODO tklb only copy the new realsize which might be smaller
-					memory::copy(newBuf, oldBuf, min(mSize, chunk) * sizeof(T));
-				}
+				TKLB_ASSERT(isAligned(newBuf))
 				mBuf = (T*) newBuf;
 			} else {
 				mBuf = nullptr;
 			}
 
-			if (oldBuf != nullptr && !injected() && mRealSize > 0) {
+			if (0 < mSize && oldBuf != nullptr && mBuf != nullptr && mBuf != oldBuf) {
+				// move existing content
+				if (owned) {
+					relocate(mBuf, oldBuf, min(mSize, chunk));
+				} else {
+					memory::copy(mBuf, oldBuf, min(mSize, chunk) * sizeof(T));
+				}
+			}
+
+			if (onHeap) {
 				// Get rid of oldbuffer, object destructors were already called
+				// Allocated in bytes, so the size is passed in bytes too
+				const Size bytes = mRealSize * sizeof(T);
 				if (Alignment == 0) {
-					ALLOCATOR().deallocate(reinterpret_cast<unsigned char*>(oldBuf), mRealSize);
+					ALLOCATOR().deallocate(reinterpret_cast<unsigned char*>(oldBuf), bytes);
 				} else {
-					// Restore the original unaligned address and use it to free the memory
-					auto original = *(reinterpret_cast<void**>(oldBuf) - 1);
-					ALLOCATOR().deallocate(reinterpret_cast<unsigned char*>(original), mRealSize);
+					ALLOCATOR().deallocate(reinterpret_cast<unsigned char*>(oldBuf), bytes, Alignment);
 				}
 			}
 			TKLB_ASSERT_STATE(IS_CONST = false)
@@ -447,6 +556,14 @@ namespace tklb {
 		}
 	};
 
+	namespace traits {
+		/**
+		 * @brief Only points to the heap, unless elements are stored inline
+		 */
+		template <typename T, SizeT ALIGNMENT, class ALLOCATOR, typename SIZE, SizeT INLINE>
+		struct IsTriviallyRelocatable<HeapBuffer<T, ALIGNMENT, ALLOCATOR, SIZE, INLINE>> : Value<INLINE == 0> { };
+	} // namespace traits
+
 } // namespace
 
 #endif // _TKLB_HEAPBUFFER
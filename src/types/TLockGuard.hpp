@@ -46,5 +46,27 @@ namespace tklb {
 			}
 		}
 	};
+
+	/**
+	 * @brief Holds a reader writer lock for reading
+	 */
+	template <class T>
+	class LockGuardShared {
+		T& mMutex;
+	public:
+		LockGuardShared(const LockGuardShared&) = delete;
+		LockGuardShared(const LockGuardShared*) = delete;
+		LockGuardShared(LockGuardShared&&) = delete;
+		LockGuardShared& operator= (const LockGuardShared&) = delete;
+		LockGuardShared& operator= (LockGuardShared&&) = delete;
+
+		LockGuardShared(T& mutex) : mMutex(mutex) {
+			mutex.lock_shared();
+		}
+
+		~LockGuardShared() {
+			mMutex.unlock_shared();
+		}
+	};
 } // namespace tklb
 #endif // _TKLB_LOCKGUARD
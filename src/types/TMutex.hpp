@@ -2,6 +2,7 @@
 #define _TKLB_MUTEX
 
 #include "./TLockGuard.hpp"
+#include "../util/TRealtimeGuard.hpp"
 
 #ifndef TKLB_NO_STDLIB
 	#include <mutex>
@@ -24,6 +25,7 @@
 			using TryLock = LockGuardTry<Mutex>;
 
 			void lock() {
+				TKLB_REALTIME_CHECK(Lock);
 				mMutex.lock();
 			}
 
@@ -2,22 +2,194 @@
 #define _TKLB_SPINLOCK
 
 #include "./TLockGuard.hpp"
+#include "./TTypes.hpp"
 
 #ifndef TKLB_NO_STDLIB
 	#include <atomic>
+	#include <thread>
+	#ifdef TKLB_SPINLOCK_STATS
+		#include <chrono>
+	#endif
+#endif
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+	#include <intrin.h>
 #endif
 
 namespace tklb {
 	/**
-	 * @brief Spinlock
-	 * ! probably not thread safe
+	 * @brief Shared parts of the spin locks: atomics, backoff and the profiling counters.
+	 * @details The lock word gets a cache line of its own so threads spinning on it
+	 *          don't slow down the data it protects.
+	 *          With TKLB_SPINLOCK_STATS defined each lock counts acquisitions, contended
+	 *          acquisitions, pause instructions spent and the time the exclusive lock was held.
 	 */
-	class SpinLock {
-		#ifndef TKLB_NO_STDLIB
-			std::atomic<bool> mSpinLock = { false };
-		#else
-			bool mSpinLock = false;
+	class SpinLockBase {
+	public:
+		using Size = SizeT;
+		static constexpr Size CacheLine = 64;
+		static constexpr unsigned int MaxBackoff = 1024;	///< Pauses before yielding
+
+		struct Stats {
+			Size acquired = 0;
+			Size contended = 0;			///< Acquisitions which had to spin
+			Size spins = 0;				///< Pause instructions while waiting
+			Size holdNanoseconds = 0;	///< Total time the exclusive lock was held
+			Size maxHoldNanoseconds = 0;
+		};
+
+		/**
+		 * @brief Tells the cpu we're spinning, saves power and frees
+		 *        the core for the other hyper thread
+		 */
+		static inline void pause() {
+		#if defined(__x86_64__) || defined(__i386__)
+			__builtin_ia32_pause();
+		#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+			_mm_pause();
+		#elif defined(__aarch64__) || defined(__arm__)
+			__asm__ __volatile__("yield");
 		#endif
+		}
+
+	protected:
+	#ifndef TKLB_NO_STDLIB
+		using Word = std::atomic<unsigned int>;
+		static unsigned int load(const Word& word) { return word.load(std::memory_order_relaxed); }
+		static void release(Word& word, unsigned int value) { word.store(value, std::memory_order_release); }
+		static unsigned int exchange(Word& word, unsigned int value) {
+			return word.exchange(value, std::memory_order_acquire);
+		}
+		static bool compareExchange(Word& word, unsigned int& expected, unsigned int value) {
+			return word.compare_exchange_weak(
+				expected, value, std::memory_order_acquire, std::memory_order_relaxed
+			);
+		}
+		static unsigned int fetchAnd(Word& word, unsigned int value) {
+			return word.fetch_and(value, std::memory_order_release);
+		}
+		static unsigned int fetchSub(Word& word, unsigned int value) {
+			return word.fetch_sub(value, std::memory_order_release);
+		}
+	#else
+		using Word = unsigned int;
+		static unsigned int load(const Word& word) { return __atomic_load_n(&word, __ATOMIC_RELAXED); }
+		static void release(Word& word, unsigned int value) { __atomic_store_n(&word, value, __ATOMIC_RELEASE); }
+		static unsigned int exchange(Word& word, unsigned int value) {
+			return __atomic_exchange_n(&word, value, __ATOMIC_ACQUIRE);
+		}
+		static bool compareExchange(Word& word, unsigned int& expected, unsigned int value) {
+			return __atomic_compare_exchange_n(
+				&word, &expected, value, true, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED
+			);
+		}
+		static unsigned int fetchAnd(Word& word, unsigned int value) {
+			return __atomic_fetch_and(&word, value, __ATOMIC_RELEASE);
+		}
+		static unsigned int fetchSub(Word& word, unsigned int value) {
+			return __atomic_fetch_sub(&word, value, __ATOMIC_RELEASE);
+		}
+	#endif
+
+		/**
+		 * @brief Keeps the lock word alone on its cache line
+		 */
+		struct PaddedWord {
+			char before[CacheLine];
+			Word value = { 0 };
+			char after[CacheLine - sizeof(Word)];
+		};
+
+		/**
+		 * @brief Exponential backoff, pauses twice as long each round
+		 *        and yields to the scheduler once that gets too long
+		 * @return Pauses spent
+		 */
+		static unsigned int backoff(unsigned int& round) {
+			if (MaxBackoff <= round) {
+				#ifndef TKLB_NO_STDLIB
+					std::this_thread::yield();
+				#endif
+				return 0;
+			}
+			for (unsigned int i = 0; i < round; i++) { pause(); }
+			const unsigned int spent = round;
+			round *= 2;
+			return spent;
+		}
+
+	#if defined(TKLB_SPINLOCK_STATS) && !defined(TKLB_NO_STDLIB)
+		using Clock = std::chrono::steady_clock;
+		struct Counters {
+			std::atomic<Size> acquired = { 0 };
+			std::atomic<Size> contended = { 0 };
+			std::atomic<Size> spins = { 0 };
+			std::atomic<Size> holdNanoseconds = { 0 };
+			std::atomic<Size> maxHoldNanoseconds = { 0 };
+			Clock::time_point lockedAt;		///< Only touched by the holder
+		};
+		Counters mCounters;
+
+		void acquired(Size spins) {
+			mCounters.acquired.fetch_add(1, std::memory_order_relaxed);
+			if (spins != 0) {
+				mCounters.contended.fetch_add(1, std::memory_order_relaxed);
+				mCounters.spins.fetch_add(spins, std::memory_order_relaxed);
+			}
+		}
+
+		void held() { mCounters.lockedAt = Clock::now(); }
+
+		void releasing() {
+			const Size held = Size(std::chrono::duration_cast<std::chrono::nanoseconds>(
+				Clock::now() - mCounters.lockedAt
+			).count());
+			mCounters.holdNanoseconds.fetch_add(held, std::memory_order_relaxed);
+			if (mCounters.maxHoldNanoseconds.load(std::memory_order_relaxed) < held) {
+				mCounters.maxHoldNanoseconds.store(held, std::memory_order_relaxed);
+			}
+		}
+
+	public:
+		Stats stats() const {
+			Stats stats;
+			stats.acquired = mCounters.acquired.load(std::memory_order_relaxed);
+			stats.contended = mCounters.contended.load(std::memory_order_relaxed);
+			stats.spins = mCounters.spins.load(std::memory_order_relaxed);
+			stats.holdNanoseconds = mCounters.holdNanoseconds.load(std::memory_order_relaxed);
+			stats.maxHoldNanoseconds = mCounters.maxHoldNanoseconds.load(std::memory_order_relaxed);
+			return stats;
+		}
+
+		void resetStats() {
+			mCounters.acquired = 0;
+			mCounters.contended = 0;
+			mCounters.spins = 0;
+			mCounters.holdNanoseconds = 0;
+			mCounters.maxHoldNanoseconds = 0;
+		}
+	#else
+		void acquired(Size) { }
+		void held() { }
+		void releasing() { }
+
+	public:
+		/**
+		 * @brief Always empty without TKLB_SPINLOCK_STATS
+		 */
+		Stats stats() const { return Stats(); }
+		void resetStats() { }
+	#endif
+	};
+
+	/**
+	 * @brief Test and test and set spin lock with exponential backoff.
+	 *        Waiters only read the lock word until it looks free,
+	 *        so they don't keep stealing the cache line from the holder.
+	 *        try_lock() never spins, so it's safe on realtime threads.
+	 */
+	class SpinLock : public SpinLockBase {
+		PaddedWord mSpinLock;
 	public:
 		SpinLock(const SpinLock&) = delete;
 		SpinLock(const SpinLock*) = delete;
@@ -31,22 +203,118 @@ namespace tklb {
 		using TryLock = LockGuardTry<SpinLock>;
 
 		void lock() {
-			while (mSpinLock) { };
-			mSpinLock = true;
+			Size spins = 0;
+			unsigned int round = 1;
+			while (exchange(mSpinLock.value, 1) != 0) {
+				while (load(mSpinLock.value) != 0) { spins += backoff(round); }
+			}
+			acquired(spins);
+			held();
 		}
 
 		void unlock() {
-			mSpinLock = false;
+			releasing();
+			release(mSpinLock.value, 0);
 		}
 
 		/**
 		 * @brief Tries to lock, returns true if lock was aquired
 		 */
 		bool try_lock() {
-			if (mSpinLock) {
+			if (load(mSpinLock.value) != 0 || exchange(mSpinLock.value, 1) != 0) {
+				return false;
+			}
+			acquired(0);
+			held();
+			return true;
+		}
+	};
+
+	/**
+	 * @brief Reader writer spin lock for tables which are read a lot and rarely changed.
+	 *        Any number of readers or a single writer can hold it.
+	 *        A waiting writer stops new readers from entering so it can't starve.
+	 *        Not recursive, a reader can't upgrade to a writer.
+	 */
+	class RWSpinLock : public SpinLockBase {
+		static constexpr unsigned int Writer = 1u << 31;
+
+		PaddedWord mState;			///< Writer bit and the number of readers
+	public:
+		RWSpinLock(const RWSpinLock&) = delete;
+		RWSpinLock(const RWSpinLock*) = delete;
+		RWSpinLock(RWSpinLock&&) = delete;
+		RWSpinLock& operator= (const RWSpinLock&) = delete;
+		RWSpinLock& operator= (RWSpinLock&&) = delete;
+
+		RWSpinLock() = default;
+
+		using Lock = LockGuard<RWSpinLock>;
+		using TryLock = LockGuardTry<RWSpinLock>;
+		using ReadLock = LockGuardShared<RWSpinLock>;
+
+		/**
+		 * @brief Locks exclusively
+		 */
+		void lock() {
+			Size spins = 0;
+			unsigned int round = 1;
+			// Claim the writer bit first so no new readers get in
+			unsigned int state = load(mState.value);
+			while (true) {
+				if ((state & Writer) == 0 && compareExchange(mState.value, state, state | Writer)) { break; }
+				spins += backoff(round);
+				state = load(mState.value);
+			}
+			// Then wait for the readers to leave
+			while (load(mState.value) != Writer) { spins += backoff(round); }
+			exchange(mState.value, Writer); // Acquire what the readers did
+			acquired(spins);
+			held();
+		}
+
+		void unlock() {
+			releasing();
+			fetchAnd(mState.value, ~Writer);
+		}
+
+		bool try_lock() {
+			unsigned int expected = 0;
+			if (load(mState.value) != 0 || !compareExchange(mState.value, expected, Writer)) {
+				return false;
+			}
+			acquired(0);
+			held();
+			return true;
+		}
+
+		void lock_shared() {
+			Size spins = 0;
+			unsigned int round = 1;
+			unsigned int state = load(mState.value);
+			while (true) {
+				if ((state & Writer) == 0 && compareExchange(mState.value, state, state + 1)) { break; }
+				if (state & Writer) {
+					spins += backoff(round);
+					state = load(mState.value);
+				}
+			}
+			acquired(spins);
+		}
+
+		void unlock_shared() {
+			fetchSub(mState.value, 1);
+		}
+
+		/**
+		 * @brief Single attempt, fails if a writer holds or waits for the lock
+		 */
+		bool try_lock_shared() {
+			unsigned int state = load(mState.value);
+			if ((state & Writer) != 0 || !compareExchange(mState.value, state, state + 1)) {
 				return false;
 			}
-			mSpinLock = true;
+			acquired(0);
 			return true;
 		}
 	};
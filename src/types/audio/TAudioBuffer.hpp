@@ -9,6 +9,7 @@
 #endif
 
 #include "../THeapBuffer.hpp"
+#include "../../memory/TArena.hpp"
 #include "../../util/TTraits.hpp"
 #include "../../util/TLimits.hpp"
 #include "../../util/TAssert.h"
@@ -732,11 +733,29 @@ namespace tklb {
 	using AudioBufferFloat = AudioBufferTpl<float>;
 	using AudioBufferDouble = AudioBufferTpl<double>;
 
+	/**
+	 * @brief AudioBuffer for temporary data, takes its memory from the
+	 *        memory::Arena bound to the thread instead of the heap.
+	 *        Needs to be gone before the arena is rewound.
+	 */
+	template <typename T>
+	using ScratchBufferTpl = AudioBufferTpl<T, HeapBuffer<T, DEFAULT_ALIGNMENT_BYTES, memory::ArenaAllocator<>>>;
+
+	namespace traits {
+		/**
+		 * @brief Relocating only moves the storage, the samples stay where they are
+		 */
+		template <typename T, class STORAGE>
+		struct IsTriviallyRelocatable<AudioBufferTpl<T, STORAGE>> : IsTriviallyRelocatable<STORAGE> { };
+	} // namespace traits
+
 	// Default type
 	#ifdef TKLB_SAMPLE_FLOAT
 		using AudioBuffer = AudioBufferTpl<float>;
+		using ScratchBuffer = ScratchBufferTpl<float>;
 	#else
 		using AudioBuffer = AudioBufferTpl<double>;
+		using ScratchBuffer = ScratchBufferTpl<double>;
 	#endif
 
 } // namespace tklb
@@ -3,6 +3,10 @@
 
 #include "./TAudioBuffer.hpp"
 
+#ifndef TKLB_NO_STDLIB
+	#include <atomic>
+#endif
+
 namespace tklb {
 	template <typename T, class STORAGE = HeapBuffer<T, DEFAULT_ALIGNMENT_BYTES>>
 	class AudioRingBufferTpl : public AudioBufferTpl<T, STORAGE> {
@@ -158,5 +162,121 @@ namespace tklb {
 	#else
 		using AudioRingBuffer = AudioRingBufferTpl<double>;
 	#endif
+	/**
+	 * @brief Ring buffer for one producer and one consumer thread.
+	 * @details Each side keeps its own position, only the fill count
+	 *          is shared. Samples are copied before the count is released,
+	 *          so neither side ever sees unfinished data or needs a lock.
+	 *          resize() and reset() aren't thread safe.
+	 */
+	template <typename T, class STORAGE = HeapBuffer<T, DEFAULT_ALIGNMENT_BYTES>>
+	class AudioRingBufferLockFreeTpl : public AudioBufferTpl<T, STORAGE> {
+		using Base = AudioBufferTpl<T, STORAGE>;
+		using uchar = unsigned char;
+	public:
+		using Size = typename Base::Size;
+
+	private:
+		Size mRead = 0;		///< Only touched by the consumer
+		Size mWrite = 0;	///< Only touched by the producer
+		#ifndef TKLB_NO_STDLIB
+			std::atomic<Size> mFilled = { 0 };
+		#else
+			Size mFilled = 0;
+		#endif
+
+	public:
+		AudioRingBufferLockFreeTpl() { }
+
+		AudioRingBufferLockFreeTpl(const Size length, const uchar channels)
+			: Base(length, channels) { }
+
+		bool resize(const Size length, const uchar channels) {
+			reset();
+			return Base::resize(length, channels);
+		}
+
+		void reset() {
+			mRead = mWrite = 0;
+			mFilled = 0;
+		}
+
+		/**
+		 * @brief Producer side. Adds validSize() - offsetSrc frames, as many as fit.
+		 * @param in Source buffer
+		 * @param offsetSrc Where to start in the source buffer
+		 * @return How many frames where stored in the ring buffer
+		 */
+		template <typename T2, class STORAGE2>
+		Size push(const AudioBufferTpl<T2, STORAGE2>& in, Size offsetSrc = 0) {
+			TKLB_ASSERT(offsetSrc <= in.validSize())
+			const Size elements = min(in.validSize() - offsetSrc, remaining());
+			if (elements == 0) { return 0; }
+			const Size spaceLeft = Base::size() - mWrite;
+			if (spaceLeft < elements) {
+				Base::set(in, spaceLeft, offsetSrc, mWrite);
+				Base::set(in, elements - spaceLeft, offsetSrc + spaceLeft, 0);
+			} else {
+				Base::set(in, elements, offsetSrc, mWrite);
+			}
+			mWrite = (mWrite + elements) % Base::size();
+			#ifndef TKLB_NO_STDLIB
+				mFilled.fetch_add(elements, std::memory_order_release);
+			#else
+				mFilled += elements;
+			#endif
+			return elements;
+		}
+
+		/**
+		 * @brief Consumer side. Moves frames into out.
+		 * @param out Destination buffer, validSize isn't changed
+		 * @param elements Frames to retrieve at most
+		 * @param offsetDst Where to start in the destination buffer
+		 * @return How many frames where retrieved
+		 */
+		template <typename T2, class STORAGE2>
+		Size pop(AudioBufferTpl<T2, STORAGE2>& out, Size elements, Size offsetDst = 0) {
+			elements = min(elements, filled());
+			if (elements == 0) { return 0; }
+			const Size spaceLeft = Base::size() - mRead;
+			if (spaceLeft < elements) {
+				out.set(*this, spaceLeft, mRead, offsetDst);
+				out.set(*this, elements - spaceLeft, 0, offsetDst + spaceLeft);
+			} else {
+				out.set(*this, elements, mRead, offsetDst);
+			}
+			mRead = (mRead + elements) % Base::size();
+			#ifndef TKLB_NO_STDLIB
+				mFilled.fetch_sub(elements, std::memory_order_release);
+			#else
+				mFilled -= elements;
+			#endif
+			return elements;
+		}
+
+		/**
+		 * @brief Frames ready to pop
+		 */
+		Size filled() const {
+			#ifndef TKLB_NO_STDLIB
+				return mFilled.load(std::memory_order_acquire);
+			#else
+				return mFilled;
+			#endif
+		}
+
+		/**
+		 * @brief Frames which can be pushed
+		 */
+		Size remaining() const { return Base::size() - filled(); }
+	};
+
+	// Default type
+	#ifdef TKLB_SAMPLE_FLOAT
+		using AudioRingBufferLockFree = AudioRingBufferLockFreeTpl<float>;
+	#else
+		using AudioRingBufferLockFree = AudioRingBufferLockFreeTpl<double>;
+	#endif
 }
 #endif // _TKLB_AUDIORINGBUFFER
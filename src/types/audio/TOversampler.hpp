@@ -2,9 +2,12 @@
  * @file TOversampler.hpp
  * @author Tobias Kozel
  * @brief Wrapped hiir oversampler
- * @version 0.1
+ * @details Cascades up to four hiir half band stages for 2x, 4x, 8x or 16x
+ *          oversampling. Channels are interleaved so the multi channel
+ *          hiir kernels can process several channels in a single simd pass.
+ * @version 0.2
  * @date 2023-01-04
- *! TODO broken and has no tests
+ *
  * @copyright Copyright (c) 2023
  *
  */
@@ -12,180 +15,484 @@
 #ifndef _TKLB_OVERSAMPLER
 #define _TKLB_OVERSAMPLER
 
-#include <functional>
 #include "../../util/TAssert.h"
 #include "./TAudioBuffer.hpp"
+#include "../TDelegate.hpp"
+
+// Generic single channel version, used without simd or when there is no simd kernel
+#include "../../../external/hiir/hiir/Upsampler2xTpl.h"
+#include "../../../external/hiir/hiir/Downsampler2xTpl.h"
 
 #ifndef TKLB_NO_SIMD
-	#ifdef __arm__
-		#ifdef TKLB_SAMPLE_FLOAT
-			// TODO tklb PERF maybe try Upsampler2x4Neon instead
-			#include "../../../external/hiir/hiir/Upsampler2xNeon.h"
-			#include "../../../external/hiir/hiir/Downsampler2xNeon.h"
-			#define TKLB_OVERSAMPLER_UP(coeffs) hiir::Upsampler2xNeon<coeffs>
-			#define TKLB_OVERSAMPLER_DOWN(coeffs) hiir::Downsampler2xNeon<coeffs>
-		#else
-			// Software implementation, there doesn't seem to be a double simd version
-			#include "../../../external/hiir/hiir/Upsampler2xFpu.h"
-			#include "../../../external/hiir/hiir/Downsampler2xFpu.h"
-			#define TKLB_OVERSAMPLER_UP(coeffs) hiir::Upsampler2xFpuTpl<coeffs, double>
-			#define TKLB_OVERSAMPLER_DOWN(coeffs) hiir::Downsampler2xFpuTpl<coeffs, double>
-		#endif
+	#if defined(__arm__) || defined(__aarch64__)
+		#include "../../../external/hiir/hiir/Upsampler2x4Neon.h"
+		#include "../../../external/hiir/hiir/Downsampler2x4Neon.h"
 	#else
-		// TODO tklb PERF maybe try avx
-	#ifdef TKLB_SAMPLE_FLOAT
-		// #include "../../external/hiir/hiir/Upsampler2x8Avx.h"
-		// #include "../../external/hiir/hiir/Downsampler2x8Avx.h"
-		// #define TKLB_OVERSAMPLER_UP(coeffs) hiir::Upsampler2x8Avx<coeffs>
-		// #define TKLB_OVERSAMPLER_DOWN(coeffs) hiir::Downsampler2x8Avx<coeffs>
-		#include "../../../external/hiir/hiir/Upsampler2xSse.h"
-		#include "../../../external/hiir/hiir/Downsampler2xSse.h"
-		#define TKLB_OVERSAMPLER_UP(coeffs) hiir::Upsampler2xSse<coeffs>
-		#define TKLB_OVERSAMPLER_DOWN(coeffs) hiir::Downsampler2xSse<coeffs>
-	#else
-		// #include "../../external/hiir/hiir/Upsampler2x4F64Avx.h"
-		// #include "../../external/hiir/hiir/Downsampler2x4F64Avx.h"
-		// #define TKLB_OVERSAMPLER_UP(coeffs) hiir::Upsampler2x4F64Avx<coeffs>
-		// #define TKLB_OVERSAMPLER_DOWN(coeffs) hiir::Downsampler2x4F64Avx<coeffs>
-		#include "../../../external/hiir/hiir/Upsampler2xF64Sse2.h"
-		#include "../../../external/hiir/hiir/Downsampler2xF64Sse2.h"
-		#define TKLB_OVERSAMPLER_UP(coeffs) hiir::Upsampler2xF64Sse2<coeffs>
-		#define TKLB_OVERSAMPLER_DOWN(coeffs) hiir::Downsampler2xF64Sse2<coeffs>
-	#endif
+		#include "../../../external/hiir/hiir/Upsampler2x4Sse.h"
+		#include "../../../external/hiir/hiir/Downsampler2x4Sse.h"
+		#include "../../../external/hiir/hiir/Upsampler2x2F64Sse2.h"
+		#include "../../../external/hiir/hiir/Downsampler2x2F64Sse2.h"
+		#ifdef __AVX__
+			#include "../../../external/hiir/hiir/Upsampler2x8Avx.h"
+			#include "../../../external/hiir/hiir/Downsampler2x8Avx.h"
+			#include "../../../external/hiir/hiir/Upsampler2x4F64Avx.h"
+			#include "../../../external/hiir/hiir/Downsampler2x4F64Avx.h"
+		#endif
+		#ifdef __AVX512F__
+			#include "../../../external/hiir/hiir/Upsampler2x16Avx512.h"
+			#include "../../../external/hiir/hiir/Downsampler2x16Avx512.h"
+			#include "../../../external/hiir/hiir/Upsampler2x8F64Avx512.h"
+			#include "../../../external/hiir/hiir/Downsampler2x8F64Avx512.h"
+		#endif
 	#endif
-#else
-	// Software implementation
-	#include "../../../external/hiir/hiir/Upsampler2xFpu.h"
-	#include "../../../external/hiir/hiir/Downsampler2xFpu.h"
-	#define TKLB_OVERSAMPLER_UP(coeffs) hiir::Upsampler2xFpuTpl<coeffs, T>
-	#define TKLB_OVERSAMPLER_DOWN(coeffs) hiir::Downsampler2xFpuTpl<coeffs, T>
-#endif
+#endif // TKLB_NO_SIMD
 
-namespace tklb {
-/**
- * Super simple wrapper for the hiir up and down samplers
- * It only goes up to 4x oversampling
- * Its type is also bound to the Audiouffers default sample type
- * in order to avoid including all versions of the hiir library
- */
-template <int CHANNELS = 2, int MAX_BLOCK = 512>
-class Oversampler {
-public:
-	using T = AudioBuffer::Sample;
+namespace tklb { namespace oversampling {
+	/**
+	 * @brief Maps sample type and number of interleaved channels to the hiir classes.
+	 *        Defaults to the generic version which only handles a single channel.
+	 */
+	template <typename T, int LANES>
+	struct Kernel {
+		template <int NC> using Up = hiir::Upsampler2xTpl<NC, T, LANES>;
+		template <int NC> using Down = hiir::Downsampler2xTpl<NC, T, LANES>;
+	};
 
-	using uchar = unsigned char;
-	using uint = unsigned int;
-	using Size = AudioBuffer::Size;
+	/**
+	 * @brief Range of channel counts the simd kernels are available for.
+	 *        0 means there's no simd version and each channel is processed on its own.
+	 */
+	template <typename T>
+	struct Lanes {
+		static constexpr int Min = 0;
+		static constexpr int Max = 0;
+	};
 
-	// TODO tklb Use the buffer instead
-	// TODO use delegeate
-	using ProcessFunction = std::function<void(T**, T**, Size)>;
+#ifndef TKLB_NO_SIMD
+	#if defined(__arm__) || defined(__aarch64__)
+		template <> struct Kernel<float, 4> {
+			template <int NC> using Up = hiir::Upsampler2x4Neon<NC>;
+			template <int NC> using Down = hiir::Downsampler2x4Neon<NC>;
+		};
+		// There doesn't seem to be a double simd version
+		template <> struct Lanes<float> { static constexpr int Min = 4, Max = 4; };
+	#else
+		template <> struct Kernel<float, 4> {
+			template <int NC> using Up = hiir::Upsampler2x4Sse<NC>;
+			template <int NC> using Down = hiir::Downsampler2x4Sse<NC>;
+		};
+		template <> struct Kernel<double, 2> {
+			template <int NC> using Up = hiir::Upsampler2x2F64Sse2<NC>;
+			template <int NC> using Down = hiir::Downsampler2x2F64Sse2<NC>;
+		};
+		#ifdef __AVX__
+			template <> struct Kernel<float, 8> {
+				template <int NC> using Up = hiir::Upsampler2x8Avx<NC>;
+				template <int NC> using Down = hiir::Downsampler2x8Avx<NC>;
+			};
+			template <> struct Kernel<double, 4> {
+				template <int NC> using Up = hiir::Upsampler2x4F64Avx<NC>;
+				template <int NC> using Down = hiir::Downsampler2x4F64Avx<NC>;
+			};
+		#endif
+		#ifdef __AVX512F__
+			template <> struct Kernel<float, 16> {
+				template <int NC> using Up = hiir::Upsampler2x16Avx512<NC>;
+				template <int NC> using Down = hiir::Downsampler2x16Avx512<NC>;
+			};
+			template <> struct Kernel<double, 8> {
+				template <int NC> using Up = hiir::Upsampler2x8F64Avx512<NC>;
+				template <int NC> using Down = hiir::Downsampler2x8F64Avx512<NC>;
+			};
+			template <> struct Lanes<float> { static constexpr int Min = 4, Max = 16; };
+			template <> struct Lanes<double> { static constexpr int Min = 2, Max = 8; };
+		#elif defined(__AVX__)
+			template <> struct Lanes<float> { static constexpr int Min = 4, Max = 8; };
+			template <> struct Lanes<double> { static constexpr int Min = 2, Max = 4; };
+		#else
+			template <> struct Lanes<float> { static constexpr int Min = 4, Max = 4; };
+			template <> struct Lanes<double> { static constexpr int Min = 2, Max = 2; };
+		#endif
+	#endif
+#endif // TKLB_NO_SIMD
 
-private:
-	TKLB_OVERSAMPLER_UP(12) mUp2x[CHANNELS];
-	TKLB_OVERSAMPLER_UP(4) mUp4x[CHANNELS];
-	TKLB_OVERSAMPLER_DOWN(12) mDown2x[CHANNELS];
-	TKLB_OVERSAMPLER_DOWN(4) mDown4x[CHANNELS];
+	/**
+	 * @brief Picks the narrowest kernel which fits all channels.
+	 *        More channels than the widest kernel are split up in groups.
+	 */
+	template <typename T>
+	constexpr int pickLanes(int channels) {
+		if (Lanes<T>::Max == 0) { return 1; }
+		int lanes = Lanes<T>::Min;
+		while (lanes < channels && lanes < Lanes<T>::Max) { lanes *= 2; }
+		return lanes;
+	}
 
-	AudioBuffer mBuf2xUp, mBuf2xDown, mBuf4xUp, mBuf4xDown;
+	/**
+	 * @brief Delay of a hiir half band filter for low frequencies
+	 *        in samples at the higher rate.
+	 * @details Each stage is a second order allpass in z^2, so it
+	 *          contributes 2 * (1 - a) / (1 + a) samples at DC.
+	 *          The odd path has an additional sample of delay.
+	 */
+	constexpr double halfBandDelay(const double* coefs, int count) {
+		double even = 0, odd = 1;
+		for (int i = 0; i < count; i++) {
+			const double delay = 2.0 * (1.0 - coefs[i]) / (1.0 + coefs[i]);
+			if (i % 2 == 0) { even += delay; } else { odd += delay; }
+		}
+		return (even + odd) * 0.5;
+	}
 
 	/**
-	 * Straight up stolen from the hiir oversampler wrapper from iPlug2
+	 * Coefficients for the 1x to 2x stage straight up stolen from
+	 * the hiir oversampler wrapper from iPlug2
 	 * https://github.com/iPlug2/iPlug2/blob/master/IPlug/Extras/Oversampler.h
 	 */
-	const double coeffs2x[12] = {
+	constexpr int Stage0Coefs = 12;
+	constexpr double Stage0[Stage0Coefs] = {
 		0.036681502163648017, 0.13654762463195794, 0.27463175937945444,
 		0.42313861743656711, 0.56109869787919531, 0.67754004997416184,
 		0.76974183386322703, 0.83988962484963892, 0.89226081800387902,
 		0.9315419599631839, 0.96209454837808417, 0.98781637073289585
 	};
-	const double coeffs4x[4] = {
+
+	/**
+	 * 2x to 4x stage, also from iPlug2.
+	 * The signal only occupies the lower quarter, so the transition band is wide.
+	 */
+	constexpr int Stage1Coefs = 4;
+	constexpr double Stage1[Stage1Coefs] = {
 		0.041893991997656171, 0.16890348243995201,
 		0.39056077292116603, 0.74389574826847926
 	};
 
-	uchar mFactor = 1;
-	ProcessFunction mProc;
-public:
-
-	Oversampler() {
-		for (uchar c = 0; c < CHANNELS; c++) {
-			mUp2x[c].set_coefs(coeffs2x);
-			mDown2x[c].set_coefs(coeffs2x);
-			mUp4x[c].set_coefs(coeffs4x);
-			mDown4x[c].set_coefs(coeffs4x);
-		}
-		mBuf2xDown.resize(MAX_BLOCK * 2, CHANNELS);
-		mBuf2xUp.resize(MAX_BLOCK * 2, CHANNELS);
-		mBuf4xDown.resize(MAX_BLOCK * 4, CHANNELS);
-		mBuf4xUp.resize(MAX_BLOCK * 4, CHANNELS);
-	}
+	/**
+	 * 4x to 8x and 8x to 16x stages,
+	 * last stage of the 8x 129 dB design in hiir/oversampling.txt
+	 */
+	constexpr int Stage2Coefs = 3;
+	constexpr double Stage2[Stage2Coefs] = {
+		0.055006689941721712, 0.24080823797621789, 0.64456305579326278
+	};
+} } // tklb::oversampling
 
-	void setProcessFunc(const ProcessFunction& f) {
-		mProc = f;
-	}
+namespace tklb {
+	/**
+	 * @brief Oversampler cascading 2x hiir stages for up to 16x oversampling.
+	 *        Its type is bound to the AudioBuffers default sample type
+	 *        in order to avoid including all versions of the hiir library.
+	 * @tparam CHANNELS Channel count, sets the hiir kernel width
+	 * @tparam MAX_BLOCK Maximum block size at the base rate
+	 * @tparam MAX_FACTOR Highest oversampling factor to allocate buffers for
+	 */
+	template <int CHANNELS = 2, int MAX_BLOCK = 512, int MAX_FACTOR = 16>
+	class Oversampler {
+	public:
+		using T = AudioBuffer::Sample;
 
-	void setFactor(const uchar factor) {
-		mFactor = factor;
-	}
+		using uchar = unsigned char;
+		using uint = unsigned int;
+		using Size = AudioBuffer::Size;
 
-	int getFactor() const {
-		return mFactor;
-	}
+		/**
+		 * @brief Type for setProcessFunc(), doesn't allocate but can't be inlined.
+		 *        Prefer passing the processor to process() directly in performance sensitive code
+		 */
+		using ProcessFunction = Delegate<void(T**, T**, Size)>;
 
-	void process(AudioBuffer& in, AudioBuffer& out) {
-		process(in.getRaw(), out.getRaw(), in.size());
-	}
+		static constexpr int MaxStages = 4;
+		static_assert(
+			MAX_FACTOR == 1 || MAX_FACTOR == 2 || MAX_FACTOR == 4 ||
+			MAX_FACTOR == 8 || MAX_FACTOR == 16,
+			"MAX_FACTOR needs to be a power of 2 up to 16"
+		);
+
+		/**
+		 * @brief Channels processed in a single hiir pass
+		 */
+		static constexpr int Lanes = oversampling::pickLanes<T>(CHANNELS);
+
+		/**
+		 * @brief Number of passes needed to process all channels
+		 */
+		static constexpr int Groups = (CHANNELS + Lanes - 1) / Lanes;
+
+	private:
+		using Kernel = oversampling::Kernel<T, Lanes>;
+		template <int NC> using Up = typename Kernel::template Up<NC>;
+		template <int NC> using Down = typename Kernel::template Down<NC>;
 
-	void process(T** in, T** out, const Size frames) {
-		TKLB_ASSERT(frames <= MAX_BLOCK)
 		/**
-		 * No OverSampling at all
+		 * @brief All filter stages.
+		 *        Stored on the heap since some of the simd versions need
+		 *        more alignment than new guarantees before c++17.
 		 */
-		if (mFactor == 1) {
-			mProc(in, out, frames);
-			return;
+		struct Filters {
+			Up<oversampling::Stage0Coefs> up0[Groups];
+			Up<oversampling::Stage1Coefs> up1[Groups];
+			Up<oversampling::Stage2Coefs> up2[Groups];
+			Up<oversampling::Stage2Coefs> up3[Groups];
+			Down<oversampling::Stage0Coefs> down0[Groups];
+			Down<oversampling::Stage1Coefs> down1[Groups];
+			Down<oversampling::Stage2Coefs> down2[Groups];
+			Down<oversampling::Stage2Coefs> down3[Groups];
+
+			Filters() {
+				for (int g = 0; g < Groups; g++) {
+					up0[g].set_coefs(oversampling::Stage0);
+					up1[g].set_coefs(oversampling::Stage1);
+					up2[g].set_coefs(oversampling::Stage2);
+					up3[g].set_coefs(oversampling::Stage2);
+					down0[g].set_coefs(oversampling::Stage0);
+					down1[g].set_coefs(oversampling::Stage1);
+					down2[g].set_coefs(oversampling::Stage2);
+					down3[g].set_coefs(oversampling::Stage2);
+				}
+			}
+
+			void clear() {
+				for (int g = 0; g < Groups; g++) {
+					up0[g].clear_buffers(); up1[g].clear_buffers();
+					up2[g].clear_buffers(); up3[g].clear_buffers();
+					down0[g].clear_buffers(); down1[g].clear_buffers();
+					down2[g].clear_buffers(); down3[g].clear_buffers();
+				}
+			}
+		};
+
+		HeapBuffer<Filters, 64> mFilters;
+
+		/**
+		 * @brief Interleaved scratch space for the filter stages, used as ping pong buffers
+		 */
+		HeapBuffer<T, DEFAULT_ALIGNMENT_BYTES> mInterleaved[2];
+
+		/**
+		 * @brief Buffers at the oversampled rate handed to the process function
+		 */
+		AudioBuffer mBufUp, mBufDown;
+		T* mRawUp[CHANNELS];
+		T* mRawDown[CHANNELS];
+
+		uchar mFactor = 1;
+		uchar mStages = 0;
+		ProcessFunction mProc;
+
+		static void interleave(T** in, int group, Size frames, T* out) {
+			for (int l = 0; l < Lanes; l++) {
+				const int channel = group * Lanes + l;
+				if (channel < CHANNELS) {
+					const T* source = in[channel];
+					for (Size i = 0, j = l; i < frames; i++, j += Lanes) {
+						out[j] = source[i];
+					}
+				} else {
+					// pad unused lanes with silence
+					for (Size i = 0, j = l; i < frames; i++, j += Lanes) {
+						out[j] = 0;
+					}
+				}
+			}
+		}
+
+		static void deinterleave(const T* in, int group, Size frames, T** out) {
+			for (int l = 0; l < Lanes; l++) {
+				const int channel = group * Lanes + l;
+				if (CHANNELS <= channel) { return; }
+				T* target = out[channel];
+				for (Size i = 0, j = l; i < frames; i++, j += Lanes) {
+					target[i] = in[j];
+				}
+			}
+		}
+
+		/**
+		 * @brief Filters the input up into mBufUp
+		 */
+		void upsample(T** in, const Size frames) {
+			Filters& filters = mFilters[0];
+			for (int g = 0; g < Groups; g++) {
+				T* source = mInterleaved[0].data();
+				T* target = mInterleaved[1].data();
+				Size length = frames;
+				interleave(in, g, length, source);
+				filters.up0[g].process_block(target, source, length);
+				length *= 2;
+				if (1 < mStages) {
+					filters.up1[g].process_block(source, target, length);
+					length *= 2;
+					swap(source, target);
+				}
+				if (2 < mStages) {
+					filters.up2[g].process_block(source, target, length);
+					length *= 2;
+					swap(source, target);
+				}
+				if (3 < mStages) {
+					filters.up3[g].process_block(source, target, length);
+					length *= 2;
+					swap(source, target);
+				}
+				deinterleave(target, g, length, mRawUp);
+			}
+		}
+
+		/**
+		 * @brief Filters mBufDown down into the output
+		 */
+		void downsample(T** out, const Size frames) {
+			Filters& filters = mFilters[0];
+			const Size framesUp = frames * mFactor;
+			for (int g = 0; g < Groups; g++) {
+				T* source = mInterleaved[0].data();
+				T* target = mInterleaved[1].data();
+				Size length = framesUp;
+				interleave(mRawDown, g, length, source);
+				if (3 < mStages) {
+					length /= 2;
+					filters.down3[g].process_block(target, source, length);
+					swap(source, target);
+				}
+				if (2 < mStages) {
+					length /= 2;
+					filters.down2[g].process_block(target, source, length);
+					swap(source, target);
+				}
+				if (1 < mStages) {
+					length /= 2;
+					filters.down1[g].process_block(target, source, length);
+					swap(source, target);
+				}
+				length /= 2;
+				filters.down0[g].process_block(target, source, length);
+				deinterleave(target, g, length, out);
+			}
+		}
+
+	public:
+		Oversampler() {
+			mFilters.resize(1);
+			const Size maxFrames = MAX_BLOCK * MAX_FACTOR;
+			for (auto& i : mInterleaved) {
+				i.resize(maxFrames * Lanes);
+				memory::set<T>(i.data(), i.size(), T(0));
+			}
+			mBufUp.resize(maxFrames, CHANNELS);
+			mBufDown.resize(maxFrames, CHANNELS);
+			mBufUp.getRaw(mRawUp);
+			mBufDown.getRaw(mRawDown);
+		}
+
+		void setProcessFunc(const ProcessFunction& f) {
+			mProc = f;
 		}
 
 		/**
-		 * 2x OverSampling
+		 * @brief Set the oversampling factor, will not allocate.
+		 * @param factor 1, 2, 4, 8 or 16. Other values are rounded down
+		 *               to the next power of 2.
 		 */
-		if (mFactor == 2 || mFactor == 3) {
-			for (uchar c = 0; c < CHANNELS; c++) {
-				mUp2x[c].process_block(mBuf2xUp[c], in[c], frames);
+		void setFactor(const uchar factor) {
+			TKLB_ASSERT(0 < factor && factor <= MAX_FACTOR)
+			uchar stages = 0;
+			while (stages < MaxStages && (2 << stages) <= min(int(factor), MAX_FACTOR)) {
+				stages++;
 			}
+			if (stages == mStages) { return; }
+			mStages = stages;
+			mFactor = 1 << stages;
+			// stale filter state from another factor would only cause a glitch
+			mFilters[0].clear();
+		}
 
-			mProc(mBuf2xUp.getRaw(), mBuf2xDown.getRaw(), frames * 2);
+		int getFactor() const {
+			return mFactor;
+		}
 
-			for (uchar c = 0; c < CHANNELS; c++) {
-				mDown2x[c].process_block(out[c], mBuf2xDown[c], frames);
+		/**
+		 * @brief Latency of the up and down sampling in samples at the base rate.
+		 *        Only accurate for lower frequencies since the filters aren't linear phase.
+		 */
+		double getLatency() const {
+			constexpr double delayUp = Up<1>::_delay;
+			constexpr double delayDown = Down<1>::_delay;
+			const double stages[MaxStages] = {
+				oversampling::halfBandDelay(oversampling::Stage0, oversampling::Stage0Coefs),
+				oversampling::halfBandDelay(oversampling::Stage1, oversampling::Stage1Coefs),
+				oversampling::halfBandDelay(oversampling::Stage2, oversampling::Stage2Coefs),
+				oversampling::halfBandDelay(oversampling::Stage2, oversampling::Stage2Coefs)
+			};
+			double latency = 0;
+			double rate = 2; // each stage runs at twice the rate of the previous
+			for (int i = 0; i < mStages; i++) {
+				latency += (2.0 * stages[i] + delayUp + delayDown) / rate;
+				rate *= 2;
 			}
-			return;
+			return latency;
+		}
+
+		/**
+		 * @brief Process a buffer with the function set in setProcessFunc()
+		 */
+		void process(AudioBuffer& in, AudioBuffer& out) {
+			process(in, out, mProc);
 		}
 
 		/**
-		 * 4x OverSampling
+		 * @brief Process a buffer with the provided callable
+		 * @see process(T**, T**, Size, Func&&)
 		 */
-		for (uchar c = 0; c < CHANNELS; c++) {
-			mUp2x[c].process_block(mBuf2xUp[c], in[c], frames);
-			mUp4x[c].process_block(mBuf4xUp[c], mBuf2xUp[c], frames * 2);
+		template <class Func>
+		void process(AudioBuffer& in, AudioBuffer& out, Func&& func) {
+			TKLB_ASSERT(in.channels() == CHANNELS && out.channels() == CHANNELS)
+			T* rawIn[CHANNELS];
+			T* rawOut[CHANNELS];
+			in.getRaw(rawIn);
+			out.getRaw(rawOut);
+			process(rawIn, rawOut, in.validSize(), func);
+			out.setValidSize(in.validSize());
 		}
 
-		mProc(mBuf4xUp.getRaw(), mBuf4xDown.getRaw(), frames * 4);
+		/**
+		 * @brief Process with the function set in setProcessFunc()
+		 */
+		void process(T** in, T** out, const Size frames) {
+			process(in, out, frames, mProc);
+		}
 
-		for (uchar c = 0; c < CHANNELS; c++) {
-			mDown4x[c].process_block(mBuf2xDown[c], mBuf4xDown[c], frames * 2);
-			mDown2x[c].process_block(out[c], mBuf2xDown[c], frames);
+		/**
+		 * @brief Process with any callable taking (T** in, T** out, Size frames).
+		 *        Lambdas and functors are called directly and can be inlined,
+		 *        unlike the Delegate set with setProcessFunc().
+		 * @param func Called once per block at the oversampled rate
+		 */
+		template <class Func>
+		void process(T** in, T** out, const Size frames, Func&& func) {
+			TKLB_ASSERT(frames <= MAX_BLOCK)
+			if (mStages == 0) {
+				func(in, out, frames);
+				return;
+			}
+			upsample(in, frames);
+			func(mRawUp, mRawDown, frames * mFactor);
+			downsample(out, frames);
 		}
-	}
 
-	static const char* getLicense() {
-		return
-			"HIIR Library by\n"
-			"WTFPL Licensed\n";
-			"Using iPlug2 filter coefficients.";
-	}
-};
+		static const char* getLicense() {
+			return
+				"HIIR Library by Laurent de Soras\n"
+				"WTFPL Licensed\n"
+				"Using iPlug2 filter coefficients.";
+		}
+
+	private:
+		static void swap(T*& a, T*& b) {
+			T* temp = a;
+			a = b;
+			b = temp;
+		}
+	};
 
 } // namespace
 
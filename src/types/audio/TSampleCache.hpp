@@ -0,0 +1,499 @@
+/**
+ * @file TSampleCache.hpp
+ * @author Tobias Kozel
+ * @brief Shared cache for decoded and resampled audio
+ * @version 0.1
+ * @date 2023-03-12
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+
+#ifndef _TKLB_SAMPLE_CACHE
+#define _TKLB_SAMPLE_CACHE
+
+#include "./TAudioBuffer.hpp"
+#include "./resampler/TResamplerDbry.hpp"
+#include "../THandleBuffer.hpp"
+
+#ifndef TKLB_NO_STDLIB
+
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <functional>
+
+namespace tklb {
+	/**
+	 * @brief Keeps decoded audio around so repeatedly used assets are only decoded once.
+	 * @details Entries are keyed by asset id and sample rate, a rate of 0 means
+	 *          the rate the asset was decoded with. Resampled variants are derived
+	 *          from the cached original, so each conversion is only paid for once.
+	 *          Samples are reference counted, entries nobody references stay
+	 *          cached until the byte budget is exceeded and they are the least
+	 *          recently used ones. Loads which don't fit into the budget even after
+	 *          evicting everything unused fail instead of exceeding it.
+	 *          Copying and dropping a Sample doesn't lock, everything else does.
+	 * @tparam T Sample type
+	 * @tparam Buffer AudioBuffer type
+	 */
+	template <typename T, class Buffer = AudioBufferTpl<T>>
+	class SampleCacheTpl {
+	public:
+		using Size = typename Buffer::Size;
+		using Asset = unsigned int;
+
+		/**
+		 * @brief Decodes an asset, e.g. with Wave::load or vorbis::load.
+		 *        Called from the worker threads or the thread calling get().
+		 * @return False if the asset couldn't be loaded
+		 */
+		using Loader = std::function<bool(Asset asset, Buffer& out)>;
+
+		struct Options {
+			SizeT budget = 256 * 1024 * 1024;	///< Maximum bytes of decoded audio
+			unsigned int entries = 4096;		///< Maximum entries, including resampled variants
+			unsigned int workers = 1;			///< Threads for request(), 0 to call work() manually
+			Size quality = 5;					///< Resampler quality, @see ResamplerDbryTpl
+		};
+
+	private:
+		using Handle = unsigned int;
+		struct Entry;
+		using Entries = HandleBuffer<Entry, Handle>;
+		static constexpr Handle Invalid = ~Handle(0);
+
+		enum class State { Loading, Ready, Failed };
+
+	public:
+		/**
+		 * @brief Reference counted access to a cache entry.
+		 *        The audio stays valid as long as a Sample points to it.
+		 */
+		class Sample {
+			friend SampleCacheTpl;
+			SampleCacheTpl* mCache = nullptr;
+			Entry* mEntry = nullptr;
+
+			Sample(SampleCacheTpl* cache, Entry* entry) : mCache(cache), mEntry(entry) {
+				mEntry->refs++;
+			}
+
+		public:
+			Sample() = default;
+
+			Sample(const Sample& other) : mCache(other.mCache), mEntry(other.mEntry) {
+				if (mEntry != nullptr) { mEntry->refs++; }
+			}
+
+			Sample(Sample&& other) : mCache(other.mCache), mEntry(other.mEntry) {
+				other.mEntry = nullptr;
+			}
+
+			Sample& operator=(const Sample& other) {
+				if (this == &other) { return *this; }
+				reset();
+				mCache = other.mCache;
+				mEntry = other.mEntry;
+				if (mEntry != nullptr) { mEntry->refs++; }
+				return *this;
+			}
+
+			Sample& operator=(Sample&& other) {
+				if (this == &other) { return *this; }
+				reset();
+				mCache = other.mCache;
+				mEntry = other.mEntry;
+				other.mEntry = nullptr;
+				return *this;
+			}
+
+			~Sample() { reset(); }
+
+			void reset() {
+				if (mEntry != nullptr) { mEntry->refs--; }
+				mEntry = nullptr;
+			}
+
+			/**
+			 * @brief False if the cache was full of referenced entries
+			 */
+			bool valid() const { return mEntry != nullptr; }
+
+			bool ready() const { return valid() && mEntry->state == State::Ready; }
+
+			bool failed() const { return !valid() || mEntry->state == State::Failed; }
+
+			/**
+			 * @brief Blocks until a requested sample is loaded
+			 * @return False if loading failed
+			 */
+			bool wait() {
+				if (!valid()) { return false; }
+				mCache->wait(*mEntry);
+				return ready();
+			}
+
+			/**
+			 * @brief The audio or nullptr if it's not ready
+			 */
+			const Buffer* get() const {
+				if (!ready()) { return nullptr; }
+				return mEntry->alias.valid() ? mEntry->alias.get() : &mEntry->buffer;
+			}
+
+			const Buffer& operator*() const { return *get(); }
+
+			const Buffer* operator->() const { return get(); }
+		};
+
+	private:
+		struct Entry {
+			Asset asset = 0;
+			Size rate = 0;
+			Buffer buffer;
+			Sample alias;						///< Set instead of the buffer if the original already has the rate
+			SizeT bytes = 0;
+			std::atomic<unsigned int> refs = { 0 };
+			std::atomic<State> state = { State::Loading };
+			bool queued = false;				///< Waiting for a worker
+			Handle self = Invalid;
+			Handle newer = Invalid;				///< LRU list
+			Handle older = Invalid;
+			Handle bucketNext = Invalid;		///< Hash bucket chain
+		};
+
+		Loader mLoader;
+		Options mOptions;
+		Entries mEntries;
+		HeapBuffer<Handle> mBuckets;
+		Handle mNewest = Invalid;
+		Handle mOldest = Invalid;
+		// Written under mMutex, atomic so the accessors can read them from any thread
+		std::atomic<SizeT> mUsed = { 0 };
+		std::atomic<SizeT> mHits = { 0 };
+		std::atomic<SizeT> mMisses = { 0 };
+
+		HeapBuffer<Entry*> mQueue;				///< Fifo of requested entries, holds a reference each
+		SizeT mQueueStart = 0;
+		SizeT mQueueCount = 0;
+
+		HeapBuffer<std::thread*> mWorkers;
+		std::atomic<bool> mQuit = { false };
+		mutable std::mutex mMutex;
+		std::condition_variable mWake;			///< Work was queued
+		std::condition_variable mLoaded;		///< An entry finished loading
+
+		Handle bucketOf(Asset asset, Size rate) const {
+			const Handle hash = (asset * 2654435761u) ^ (Handle(rate) * 40503u);
+			return hash & (mBuckets.size() - 1);
+		}
+
+		Entry* find(Asset asset, Size rate) {
+			Handle handle = mBuckets[bucketOf(asset, rate)];
+			while (handle != Invalid) {
+				Entry& entry = mEntries[handle];
+				if (entry.asset == asset && entry.rate == rate) { return &entry; }
+				handle = entry.bucketNext;
+			}
+			return nullptr;
+		}
+
+		void unlink(Entry& entry) {
+			if (entry.newer != Invalid) { mEntries[entry.newer].older = entry.older; }
+			else { mNewest = entry.older; }
+			if (entry.older != Invalid) { mEntries[entry.older].newer = entry.newer; }
+			else { mOldest = entry.newer; }
+			entry.newer = entry.older = Invalid;
+		}
+
+		void linkNewest(Entry& entry) {
+			entry.older = mNewest;
+			entry.newer = Invalid;
+			if (mNewest != Invalid) { mEntries[mNewest].newer = entry.self; }
+			mNewest = entry.self;
+			if (mOldest == Invalid) { mOldest = entry.self; }
+		}
+
+		void erase(Entry& entry) {
+			Handle* link = &mBuckets[bucketOf(entry.asset, entry.rate)];
+			while (*link != entry.self) { link = &mEntries[*link].bucketNext; }
+			*link = entry.bucketNext;
+			unlink(entry);
+			mUsed.fetch_sub(entry.bytes, std::memory_order_relaxed);
+			mEntries.remove(entry.self);
+		}
+
+		/**
+		 * @brief Drops the least recently used entry nobody references
+		 */
+		bool evictOne() {
+			Handle handle = mOldest;
+			while (handle != Invalid) {
+				Entry& entry = mEntries[handle];
+				if (entry.refs == 0 && entry.state != State::Loading) {
+					erase(entry);
+					return true;
+				}
+				handle = entry.newer;
+			}
+			return false;
+		}
+
+		Entry* create(Asset asset, Size rate) {
+			Handle handle = mEntries.create();
+			if (handle == Entries::InvalidHandle && evictOne()) {
+				handle = mEntries.create();
+			}
+			if (handle == Entries::InvalidHandle) { return nullptr; } // ! Everything is referenced
+			Entry& entry = mEntries[handle];
+			entry.asset = asset;
+			entry.rate = rate;
+			entry.self = handle;
+			Handle& bucket = mBuckets[bucketOf(asset, rate)];
+			entry.bucketNext = bucket;
+			bucket = handle;
+			linkNewest(entry);
+			return &entry;
+		}
+
+		/**
+		 * @brief Looks up or creates an entry
+		 * @param created Set if the caller needs to load it
+		 */
+		Sample acquire(Asset asset, Size rate, bool async, bool& created) {
+			std::lock_guard<std::mutex> lock(mMutex);
+			created = false;
+			Entry* entry = find(asset, rate);
+			if (entry != nullptr && entry->state == State::Failed && entry->refs == 0) {
+				erase(*entry); // Try again
+				entry = nullptr;
+			}
+			if (entry != nullptr) {
+				mHits.fetch_add(1, std::memory_order_relaxed);
+				unlink(*entry);
+				linkNewest(*entry);
+				return Sample(this, entry);
+			}
+			mMisses.fetch_add(1, std::memory_order_relaxed);
+			entry = create(asset, rate);
+			if (entry == nullptr) { return Sample(); }
+			if (async) {
+				entry->refs++; // Reference held by the queue
+				entry->queued = true;
+				mQueue[Handle((mQueueStart + mQueueCount) % mQueue.size())] = entry;
+				mQueueCount++;
+				mWake.notify_one();
+			} else {
+				created = true;
+			}
+			return Sample(this, entry);
+		}
+
+		/**
+		 * @brief Decodes or resamples an entry, called without the lock
+		 */
+		void load(Entry& entry) {
+			Buffer result;
+			Sample alias;
+			bool ok = false;
+			if (entry.rate == 0) {
+				ok = mLoader(entry.asset, result);
+			} else {
+				Sample original = get(entry.asset, 0);
+				if (original.ready()) {
+					ok = true;
+					if (original->sampleRate == entry.rate) {
+						alias = original; // No need to store it twice
+					} else {
+						result.clone(*original);
+						result.sampleRate = original->sampleRate;
+						result.setValidSize(original->validSize());
+						ResamplerDbryTpl<T, Buffer>::resample(result, entry.rate, mOptions.quality);
+					}
+				}
+			}
+
+			{
+				std::lock_guard<std::mutex> lock(mMutex);
+				if (ok) {
+					const SizeT bytes = SizeT(result.size()) * result.channels() * sizeof(T);
+					while (mOptions.budget < used() + bytes && evictOne()) { }
+					ok = used() + bytes <= mOptions.budget;
+					if (ok) {
+						entry.buffer = static_cast<Buffer&&>(result);
+						entry.alias = static_cast<Sample&&>(alias);
+						entry.bytes = bytes;
+						mUsed.fetch_add(bytes, std::memory_order_relaxed);
+					}
+				}
+				entry.state = ok ? State::Ready : State::Failed;
+			}
+			mLoaded.notify_all();
+		}
+
+		/**
+		 * @brief Loads the entry on this thread if no worker took it yet,
+		 *        otherwise waits for the worker
+		 */
+		void wait(Entry& entry) {
+			std::unique_lock<std::mutex> lock(mMutex);
+			if (entry.queued) {
+				// The queue still holds the reference and drops it when popping
+				entry.queued = false;
+				lock.unlock();
+				load(entry);
+				return;
+			}
+			mLoaded.wait(lock, [&]() { return entry.state != State::Loading; });
+		}
+
+		void workerLoop() {
+			while (!mQuit) {
+				if (work()) { continue; }
+				std::unique_lock<std::mutex> lock(mMutex);
+				mWake.wait_for(lock, std::chrono::milliseconds(10));
+			}
+		}
+
+	public:
+		SampleCacheTpl(const Loader& loader, const Options& options = {}) :
+			mLoader(loader), mOptions(options)
+		{
+			TKLB_ASSERT(0 < options.entries)
+			mEntries.setLimit(options.entries);
+			mEntries.resize(options.entries);
+			mQueue.resize(options.entries);
+			Handle buckets = 1;
+			while (buckets < options.entries) { buckets *= 2; }
+			mBuckets.resize(buckets);
+			for (Handle i = 0; i < buckets; i++) { mBuckets[i] = Invalid; }
+			mWorkers.resize(options.workers);
+			for (unsigned int i = 0; i < options.workers; i++) {
+				mWorkers[i] = TKLB_NEW_PARAM(std::thread, &SampleCacheTpl::workerLoop, this)
+			}
+		}
+
+		SampleCacheTpl(const SampleCacheTpl&) = delete;
+		SampleCacheTpl& operator=(const SampleCacheTpl&) = delete;
+
+		/**
+		 * @brief All Samples need to be dropped before
+		 */
+		~SampleCacheTpl() {
+			mQuit = true;
+			mWake.notify_all();
+			for (Handle i = 0; i < mWorkers.size(); i++) {
+				mWorkers[i]->join();
+				TKLB_DELETE(std::thread, mWorkers[i])
+			}
+			// Drop the references held by the queue without loading
+			for (; mQueueCount != 0; mQueueCount--) {
+				mQueue[Handle(mQueueStart)]->refs--;
+				mQueueStart = (mQueueStart + 1) % mQueue.size();
+			}
+			clear();
+			TKLB_ASSERT(count() == 0)
+		}
+
+		/**
+		 * @brief Returns the cached sample or loads it on the calling thread
+		 * @param rate Sample rate to resample to, 0 to keep the original rate
+		 */
+		Sample get(Asset asset, Size rate = 0) {
+			bool created = false;
+			Sample sample = acquire(asset, rate, false, created);
+			if (!sample.valid()) { return sample; }
+			if (created) {
+				load(*sample.mEntry);
+			} else if (sample.mEntry->state == State::Loading) {
+				wait(*sample.mEntry);
+			}
+			return sample;
+		}
+
+		/**
+		 * @brief Returns immediately, the workers load the sample if it's not cached.
+		 *        Check ready() or wait() on the result.
+		 * @param rate Sample rate to resample to, 0 to keep the original rate
+		 */
+		Sample request(Asset asset, Size rate = 0) {
+			bool created = false;
+			return acquire(asset, rate, true, created);
+		}
+
+		/**
+		 * @brief Loads one requested sample on the calling thread.
+		 *        Only needed without workers.
+		 * @return False if nothing was left to load
+		 */
+		bool work() {
+			Entry* entry = nullptr;
+			{
+				std::lock_guard<std::mutex> lock(mMutex);
+				while (entry == nullptr) {
+					if (mQueueCount == 0) { return false; }
+					entry = mQueue[Handle(mQueueStart)];
+					mQueueStart = (mQueueStart + 1) % mQueue.size();
+					mQueueCount--;
+					if (!entry->queued) {
+						// Already loaded by wait(), only drop the queue reference
+						entry->refs--;
+						entry = nullptr;
+					}
+				}
+				entry->queued = false;
+			}
+			load(*entry);
+			entry->refs--; // Queue reference
+			return true;
+		}
+
+		/**
+		 * @brief Evicts every entry nobody references
+		 */
+		void clear() {
+			std::lock_guard<std::mutex> lock(mMutex);
+			while (evictOne()) { }
+		}
+
+		/**
+		 * @brief Bytes of audio held
+		 */
+		SizeT used() const { return mUsed.load(std::memory_order_relaxed); }
+
+		SizeT budget() const { return mOptions.budget; }
+
+		/**
+		 * @brief Entries in the cache, including failed and loading ones
+		 */
+		Handle count() const {
+			std::lock_guard<std::mutex> lock(mMutex);
+			return mEntries.count();
+		}
+
+		/**
+		 * @brief Lookups which found an existing entry
+		 */
+		SizeT hits() const { return mHits.load(std::memory_order_relaxed); }
+
+		/**
+		 * @brief Lookups which had to load
+		 */
+		SizeT misses() const { return mMisses.load(std::memory_order_relaxed); }
+	};
+
+	// Default type
+	#ifdef TKLB_SAMPLE_FLOAT
+		using SampleCache = SampleCacheTpl<float>;
+	#else
+		using SampleCache = SampleCacheTpl<double>;
+	#endif
+
+} // namespace tklb
+
+#endif // TKLB_NO_STDLIB
+
+#endif // _TKLB_SAMPLE_CACHE
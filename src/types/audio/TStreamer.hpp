@@ -0,0 +1,350 @@
+/**
+ * @file TStreamer.hpp
+ * @author Tobias Kozel
+ * @brief Decodes many streams ahead of time on worker threads
+ * @version 0.1
+ * @date 2023-03-10
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+
+#ifndef _TKLB_STREAMER
+#define _TKLB_STREAMER
+
+#include "./TAudioBuffer.hpp"
+#include "./TAudioRingBuffer.hpp"
+#include "./codec/TICodec.hpp"
+
+#ifndef TKLB_NO_STDLIB
+
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+
+namespace tklb {
+	/**
+	 * @brief Plays long files without holding them in memory.
+	 * @details Worker threads decode each stream ahead into its own lock free
+	 *          ring buffer, the audio thread only copies from there.
+	 *          Streams closest to running dry are decoded first, prepared
+	 *          streams which aren't playing yet come last.
+	 *          The head of each stream can be kept in memory, so starting
+	 *          a stream is instant and the workers have the length of the head
+	 *          to catch up.
+	 *
+	 *          Thread usage:
+	 *          - prepare() and release() on a control thread, they allocate and wait.
+	 *            release() also waits for a read() of the stream on the audio thread to finish.
+	 *          - start(), stop() and read() on the audio thread, they never block.
+	 *          - Everything else from anywhere.
+	 * @tparam T Sample type
+	 * @tparam Buffer AudioBuffer type the codecs decode to
+	 */
+	template <typename T, class Buffer = AudioBufferTpl<T>>
+	class StreamerTpl {
+	public:
+		using Codec = ICodecTpl<T, Buffer>;
+		using Size = typename Buffer::Size;
+		using Channel = typename Buffer::Channel;
+		using Ring = AudioRingBufferLockFreeTpl<T>;
+
+		struct Options {
+			Size streams = 64;			///< Streams which can be prepared at once
+			Size bufferFrames = 32768;	///< Frames decoded ahead per stream, the prefetch depth
+			Size blockFrames = 4096;	///< Frames decoded per job
+			Size headFrames = 0;		///< Frames kept in memory from the start of each stream
+			unsigned int workers = 2;	///< Worker threads, 0 to call work() manually
+			unsigned int idleMs = 2;	///< How long idle workers sleep before looking for work
+		};
+
+	private:
+		enum class State {
+			Empty,		///< Free slot
+			Loading,	///< prepare() is setting it up
+			Ready,		///< Waiting for start(), gets prefetched
+			Playing,
+			Stopping,	///< Stopped or ended, a worker rewinds it
+			Releasing	///< release() waits for the workers to let go
+		};
+
+		struct Stream {
+			Codec* codec = nullptr;
+			Ring ring;
+			Buffer head;
+			Size headLength = 0;
+			Size played = 0;						///< Only touched by the audio thread
+			std::atomic<State> state = { State::Empty };
+			std::atomic<bool> busy = { false };		///< A worker is decoding it
+			std::atomic<bool> reading = { false };	///< The audio thread is in read()
+			std::atomic<bool> ended = { false };	///< Everything is decoded
+			std::atomic<Size> underruns = { 0 };
+		};
+
+		Options mOptions;
+		HeapBuffer<Stream> mStreams;
+		HeapBuffer<std::thread*> mWorkers;
+		Buffer mScratch;					///< Used by work() without workers
+		std::atomic<bool> mQuit = { false };
+		std::atomic<Size> mUnderruns = { 0 };
+		std::mutex mMutex;
+		std::condition_variable mWake;
+
+		/**
+		 * @brief Rewinds a stopped stream so it can start again
+		 */
+		void rewind(Stream& stream) {
+			stream.ring.reset();
+			const Size length = stream.codec->length();
+			const bool ended = length <= stream.headLength;
+			if (!ended) { stream.codec->scrub(stream.headLength); }
+			stream.ended = ended;
+			// release() might have taken over in the meantime
+			State expected = State::Stopping;
+			stream.state.compare_exchange_strong(expected, State::Ready);
+		}
+
+		/**
+		 * @brief Lower is more urgent, streams about to underrun come first
+		 */
+		Size urgency(const Stream& stream, State state) const {
+			const Size filled = stream.ring.filled();
+			return state == State::Playing ? filled : filled + mOptions.bufferFrames;
+		}
+
+		bool work(Buffer& scratch) {
+			Stream* best = nullptr;
+			Size bestUrgency = 0;
+			for (Size i = 0; i < mStreams.size(); i++) {
+				Stream& stream = mStreams[i];
+				const State state = stream.state;
+				if (stream.busy) { continue; }
+				if (state == State::Stopping) {
+					best = &stream;
+					bestUrgency = 0;
+					break;
+				}
+				if (state != State::Ready && state != State::Playing) { continue; }
+				if (stream.ended) { continue; }
+				if (stream.ring.remaining() < min(mOptions.blockFrames, stream.ring.size())) { continue; }
+				const Size u = urgency(stream, state);
+				if (best == nullptr || u < bestUrgency) {
+					best = &stream;
+					bestUrgency = u;
+				}
+			}
+			if (best == nullptr) { return false; }
+
+			bool expected = false;
+			if (!best->busy.compare_exchange_strong(expected, true)) {
+				return true; // Another worker took it, look again
+			}
+			// The state might have changed in the meantime
+			const State state = best->state;
+			if (state == State::Stopping) {
+				rewind(*best);
+			} else if ((state == State::Ready || state == State::Playing) && !best->ended) {
+				const Size count = min(mOptions.blockFrames, best->ring.remaining());
+				const Size got = best->codec->read(count, scratch);
+				best->ring.push(scratch);
+				// Only flag the end after the last frames are in the ring
+				if (got < count) { best->ended = true; }
+			}
+			best->busy = false;
+			return true;
+		}
+
+		void workerLoop() {
+			Buffer scratch;
+			scratch.resize(mOptions.blockFrames, 2);
+			while (!mQuit) {
+				if (work(scratch)) { continue; }
+				std::unique_lock<std::mutex> lock(mMutex);
+				mWake.wait_for(lock, std::chrono::milliseconds(mOptions.idleMs));
+			}
+		}
+
+		void wake() { mWake.notify_all(); }
+
+		/**
+		 * @brief read() of a stream release() can't reset in the meantime
+		 */
+		Size readPlaying(int id, Stream& stream, Buffer& out, Size frames, Size offsetDst) {
+			TKLB_ASSERT(offsetDst + frames <= out.size())
+			Size done = 0;
+			if (stream.played < stream.headLength) {
+				done = min(frames, stream.headLength - stream.played);
+				out.set(stream.head, done, stream.played, offsetDst);
+			}
+			// Check for the end before popping, otherwise the last frames might get lost
+			const bool ended = stream.ended;
+			done += stream.ring.pop(out, frames - done, offsetDst + done);
+			stream.played += done;
+			if (done < frames) {
+				if (ended && stream.ring.filled() == 0) {
+					stop(id);
+					return done;
+				}
+				out.set(T(0), frames - done, offsetDst + done);
+				stream.underruns++;
+				mUnderruns++;
+				done = frames;
+			}
+			return done;
+		}
+
+	public:
+		StreamerTpl(const Options& options = {}) : mOptions(options) {
+			TKLB_ASSERT(0 < options.blockFrames && 0 < options.bufferFrames)
+			mStreams.resize(options.streams);
+			mScratch.resize(options.blockFrames, 2);
+			mWorkers.resize(options.workers);
+			for (unsigned int i = 0; i < options.workers; i++) {
+				mWorkers[i] = TKLB_NEW_PARAM(std::thread, &StreamerTpl::workerLoop, this)
+			}
+		}
+
+		StreamerTpl(const StreamerTpl&) = delete;
+		StreamerTpl& operator=(const StreamerTpl&) = delete;
+
+		~StreamerTpl() {
+			mQuit = true;
+			wake();
+			for (Size i = 0; i < mWorkers.size(); i++) {
+				mWorkers[i]->join();
+				TKLB_DELETE(std::thread, mWorkers[i])
+			}
+		}
+
+		/**
+		 * @brief Sets up a stream and loads its head. Control thread only.
+		 * @param codec Opened codec, needs to outlive the stream.
+		 *              Only the workers use it until release().
+		 * @return Stream id or -1 if there's no free slot or the codec is empty
+		 */
+		int prepare(Codec& codec) {
+			if (codec.channels() == 0 || codec.length() == 0) { return -1; }
+			for (Size i = 0; i < mStreams.size(); i++) {
+				Stream& stream = mStreams[i];
+				State expected = State::Empty;
+				if (!stream.state.compare_exchange_strong(expected, State::Loading)) { continue; }
+
+				stream.codec = &codec;
+				stream.ring.resize(mOptions.bufferFrames, codec.channels());
+				stream.headLength = 0;
+				stream.played = 0;
+				stream.underruns = 0;
+				codec.scrub(0);
+				if (0 < mOptions.headFrames) {
+					stream.headLength = codec.read(mOptions.headFrames, stream.head);
+				}
+				stream.ended = codec.length() <= stream.headLength;
+				stream.state = State::Ready;
+				wake(); // Start prefetching
+				return int(i);
+			}
+			return -1;
+		}
+
+		/**
+		 * @brief Frees the slot, waits for the worker using it. Control thread only.
+		 */
+		void release(int id) {
+			Stream& stream = mStreams[Size(id)];
+			stream.state = State::Releasing;
+			while (stream.busy || stream.reading) { std::this_thread::yield(); }
+			stream.ring.reset();
+			stream.codec = nullptr;
+			stream.state = State::Empty;
+		}
+
+		/**
+		 * @brief Starts playback from the beginning. Audio thread.
+		 * @return False if the stream isn't ready, e.g. still rewinding after stop()
+		 */
+		bool start(int id) {
+			State expected = State::Ready;
+			return mStreams[Size(id)].state.compare_exchange_strong(expected, State::Playing);
+		}
+
+		/**
+		 * @brief Stops playback, a worker rewinds the stream afterwards. Audio thread.
+		 */
+		void stop(int id) {
+			Stream& stream = mStreams[Size(id)];
+			State expected = State::Playing;
+			if (stream.state.compare_exchange_strong(expected, State::Stopping)) {
+				stream.played = 0;
+			}
+		}
+
+		/**
+		 * @brief Copies the next frames of a playing stream. Audio thread.
+		 * @details Frames the workers didn't manage to decode in time are
+		 *          filled with silence and counted as an underrun, so the
+		 *          stream keeps in time.
+		 * @param out Needs the channels of the stream and offsetDst + frames length
+		 * @return Frames written, less than requested only once the stream ended
+		 */
+		Size read(int id, Buffer& out, Size frames, Size offsetDst = 0) {
+			Stream& stream = mStreams[Size(id)];
+			if (frames == 0) { return 0; }
+			// Flagged before checking the state, release() checks them the other way around
+			stream.reading = true;
+			const Size done = stream.state == State::Playing ? readPlaying(id, stream, out, frames, offsetDst) : 0;
+			stream.reading = false;
+			return done;
+		}
+
+		/**
+		 * @brief Does one decoding job on the calling thread
+		 * @details Only needed without workers, not thread safe with itself
+		 * @return False if there was nothing to do
+		 */
+		bool work() { return work(mScratch); }
+
+		bool isPlaying(int id) const { return mStreams[Size(id)].state == State::Playing; }
+
+		bool isReady(int id) const { return mStreams[Size(id)].state == State::Ready; }
+
+		/**
+		 * @brief Frames which can be read without an underrun
+		 */
+		Size buffered(int id) const {
+			const Stream& stream = mStreams[Size(id)];
+			const Size head = stream.played < stream.headLength ? stream.headLength - stream.played : 0;
+			return head + stream.ring.filled();
+		}
+
+		/**
+		 * @brief Whether the whole stream is decoded or in the buffer
+		 */
+		bool isEnded(int id) const { return mStreams[Size(id)].ended; }
+
+		/**
+		 * @brief Underruns of a stream since prepare()
+		 */
+		Size underruns(int id) const { return mStreams[Size(id)].underruns; }
+
+		/**
+		 * @brief Underruns of all streams
+		 */
+		Size underruns() const { return mUnderruns; }
+
+		const Options& options() const { return mOptions; }
+	};
+
+	// Default type
+	#ifdef TKLB_SAMPLE_FLOAT
+		using Streamer = StreamerTpl<float>;
+	#else
+		using Streamer = StreamerTpl<double>;
+	#endif
+
+} // namespace tklb
+
+#endif // TKLB_NO_STDLIB
+
+#endif // _TKLB_STREAMER
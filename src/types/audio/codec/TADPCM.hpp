@@ -1 +1,671 @@
-// TODO https://github.com/dbry/adpcm-xq
+/**
+ * @file TADPCM.hpp
+ * @author Tobias Kozel
+ * @brief IMA ADPCM in wave files
+ * @details Same block layout as https://github.com/dbry/adpcm-xq
+ *          and the IMA ADPCM wave files most tools produce.
+ * @version 0.1
+ * @date 2023-03-06
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+
+#ifndef _TKLB_ADPCM
+#define _TKLB_ADPCM
+
+#include "./TICodec.hpp"
+#include "../TAudioBuffer.hpp"
+
+namespace tklb { namespace adpcm {
+	using uchar = unsigned char;
+
+	constexpr int StepTab[89] = {
+		7, 8, 9, 10, 11, 12, 13, 14,
+		16, 17, 19, 21, 23, 25, 28, 31,
+		34, 37, 41, 45, 50, 55, 60, 66,
+		73, 80, 88, 97, 107, 118, 130, 143,
+		157, 173, 190, 209, 230, 253, 279, 307,
+		337, 371, 408, 449, 494, 544, 598, 658,
+		724, 796, 876, 963, 1060, 1166, 1282, 1411,
+		1552, 1707, 1878, 2066, 2272, 2499, 2749, 3024,
+		3327, 3660, 4026, 4428, 4871, 5358, 5894, 6484,
+		7132, 7845, 8630, 9493, 10442, 11487, 12635, 13899,
+		15289, 16818, 18500, 20350, 22385, 24623, 27086, 29794,
+		32767
+	};
+
+	constexpr int IndexTab[8] = { -1, -1, -1, -1, 2, 4, 6, 8 };
+
+	/**
+	 * @brief Wave format tag for IMA ADPCM
+	 */
+	constexpr unsigned short FormatTag = 0x11;
+
+	/**
+	 * @brief Size of the per channel header at the start of each block
+	 */
+	constexpr SizeT ChannelHeaderSize = 4;
+
+	/**
+	 * @brief Predictor state of one channel
+	 */
+	struct State {
+		int predictor = 0;
+		int index = 0;
+	};
+
+	/**
+	 * @brief Samples per channel in a block
+	 */
+	constexpr SizeT blockSamples(SizeT blockAlign, SizeT channels) {
+		return (blockAlign - ChannelHeaderSize * channels) * 2 / channels + 1;
+	}
+
+	/**
+	 * @brief Samples per channel in a block cut off after bytes,
+	 *        only whole groups of 4 bytes per channel can be decoded
+	 */
+	constexpr SizeT storedSamples(SizeT bytes, SizeT channels) {
+		return bytes < ChannelHeaderSize * channels ? 0 : blockSamples(
+			ChannelHeaderSize * channels + (bytes - ChannelHeaderSize * channels) / (4 * channels) * 4 * channels,
+			channels
+		);
+	}
+
+	/**
+	 * @brief Block size adpcm-xq uses by default, about 23ms
+	 */
+	constexpr SizeT defaultBlockAlign(SizeT sampleRate, SizeT channels) {
+		return 256 * channels * (sampleRate < 11000 ? 1 : sampleRate / 11000);
+	}
+
+	inline int decodeNibble(State& state, int nibble) {
+		const int step = StepTab[state.index];
+		int delta = step >> 3;
+		if (nibble & 1) { delta += step >> 2; }
+		if (nibble & 2) { delta += step >> 1; }
+		if (nibble & 4) { delta += step; }
+		state.predictor += (nibble & 8) ? -delta : delta;
+		state.predictor = clamp(state.predictor, -32768, 32767);
+		state.index = clamp(state.index + IndexTab[nibble & 7], 0, 88);
+		return state.predictor;
+	}
+
+	/**
+	 * @brief Picks the nibble closest to the sample and advances the state
+	 *        the same way the decoder will
+	 */
+	inline int encodeNibble(State& state, int sample) {
+		const int step = StepTab[state.index];
+		int diff = sample - state.predictor;
+		int nibble = 0;
+		if (diff < 0) {
+			nibble = 8;
+			diff = -diff;
+		}
+		// Round to the closest step instead of truncating
+		diff += step >> 3;
+		int part = step;
+		for (int bit = 4; bit != 0; bit >>= 1) {
+			if (part <= diff) {
+				nibble |= bit;
+				diff -= part;
+			}
+			part >>= 1;
+		}
+		decodeNibble(state, nibble);
+		return nibble;
+	}
+
+	/**
+	 * @brief Step index fitting the average change of the first samples,
+	 *        avoids the slow attack of starting with the smallest step
+	 */
+	inline int initialIndex(const short* samples, SizeT count) {
+		count = min(count, SizeT(16));
+		if (count < 2) { return 0; }
+		int sum = 0;
+		for (SizeT i = 1; i < count; i++) {
+			sum += abs(samples[i] - samples[i - 1]);
+		}
+		const int average = sum / int(count - 1);
+		int index = 0;
+		while (index < 88 && StepTab[index] < average) { index++; }
+		return index;
+	}
+
+	/**
+	 * @brief Reads the channel header at the start of a block
+	 */
+	inline State readHeader(const uchar* block, SizeT channel) {
+		const uchar* header = block + channel * ChannelHeaderSize;
+		State state;
+		state.predictor = static_cast<short>(header[0] | (header[1] << 8));
+		state.index = clamp(int(header[2]), 0, 88);
+		return state;
+	}
+
+	/**
+	 * @brief Decodes a range of one channel in a block.
+	 *        Blocks are independent, so different channels, blocks or voices
+	 *        can be decoded in parallel without sharing any state.
+	 * @param block Start of the block
+	 * @param channels Channels interleaved in the block
+	 * @param channel Channel to decode
+	 * @param state Predictor state after decoding sample start - 1,
+	 *              the block header for start == 0
+	 * @param out Target or nullptr to only advance the state
+	 * @param start First sample to decode within the block
+	 * @param count Samples to decode
+	 */
+	template <typename T>
+	void decodeChannel(
+		const uchar* block, SizeT channels, SizeT channel,
+		State& state, T* out, SizeT start, SizeT count
+	) {
+		constexpr T scale = T(1) / T(32768);
+		SizeT i = start;
+		const SizeT end = start + count;
+		if (i == 0 && i < end) {
+			// The first sample is stored uncompressed in the header
+			state = readHeader(block, channel);
+			if (out != nullptr) { *(out++) = T(state.predictor) * scale; }
+			i++;
+		}
+		// Channels are interleaved in groups of 4 bytes holding 8 samples
+		const uchar* data = block + ChannelHeaderSize * channels + channel * 4;
+		const SizeT stride = 4 * channels;
+		for (; i < end; i++) {
+			const SizeT index = i - 1;
+			const uchar byte = data[(index / 8) * stride + (index % 8) / 2];
+			const int nibble = (index & 1) ? (byte >> 4) : (byte & 0xf);
+			const int sample = decodeNibble(state, nibble);
+			if (out != nullptr) { *(out++) = T(sample) * scale; }
+		}
+	}
+
+	/**
+	 * @brief Decodes a whole block into planar channels
+	 * @param samples Samples per channel to decode, less than
+	 *                blockSamples() for the last block
+	 */
+	template <typename T>
+	void decodeBlock(const void* block, SizeT channels, T** out, SizeT samples) {
+		for (SizeT c = 0; c < channels; c++) {
+			State state;
+			decodeChannel(static_cast<const uchar*>(block), channels, c, state, out[c], 0, samples);
+		}
+	}
+
+	inline unsigned int readU32(const uchar* bytes) {
+		return
+			(unsigned int)(bytes[0]) | ((unsigned int)(bytes[1]) << 8) |
+			((unsigned int)(bytes[2]) << 16) | ((unsigned int)(bytes[3]) << 24);
+	}
+
+	inline unsigned short readU16(const uchar* bytes) {
+		return (unsigned short)(bytes[0] | (bytes[1] << 8));
+	}
+
+	/**
+	 * @brief Compares a four character chunk id
+	 */
+	inline bool isTag(const uchar* bytes, const char* tag) {
+		return
+			bytes[0] == uchar(tag[0]) && bytes[1] == uchar(tag[1]) &&
+			bytes[2] == uchar(tag[2]) && bytes[3] == uchar(tag[3]);
+	}
+
+	inline void writeU32(unsigned int v, uchar* bytes) {
+		for (int i = 0; i < 4; i++) { bytes[i] = (v >> (i * 8)) & 0xff; }
+	}
+
+	inline void writeU16(unsigned short v, uchar* bytes) {
+		bytes[0] = v & 0xff;
+		bytes[1] = (v >> 8) & 0xff;
+	}
+} } // tklb::adpcm
+
+namespace tklb {
+	/**
+	 * @brief Streaming IMA ADPCM encoder/decoder for wave files.
+	 * @details 4 bits per sample, every block starts with the full predictor
+	 *          state so blocks decode independently and scrub() only decodes
+	 *          up to one block to reach the exact position.
+	 *          Decodes straight into the channels of the target buffer,
+	 *          memory is limited to one compressed block and when encoding
+	 *          to one block of pending 16 bit samples.
+	 * @tparam T Sample type
+	 * @tparam Buffer AudioBuffer type
+	 */
+	template <typename T, class Buffer = AudioBufferTpl<T>>
+	class ADPCMCodecTpl : public ICodecTpl<T, Buffer> {
+		using Base = ICodecTpl<T, Buffer>;
+		using uchar = adpcm::uchar;
+	public:
+		using Result = typename Base::Result;
+		using Size = typename Base::Size;
+		using Channel = typename Base::Channel;
+
+		/**
+		 * @brief RIFF, fmt, fact and data chunk headers written by create()
+		 */
+		static constexpr SizeT HeaderSize = 60;
+
+	private:
+		enum class Mode { Closed, Reading, Writing };
+		Mode mMode = Mode::Closed;
+
+		ICodecSource* mSource = nullptr;
+		ICodecSink* mSink = nullptr;
+		const uchar* mData = nullptr;		///< Whole file if the source is in memory
+
+		SizeT mDataOffset = 0;				///< Start of the first block
+		SizeT mDataSize = 0;				///< Size of the data chunk
+		Size mBlockAlign = 0;				///< Bytes per block
+		Size mBlockSamples = 0;				///< Samples per channel in a full block
+
+		Size mLength = 0;
+		Size mSampleRate = 0;
+		Channel mChannels = 0;
+		Size mPosition = 0;
+
+		HeapBuffer<uchar> mBlockBuffer;		///< Compressed block if the source isn't in memory, also used for encoding
+		const uchar* mBlock = nullptr;		///< Current compressed block
+		Size mBlockIndex = 0;
+		Size mBlockLength = 0;				///< Samples per channel in the current block
+		Size mBlockOffset = 0;				///< Samples already decoded from the current block
+		HeapBuffer<adpcm::State> mStates;	///< Per channel state
+
+		HeapBuffer<short> mPending;			///< Planar samples waiting for a full block when encoding
+		Size mPendingCount = 0;
+
+		bool loadBlock(Size index) {
+			const SizeT offset = SizeT(index) * mBlockAlign;
+			if (mDataSize <= offset) { return false; }
+			if (mLength <= index * mBlockSamples) { return false; } // ! More data than the fact chunk says
+			// The last block might be shorter
+			const SizeT available = min(SizeT(mBlockAlign), mDataSize - offset);
+			if (available < adpcm::ChannelHeaderSize * mChannels) { return false; }
+			if (mData != nullptr) {
+				mBlock = mData + mDataOffset + offset;
+			} else {
+				if (!mSource->seek(mDataOffset + offset)) { return false; }
+				if (mSource->read(mBlockBuffer.data(), available) != available) { return false; }
+				mBlock = mBlockBuffer.data();
+			}
+			const Size stored = Size(adpcm::storedSamples(available, mChannels));
+			mBlockLength = min(stored, mLength - index * mBlockSamples);
+			mBlockIndex = index;
+			mBlockOffset = 0;
+			return true;
+		}
+
+		/**
+		 * @brief Encodes the pending samples as a block and writes it to the sink.
+		 *        A short last block is padded with silence, the fact chunk has the real length.
+		 */
+		bool encodeBlock() {
+			uchar* bytes = mBlockBuffer.data();
+			const SizeT channels = mChannels;
+			for (SizeT c = 0; c < channels; c++) {
+				short* samples = mPending.data() + c * mBlockSamples;
+				for (Size i = mPendingCount; i < mBlockSamples; i++) { samples[i] = 0; }
+				adpcm::State& state = mStates[Size(c)];
+				if (mLength <= mBlockSamples) {
+					state.index = adpcm::initialIndex(samples, mPendingCount);
+				}
+				// The first sample is stored as is, the step index carries over
+				state.predictor = samples[0];
+				uchar* header = bytes + c * adpcm::ChannelHeaderSize;
+				adpcm::writeU16((unsigned short) samples[0], header);
+				header[2] = uchar(state.index);
+				header[3] = 0;
+
+				uchar* data = bytes + adpcm::ChannelHeaderSize * channels + c * 4;
+				for (Size i = 1; i < mBlockSamples; i += 8) {
+					uchar* group = data + ((i - 1) / 8) * 4 * channels;
+					for (int j = 0; j < 8; j += 2) {
+						const int low = adpcm::encodeNibble(state, samples[i + j]);
+						const int high = adpcm::encodeNibble(state, samples[i + j + 1]);
+						group[j / 2] = uchar(low | (high << 4));
+					}
+				}
+			}
+			mPendingCount = 0;
+			return mSink->write(bytes, mBlockAlign) == mBlockAlign;
+		}
+
+		bool writeFileHeader() {
+			uchar header[HeaderSize];
+			const unsigned int blocks = mLength == 0 ? 0 : (mLength - 1) / mBlockSamples + 1;
+			memory::copy(header, "RIFF", 4);
+			adpcm::writeU32((unsigned int)(HeaderSize - 8 + blocks * mBlockAlign), header + 4);
+			memory::copy(header + 8, "WAVEfmt ", 8);
+			adpcm::writeU32(20, header + 16);
+			adpcm::writeU16(adpcm::FormatTag, header + 20);
+			adpcm::writeU16((unsigned short) mChannels, header + 22);
+			adpcm::writeU32(mSampleRate, header + 24);
+			adpcm::writeU32(mSampleRate * mBlockAlign / mBlockSamples, header + 28);
+			adpcm::writeU16((unsigned short) mBlockAlign, header + 32);
+			adpcm::writeU16(4, header + 34);	// bits per sample
+			adpcm::writeU16(2, header + 36);	// extra size
+			adpcm::writeU16((unsigned short) mBlockSamples, header + 38);
+			memory::copy(header + 40, "fact", 4);
+			adpcm::writeU32(4, header + 44);
+			adpcm::writeU32(mLength, header + 48);
+			memory::copy(header + 52, "data", 4);
+			adpcm::writeU32(blocks * mBlockAlign, header + 56);
+			return mSink->write(header, HeaderSize) == HeaderSize;
+		}
+
+		/**
+		 * @brief Walks the RIFF chunks to find the format and the audio data
+		 */
+		Result parseHeader(ICodecSource& source) {
+			uchar chunk[12];
+			if (!source.seek(0) || source.read(chunk, 12) != 12) { return Result::InvalidFormat; }
+			if (!adpcm::isTag(chunk, "RIFF") || !adpcm::isTag(chunk + 8, "WAVE")) {
+				return Result::InvalidFormat;
+			}
+			bool format = false, fact = false;
+			SizeT position = 12;
+			while (source.read(chunk, 8) == 8) {
+				const SizeT size = adpcm::readU32(chunk + 4);
+				position += 8;
+				if (adpcm::isTag(chunk, "fmt ")) {
+					uchar fmt[20];
+					if (size < 20 || source.read(fmt, 20) != 20) { return Result::InvalidFormat; }
+					if (adpcm::readU16(fmt) != adpcm::FormatTag || adpcm::readU16(fmt + 14) != 4) {
+						return Result::InvalidFormat; // ! Only 4 bit IMA ADPCM
+					}
+					mChannels = Channel(adpcm::readU16(fmt + 2));
+					mSampleRate = Size(adpcm::readU32(fmt + 4));
+					mBlockAlign = Size(adpcm::readU16(fmt + 12));
+					mBlockSamples = Size(adpcm::readU16(fmt + 18));
+					if (
+						mChannels == 0 || mSampleRate == 0 ||
+						mBlockAlign <= adpcm::ChannelHeaderSize * mChannels ||
+						mBlockAlign % (4 * mChannels) != 0 ||
+						mBlockSamples != adpcm::blockSamples(mBlockAlign, mChannels)
+					) {
+						return Result::InvalidFormat;
+					}
+					format = true;
+				} else if (adpcm::isTag(chunk, "fact") && 4 <= size) {
+					uchar samples[4];
+					if (source.read(samples, 4) != 4) { return Result::InvalidFormat; }
+					mLength = Size(adpcm::readU32(samples));
+					fact = true;
+				} else if (adpcm::isTag(chunk, "data")) {
+					if (!format) { return Result::InvalidFormat; }
+					mDataOffset = position;
+					mDataSize = size;
+					if (source.size() != 0) {
+						mDataSize = min(mDataSize, source.size() - position);
+					}
+					if (!fact) {
+						// Without a fact chunk the padding of the last block is decoded too
+						const SizeT full = mDataSize / mBlockAlign;
+						const SizeT rest = mDataSize % mBlockAlign;
+						mLength = Size(full * mBlockSamples);
+						if (adpcm::ChannelHeaderSize * mChannels < rest) {
+							mLength += Size(adpcm::storedSamples(rest, mChannels));
+						}
+					}
+					return Result::Success;
+				}
+				// Chunks are padded to an even size
+				position += size + (size & 1);
+				if (!source.seek(position)) { break; }
+			}
+			return Result::InvalidFormat;
+		}
+
+	public:
+		ADPCMCodecTpl() = default;
+		ADPCMCodecTpl(const ADPCMCodecTpl&) = delete;
+		ADPCMCodecTpl& operator=(const ADPCMCodecTpl&) = delete;
+
+		~ADPCMCodecTpl() { close(); }
+
+		Result open(ICodecSource& source) override {
+			close();
+			mLength = 0;
+			const Result result = parseHeader(source);
+			if (result != Result::Success) { return result; }
+			if (mLength == 0) { return Result::InvalidFormat; }
+
+			mSource = &source;
+			mData = static_cast<const uchar*>(source.data());
+			if (mData == nullptr) {
+				if (!mBlockBuffer.resize(mBlockAlign)) { return Result::GenericError; }
+			}
+			if (!mStates.resize(mChannels)) { return Result::GenericError; }
+			mMode = Mode::Reading;
+			mPosition = 0;
+			if (!loadBlock(0)) {
+				close();
+				return Result::InvalidFormat;
+			}
+			return Result::Success;
+		}
+
+		Result create(ICodecSink& sink, Size sampleRate, Channel channels) override {
+			return create(sink, sampleRate, channels, Size(adpcm::defaultBlockAlign(sampleRate, channels)));
+		}
+
+		/**
+		 * @brief Start encoding with a custom block size
+		 * @param blockAlign Bytes per block, multiple of 4 * channels.
+		 *                   Smaller blocks allow faster scrubbing but add overhead.
+		 */
+		Result create(ICodecSink& sink, Size sampleRate, Channel channels, Size blockAlign) {
+			close();
+			if (channels == 0 || sampleRate == 0) { return Result::InvalidFormat; }
+			if (blockAlign <= adpcm::ChannelHeaderSize * channels || blockAlign % (4 * channels) != 0) {
+				return Result::InvalidFormat;
+			}
+			if (0xffff < blockAlign) { return Result::InvalidFormat; }
+			mSink = &sink;
+			mChannels = channels;
+			mSampleRate = sampleRate;
+			mBlockAlign = blockAlign;
+			mBlockSamples = Size(adpcm::blockSamples(blockAlign, channels));
+			mLength = 0;
+			mPendingCount = 0;
+			if (!mPending.resize(mBlockSamples * channels)) { return Result::GenericError; }
+			if (!mBlockBuffer.resize(blockAlign)) { return Result::GenericError; }
+			if (!mStates.resize(channels)) { return Result::GenericError; }
+			for (Channel c = 0; c < channels; c++) { mStates[c] = adpcm::State(); }
+			// The sizes are only known when closing
+			if (!writeFileHeader()) { return Result::GenericError; }
+			mMode = Mode::Writing;
+			return Result::Success;
+		}
+
+		Result close() override {
+			Result result = Result::Success;
+			if (mMode == Mode::Writing) {
+				if (0 < mPendingCount && !encodeBlock()) {
+					result = Result::GenericError;
+				}
+				const SizeT end = mSink->tell();
+				if (!mSink->seek(0) || !writeFileHeader() || !mSink->seek(end)) {
+					result = Result::GenericError;
+				}
+				mPending.resize(0);
+			}
+			mMode = Mode::Closed;
+			mSource = nullptr;
+			mSink = nullptr;
+			mData = nullptr;
+			mBlock = nullptr;
+			mBlockBuffer.resize(0);
+			return result;
+		}
+
+		Result readAll(Buffer& result) override {
+			if (mMode != Mode::Reading) { return Result::NotOpen; }
+			const Size remaining = mLength - mPosition;
+			if (remaining == 0) {
+				result.setValidSize(0);
+				return Result::Success;
+			}
+			return read(remaining, result) == remaining ? Result::Success : Result::GenericError;
+		}
+
+		Size read(Size count, Buffer& result) override {
+			if (mMode != Mode::Reading) { return 0; }
+			if (result.size() < count || result.channels() != mChannels) {
+				result.resize(count, mChannels);
+			}
+			result.sampleRate = typename Buffer::SampleRate(mSampleRate);
+			Size done = 0;
+			while (done < count) {
+				if (mBlockOffset == mBlockLength) {
+					if (!loadBlock(mBlockIndex + 1)) { break; } // ! End of stream
+				}
+				const Size chunk = min(count - done, mBlockLength - mBlockOffset);
+				for (Channel c = 0; c < mChannels; c++) {
+					adpcm::decodeChannel(
+						mBlock, mChannels, c, mStates[c],
+						result[c] + done, mBlockOffset, chunk
+					);
+				}
+				mBlockOffset += chunk;
+				done += chunk;
+			}
+			mPosition += done;
+			result.setValidSize(done);
+			return done;
+		}
+
+		Result write(const Buffer& audio) override {
+			if (mMode != Mode::Writing) { return Result::NotOpen; }
+			TKLB_ASSERT(audio.channels() == mChannels)
+			const Size frames = audio.validSize();
+			Size done = 0;
+			while (done < frames) {
+				const Size chunk = min(frames - done, mBlockSamples - mPendingCount);
+				for (Channel c = 0; c < mChannels; c++) {
+					const T* in = audio[c] + done;
+					short* out = mPending.data() + c * mBlockSamples + mPendingCount;
+					for (Size i = 0; i < chunk; i++) {
+						out[i] = short(clamp(int(in[i] * T(32767)), -32768, 32767));
+					}
+				}
+				mPendingCount += chunk;
+				mLength += chunk;
+				done += chunk;
+				if (mPendingCount == mBlockSamples && !encodeBlock()) {
+					return Result::GenericError;
+				}
+			}
+			return Result::Success;
+		}
+
+		Result scrub(Size index) override {
+			if (mMode != Mode::Reading) { return Result::NotOpen; }
+			if (mLength < index) { return Result::OutOfRange; }
+			const Size block = index / mBlockSamples;
+			if (index == mLength && index % mBlockSamples == 0) {
+				// Exactly at the end, there's no block to load
+				if (!loadBlock(block - 1)) { return Result::GenericError; }
+				mBlockOffset = mBlockLength;
+				mPosition = index;
+				return Result::Success;
+			}
+			if (!loadBlock(block)) { return Result::GenericError; }
+			// Only the block start has the full state, decode up to the position
+			const Size skip = index - block * mBlockSamples;
+			if (mBlockLength < skip) { return Result::GenericError; } // ! Block is cut off
+			for (Channel c = 0; c < mChannels; c++) {
+				adpcm::decodeChannel<T>(mBlock, mChannels, c, mStates[c], nullptr, 0, skip);
+			}
+			mBlockOffset = skip;
+			mPosition = index;
+			return Result::Success;
+		}
+
+		Size length() const override { return mLength; }
+
+		Size position() const override {
+			return mMode == Mode::Writing ? mLength : mPosition;
+		}
+
+		Size sampleRate() const override { return mMode == Mode::Closed ? 0 : mSampleRate; }
+
+		Channel channels() const override { return mMode == Mode::Closed ? 0 : mChannels; }
+
+		/**
+		 * @brief Bytes per block
+		 */
+		Size blockAlign() const { return mBlockAlign; }
+
+		/**
+		 * @brief Samples per channel in a block
+		 */
+		Size blockSamples() const { return mBlockSamples; }
+	};
+
+	// Default type
+	#ifdef TKLB_SAMPLE_FLOAT
+		using ADPCMCodec = ADPCMCodecTpl<float>;
+	#else
+		using ADPCMCodec = ADPCMCodecTpl<double>;
+	#endif
+
+	namespace adpcm {
+		/**
+		 * @brief Decode a whole IMA ADPCM wave file from any source
+		 * @param source Source to decode, e.g. a FileSource
+		 * @param out The buffer to store the result in
+		 */
+		template <typename T, class Buffer = AudioBufferTpl<T>>
+		bool load(ICodecSource& source, Buffer& out) {
+			using Codec = ADPCMCodecTpl<T, Buffer>;
+			Codec codec;
+			if (codec.open(source) != Codec::Result::Success) {
+				return false;
+			}
+			return codec.readAll(out) == Codec::Result::Success;
+		}
+
+		/**
+		 * @brief Decode an IMA ADPCM wave file from memory
+		 * @param data The wave file buffer
+		 * @param length The length of the wave file buffer
+		 * @param out The buffer to store the result in
+		 */
+		template <typename T, class Buffer = AudioBufferTpl<T>>
+		bool load(const char* data, typename Buffer::Size length, Buffer& out) {
+			MemorySource source(data, length);
+			return load<T, Buffer>(source, out);
+		}
+
+		/**
+		 * @brief Encode a buffer to an IMA ADPCM wave file in memory
+		 * @param in The audio to encode, needs the samplerate set
+		 * @param out Buffer to write the wave file to
+		 */
+		template <typename T, class Buffer = AudioBufferTpl<T>>
+		bool write(const Buffer& in, HeapBuffer<char>& out) {
+			using Codec = ADPCMCodecTpl<T, Buffer>;
+			out.resize(0);
+			HeapBufferSink sink(out);
+			Codec codec;
+			if (codec.create(sink, in.sampleRate, in.channels()) != Codec::Result::Success) {
+				return false;
+			}
+			if (codec.write(in) != Codec::Result::Success) {
+				codec.close();
+				return false;
+			}
+			return codec.close() == Codec::Result::Success;
+		}
+	} // namespace adpcm
+} // namespace tklb
+
+#endif // _TKLB_ADPCM
@@ -0,0 +1,83 @@
+#ifndef _TKLB_FILE_SOURCE
+#define _TKLB_FILE_SOURCE
+
+#include "./TICodec.hpp"
+#include "../../TFile.hpp"
+
+#ifndef TKLB_NO_STDLIB
+
+namespace tklb {
+	/**
+	 * @brief Codec source reading from a file.
+	 *        Maps the file if possible so codecs can decode straight from
+	 *        the page cache without a copy, otherwise streams it.
+	 */
+	class FileSource : public ICodecSource {
+		MappedFile mMapped;
+		FileStream mStream;
+		SizeT mPosition = 0;
+
+	public:
+		FileSource() = default;
+
+		/**
+		 * @param map Set to false to always stream, e.g. for files on network drives
+		 */
+		FileSource(const char* path, bool map = true) { open(path, map); }
+
+		/**
+		 * @brief Opens the file
+		 * @param map Try mapping the file first
+		 * @return False if the file can't be opened at all
+		 */
+		bool open(const char* path, bool map = true) {
+			close();
+			if (map && mMapped.open(path)) { return true; }
+			return mStream.open(path);
+		}
+
+		void close() {
+			mMapped.close();
+			mStream.close();
+			mPosition = 0;
+		}
+
+		bool isOpen() const { return mMapped.isOpen() || mStream.isOpen(); }
+
+		bool isMapped() const { return mMapped.isOpen(); }
+
+		/**
+		 * @brief The mapping, can be used to prefetch ranges
+		 */
+		const MappedFile& mapped() const { return mMapped; }
+
+		SizeT read(void* data, SizeT bytes) override {
+			if (!mMapped.isOpen()) { return mStream.read(data, bytes); }
+			bytes = min(bytes, mMapped.size() - mPosition);
+			memory::copy(data, mMapped.data() + mPosition, bytes);
+			mPosition += bytes;
+			return bytes;
+		}
+
+		bool seek(SizeT position) override {
+			if (!mMapped.isOpen()) { return mStream.seek(position); }
+			if (mMapped.size() < position) { return false; }
+			mPosition = position;
+			return true;
+		}
+
+		SizeT tell() const override {
+			return mMapped.isOpen() ? mPosition : mStream.tell();
+		}
+
+		SizeT size() const override {
+			return mMapped.isOpen() ? mMapped.size() : mStream.size();
+		}
+
+		const void* data() const override { return mMapped.data(); }
+	};
+} // namespace tklb
+
+#endif // TKLB_NO_STDLIB
+
+#endif // _TKLB_FILE_SOURCE
@@ -5,54 +5,217 @@
 #include "../TAudioBuffer.hpp"
 
 namespace tklb {
+	/**
+	 * @brief Byte stream a codec decodes from.
+	 *        Lets codecs pull data in small pieces instead of
+	 *        needing the whole file in memory.
+	 */
+	struct ICodecSource {
+		virtual ~ICodecSource() = default;
+
+		/**
+		 * @brief Read bytes from the current position
+		 * @return Bytes actually read, less than requested at the end
+		 */
+		virtual SizeT read(void* data, SizeT bytes) = 0;
+
+		/**
+		 * @brief Move to an absolute position
+		 * @return False if the position is out of range
+		 */
+		virtual bool seek(SizeT position) = 0;
+
+		/**
+		 * @brief Current position in bytes
+		 */
+		virtual SizeT tell() const = 0;
+
+		/**
+		 * @brief Total size in bytes, 0 if unknown
+		 */
+		virtual SizeT size() const { return 0; }
+
+		/**
+		 * @brief The whole stream if it's already in memory.
+		 *        Codecs which need random access can avoid a copy with it.
+		 */
+		virtual const void* data() const { return nullptr; }
+	};
+
+	/**
+	 * @brief Byte stream a codec encodes to.
+	 *        Needs to be seekable since most formats update
+	 *        their header once the length is known.
+	 */
+	struct ICodecSink {
+		virtual ~ICodecSink() = default;
+
+		/**
+		 * @brief Write bytes at the current position
+		 * @return Bytes actually written
+		 */
+		virtual SizeT write(const void* data, SizeT bytes) = 0;
+
+		/**
+		 * @brief Move to an absolute position
+		 */
+		virtual bool seek(SizeT position) = 0;
+
+		/**
+		 * @brief Current position in bytes
+		 */
+		virtual SizeT tell() const = 0;
+	};
+
+	/**
+	 * @brief Reads from borrowed memory
+	 */
+	class MemorySource : public ICodecSource {
+		const unsigned char* mData = nullptr;
+		SizeT mSize = 0;
+		SizeT mPosition = 0;
+	public:
+		MemorySource(const void* data, SizeT size) :
+			mData(static_cast<const unsigned char*>(data)), mSize(size) { }
+
+		SizeT read(void* data, SizeT bytes) override {
+			bytes = min(bytes, mSize - mPosition);
+			memory::copy(data, mData + mPosition, bytes);
+			mPosition += bytes;
+			return bytes;
+		}
+
+		bool seek(SizeT position) override {
+			if (mSize < position) { return false; }
+			mPosition = position;
+			return true;
+		}
+
+		SizeT tell() const override { return mPosition; }
+
+		SizeT size() const override { return mSize; }
+
+		const void* data() const override { return mData; }
+	};
+
+	/**
+	 * @brief Writes into a HeapBuffer which grows as needed
+	 */
+	class HeapBufferSink : public ICodecSink {
+		using Buffer = HeapBuffer<char>;
+		using Size = Buffer::Size;
+		Buffer& mBuffer;
+		SizeT mPosition = 0;
+	public:
+		HeapBufferSink(Buffer& buffer) : mBuffer(buffer) { }
+
+		SizeT write(const void* data, SizeT bytes) override {
+			const Size end = Size(mPosition + bytes);
+			if (mBuffer.size() < end) {
+				// Grow geometrically, encoders tend to write in small pieces
+				const SizeT capacity = mBuffer.allocated();
+				if (capacity < end) {
+					const Size grow = Size(max(SizeT(end), capacity * 2));
+					if (!mBuffer.reserve(Buffer::closestChunkSize(grow, Buffer::ChunkSize))) {
+						return 0; // ! Allocation failed
+					}
+				}
+				mBuffer.resize(end, false);
+			}
+			memory::copy(mBuffer.data() + mPosition, data, bytes);
+			mPosition = end;
+			return bytes;
+		}
+
+		bool seek(SizeT position) override {
+			if (mBuffer.size() < position) { return false; }
+			mPosition = position;
+			return true;
+		}
+
+		SizeT tell() const override { return mPosition; }
+	};
+
+	/**
+	 * @brief Common interface for streaming audio codecs.
+	 *        A codec is either opened for decoding with open()
+	 *        or for encoding with create(), reading and writing
+	 *        happen in blocks to keep the memory usage bounded.
+	 * @tparam T Sample type
+	 * @tparam Buffer AudioBuffer type
+	 */
 	template <typename T, class Buffer = AudioBufferTpl<T>>
 	struct ICodecTpl {
-		using Size = HeapBuffer<>::Size;
+		using Size = typename Buffer::Size;
+		using Channel = typename Buffer::Channel;
+
 		enum class Result {
 			Success = 0,
 			GenericError,
-			NotImplemented
-			// TODO
+			NotImplemented,
+			InvalidFormat,	///< Source couldn't be parsed or options aren't supported
+			NotOpen,		///< Not opened in the mode needed for the call
+			OutOfRange		///< Seeking past the end
 		};
 
+		virtual ~ICodecTpl() = default;
+
 		/**
-		 * @brief TODO
-		 *
-		 * @param path
-		 * @return Result
+		 * @brief Start decoding from the source.
+		 *        The source needs to outlive the codec or the next close().
 		 */
-		virtual Result open(const void* file) = 0;
+		virtual Result open(ICodecSource& source) = 0;
 
 		/**
-		 * @brief TODO
-		 *
-		 * @return Result
+		 * @brief Start encoding to the sink.
+		 *        The sink needs to outlive the codec or the next close().
 		 */
-		virtual Result readAll() = 0;
+		virtual Result create(ICodecSink& sink, Size sampleRate, Channel channels) = 0;
 
 		/**
-		 * @brief TODO
-		 *
-		 * @param count
-		 * @return Size
+		 * @brief Finishes encoding and releases the source or sink
+		 */
+		virtual Result close() = 0;
+
+		/**
+		 * @brief Decodes everything from the current position
+		 * @param result Resized to fit the remaining audio
+		 */
+		virtual Result readAll(Buffer& result) = 0;
+
+		/**
+		 * @brief Decodes the next frames
+		 * @param count Frames to decode
+		 * @param result Will be resized if it is too short or has the wrong channel count.
+		 *               The validSize is set to the number of frames decoded.
+		 * @return Frames decoded, less than count at the end of the stream
 		 */
 		virtual Size read(Size count, Buffer& result) = 0;
 
 		/**
-		 * @brief TODO
-		 *
-		 * @param audio
-		 * @return Size
+		 * @brief Encodes the valid part of the buffer
 		 */
 		virtual Result write(const Buffer& audio) = 0;
 
 		/**
-		 * @brief TODO
-		 *
-		 * @param index
-		 * @return Result
+		 * @brief Sample accurate seek for decoding
+		 * @param index Frame to continue decoding from
 		 */
 		virtual Result scrub(Size index) = 0;
+
+		/**
+		 * @brief Total frames in the stream or frames written so far
+		 */
+		virtual Size length() const = 0;
+
+		/**
+		 * @brief The frame read() will decode next
+		 */
+		virtual Size position() const = 0;
+
+		virtual Size sampleRate() const = 0;
+
+		virtual Channel channels() const = 0;
 	};
 } // tklb
 
@@ -0,0 +1,572 @@
+/**
+ * @file TQoa.hpp
+ * @author Tobias Kozel
+ * @brief Quite OK Audio codec
+ * @details Format, tables and the lms filter are taken from the reference
+ *          implementation by Dominic Szablewski, MIT licensed.
+ *          https://github.com/phoboslab/qoa
+ *          The slice loops are reimplemented to work on planar audio and
+ *          to be able to stop in the middle of a frame, qoa.h is only
+ *          used for its types and constants.
+ * @version 0.1
+ * @date 2023-03-02
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+
+#ifndef _TKLB_QOA
+#define _TKLB_QOA
+
+#include "./TICodec.hpp"
+#include "../TAudioBuffer.hpp"
+
+#define QOA_NO_STDIO
+#include "../../../../external/qoa/qoa.h"
+
+namespace tklb { namespace qoa {
+	using uint64 = unsigned long long;
+
+	/**
+	 * @brief Frame size for all but the last frame
+	 */
+	constexpr SizeT fullFrameSize(SizeT channels) {
+		return QOA_FRAME_SIZE(channels, QOA_SLICES_PER_FRAME);
+	}
+
+	constexpr int QuantTab[17] = {
+		7, 7, 7, 5, 5, 3, 3, 1, /* -8..-1 */
+		0,                      /*  0     */
+		0, 2, 2, 4, 4, 6, 6, 6  /*  1.. 8 */
+	};
+
+	constexpr int ReciprocalTab[16] = {
+		65536, 9363, 3121, 1457, 781, 475, 311, 216, 156, 117, 90, 71, 57, 47, 39, 32
+	};
+
+	constexpr int DequantTab[16][8] = {
+		{   1,    -1,    3,    -3,    5,    -5,     7,     -7},
+		{   5,    -5,   18,   -18,   32,   -32,    49,    -49},
+		{  16,   -16,   53,   -53,   95,   -95,   147,   -147},
+		{  34,   -34,  113,  -113,  203,  -203,   315,   -315},
+		{  63,   -63,  210,  -210,  378,  -378,   588,   -588},
+		{ 104,  -104,  345,  -345,  621,  -621,   966,   -966},
+		{ 158,  -158,  528,  -528,  950,  -950,  1477,  -1477},
+		{ 228,  -228,  760,  -760, 1368, -1368,  2128,  -2128},
+		{ 316,  -316, 1053, -1053, 1895, -1895,  2947,  -2947},
+		{ 422,  -422, 1405, -1405, 2529, -2529,  3934,  -3934},
+		{ 548,  -548, 1828, -1828, 3290, -3290,  5117,  -5117},
+		{ 696,  -696, 2320, -2320, 4176, -4176,  6496,  -6496},
+		{ 868,  -868, 2893, -2893, 5207, -5207,  8099,  -8099},
+		{1064, -1064, 3548, -3548, 6386, -6386,  9933,  -9933},
+		{1286, -1286, 4288, -4288, 7718, -7718, 12005, -12005},
+		{1536, -1536, 5120, -5120, 9216, -9216, 14336, -14336},
+	};
+
+	inline int predict(const qoa_lms_t& lms) {
+		int prediction = 0;
+		for (int i = 0; i < QOA_LMS_LEN; i++) {
+			prediction += lms.weights[i] * lms.history[i];
+		}
+		return prediction >> 13;
+	}
+
+	inline void update(qoa_lms_t& lms, int sample, int residual) {
+		const int delta = residual >> 4;
+		for (int i = 0; i < QOA_LMS_LEN; i++) {
+			lms.weights[i] += lms.history[i] < 0 ? -delta : delta;
+		}
+		for (int i = 0; i < QOA_LMS_LEN - 1; i++) {
+			lms.history[i] = lms.history[i + 1];
+		}
+		lms.history[QOA_LMS_LEN - 1] = sample;
+	}
+
+	/**
+	 * @brief Rounding division which avoids rounding to 0
+	 */
+	inline int div(int v, int scalefactor) {
+		const int reciprocal = ReciprocalTab[scalefactor];
+		int n = (v * reciprocal + (1 << 15)) >> 16;
+		n = n + ((v > 0) - (v < 0)) - ((n > 0) - (n < 0)); // round away from 0
+		return n;
+	}
+
+	inline int clampS16(int v) {
+		if ((unsigned int)(v + 32768) > 65535) {
+			if (v < -32768) { return -32768; }
+			if (v >  32767) { return  32767; }
+		}
+		return v;
+	}
+
+	inline uint64 readU64(const unsigned char* bytes) {
+		return
+			(uint64(bytes[0]) << 56) | (uint64(bytes[1]) << 48) |
+			(uint64(bytes[2]) << 40) | (uint64(bytes[3]) << 32) |
+			(uint64(bytes[4]) << 24) | (uint64(bytes[5]) << 16) |
+			(uint64(bytes[6]) <<  8) | (uint64(bytes[7]) <<  0);
+	}
+
+	inline void writeU64(uint64 v, unsigned char* bytes) {
+		for (int i = 0; i < 8; i++) {
+			bytes[i] = (v >> (56 - i * 8)) & 0xff;
+		}
+	}
+} } // tklb::qoa
+
+namespace tklb {
+	/**
+	 * @brief Streaming QOA encoder/decoder.
+	 * @details Decodes slice by slice straight into the channels of the
+	 *          target buffer. All frames but the last have the same size,
+	 *          so scrub() can jump to a frame and only decodes up to
+	 *          20 * 256 samples to reach the exact position.
+	 *          Memory is limited to one compressed frame and when encoding
+	 *          to one frame of pending 16 bit samples.
+	 * @tparam T Sample type
+	 * @tparam Buffer AudioBuffer type
+	 */
+	template <typename T, class Buffer = AudioBufferTpl<T>>
+	class QoaCodecTpl : public ICodecTpl<T, Buffer> {
+		using Base = ICodecTpl<T, Buffer>;
+		using uint64 = qoa::uint64;
+		using uchar = unsigned char;
+	public:
+		using Result = typename Base::Result;
+		using Size = typename Base::Size;
+		using Channel = typename Base::Channel;
+
+		static constexpr Size FrameLength = QOA_FRAME_LEN;
+		static constexpr Channel MaxChannels = QOA_MAX_CHANNELS;
+
+	private:
+		enum class Mode { Closed, Reading, Writing };
+		Mode mMode = Mode::Closed;
+
+		ICodecSource* mSource = nullptr;
+		ICodecSink* mSink = nullptr;
+		const uchar* mData = nullptr;		///< Whole file if the source is in memory
+		SizeT mDataSize = 0;
+
+		Size mLength = 0;
+		Size mSampleRate = 0;
+		Channel mChannels = 0;
+		Size mPosition = 0;
+
+		HeapBuffer<uchar> mFrameBuffer;		///< Compressed frame if the source isn't in memory, also used for encoding
+		const uchar* mFrame = nullptr;		///< Current compressed frame
+		Size mFrameIndex = 0;
+		Size mFrameSamples = 0;				///< Samples per channel in the current frame
+		Size mFrameOffset = 0;				///< Samples already decoded from the current frame
+
+		qoa_lms_t mLms[MaxChannels];
+		uint64 mSlice[MaxChannels];			///< Remaining residuals of the current slice per channel
+		int mScaleFactor[MaxChannels];
+
+		HeapBuffer<short> mPending;			///< Planar samples waiting for a full frame when encoding
+		Size mPendingCount = 0;
+
+		/**
+		 * @brief Reads the frame header and lms state
+		 */
+		bool loadFrame(Size index) {
+			const SizeT offset = 8 + SizeT(index) * qoa::fullFrameSize(mChannels);
+			SizeT available = 0;
+			if (mData != nullptr) {
+				if (mDataSize <= offset) { return false; }
+				mFrame = mData + offset;
+				available = mDataSize - offset;
+			} else {
+				if (!mSource->seek(offset)) { return false; }
+				available = mSource->read(mFrameBuffer.data(), mFrameBuffer.size());
+				mFrame = mFrameBuffer.data();
+			}
+			if (available < 8 + QOA_LMS_LEN * 4 * SizeT(mChannels)) { return false; }
+
+			const uint64 header = qoa::readU64(mFrame);
+			const Size channels = (header >> 56) & 0x0000ff;
+			const Size rate = (header >> 32) & 0xffffff;
+			const Size samples = (header >> 16) & 0x00ffff;
+			const Size size = (header) & 0x00ffff;
+			const Size start = 8 + QOA_LMS_LEN * 4 * mChannels;	// Header and lms state before the slices
+			if (channels != mChannels || rate != mSampleRate || size < start || available < size) {
+				return false; // ! Corrupt or streaming file with changing format
+			}
+			const Size slices = (size - start) / 8;
+			if (slices < ((samples + QOA_SLICE_LEN - 1) / QOA_SLICE_LEN) * channels) {
+				return false; // ! Corrupt, not enough slices for every channel
+			}
+
+			for (Channel c = 0; c < mChannels; c++) {
+				uint64 history = qoa::readU64(mFrame + 8 + c * 16);
+				uint64 weights = qoa::readU64(mFrame + 16 + c * 16);
+				for (int i = 0; i < QOA_LMS_LEN; i++) {
+					mLms[c].history[i] = static_cast<signed short>(history >> 48);
+					history <<= 16;
+					mLms[c].weights[i] = static_cast<signed short>(weights >> 48);
+					weights <<= 16;
+				}
+			}
+			mFrameIndex = index;
+			mFrameSamples = samples;
+			mFrameOffset = 0;
+			return true;
+		}
+
+		/**
+		 * @brief Decodes a range of the current frame for one channel
+		 * @param out Target or nullptr to only advance the filter
+		 */
+		void decodeChannel(Channel c, T* out, Size start, Size count) {
+			const uchar* slices = mFrame + 8 + QOA_LMS_LEN * 4 * mChannels;
+			constexpr T scale = T(1) / T(32768);
+			qoa_lms_t& lms = mLms[c];
+			uint64 slice = mSlice[c];
+			int scalefactor = mScaleFactor[c];
+			for (Size i = start; i < start + count; i++) {
+				if (i % QOA_SLICE_LEN == 0) {
+					slice = qoa::readU64(slices + ((i / QOA_SLICE_LEN) * mChannels + c) * 8);
+					scalefactor = (slice >> 60) & 0xf;
+				}
+				const int predicted = qoa::predict(lms);
+				const int quantized = (slice >> 57) & 0x7;
+				const int dequantized = qoa::DequantTab[scalefactor][quantized];
+				const int reconstructed = qoa::clampS16(predicted + dequantized);
+				slice <<= 3;
+				qoa::update(lms, reconstructed, dequantized);
+				if (out != nullptr) {
+					out[i - start] = T(reconstructed) * scale;
+				}
+			}
+			mSlice[c] = slice;
+			mScaleFactor[c] = scalefactor;
+		}
+
+		/**
+		 * @brief Encodes the pending samples as a frame and writes it to the sink
+		 */
+		bool encodeFrame() {
+			const Size frameLength = mPendingCount;
+			const Size slices = (frameLength + QOA_SLICE_LEN - 1) / QOA_SLICE_LEN;
+			const Size frameSize = QOA_FRAME_SIZE(mChannels, slices);
+			uchar* bytes = mFrameBuffer.data();
+
+			qoa::writeU64(
+				uint64(mChannels) << 56 | uint64(mSampleRate) << 32 |
+				uint64(frameLength) << 16 | uint64(frameSize),
+				bytes
+			);
+			bytes += 8;
+
+			for (Channel c = 0; c < mChannels; c++) {
+				qoa_lms_t& lms = mLms[c];
+				// Reset weights which grew too large, prevents clicks with some high frequency content
+				const int weightsSum =
+					lms.weights[0] * lms.weights[0] + lms.weights[1] * lms.weights[1] +
+					lms.weights[2] * lms.weights[2] + lms.weights[3] * lms.weights[3];
+				if (weightsSum > 0x2fffffff) {
+					for (int i = 0; i < QOA_LMS_LEN; i++) { lms.weights[i] = 0; }
+				}
+				uint64 history = 0, weights = 0;
+				for (int i = 0; i < QOA_LMS_LEN; i++) {
+					history = (history << 16) | (lms.history[i] & 0xffff);
+					weights = (weights << 16) | (lms.weights[i] & 0xffff);
+				}
+				qoa::writeU64(history, bytes);
+				qoa::writeU64(weights, bytes + 8);
+				bytes += 16;
+			}
+
+			int previousScaleFactor[MaxChannels] = { 0 };
+			for (Size index = 0; index < frameLength; index += QOA_SLICE_LEN) {
+				const Size sliceLength = min(Size(QOA_SLICE_LEN), frameLength - index);
+				for (Channel c = 0; c < mChannels; c++) {
+					const short* samples = mPending.data() + c * FrameLength + index;
+					// Brute force search for the scale factor with the lowest error
+					uint64 bestError = ~uint64(0);
+					uint64 bestSlice = 0;
+					qoa_lms_t bestLms = mLms[c];
+					int bestScaleFactor = 0;
+					for (int sfi = 0; sfi < 16; sfi++) {
+						// Neighboring slices tend to have similar scale factors
+						const int scalefactor = (sfi + previousScaleFactor[c]) % 16;
+						qoa_lms_t lms = mLms[c];
+						uint64 slice = uint64(scalefactor);
+						uint64 error = 0;
+						for (Size i = 0; i < sliceLength; i++) {
+							const int sample = samples[i];
+							const int predicted = qoa::predict(lms);
+							const int residual = sample - predicted;
+							const int scaled = clamp(qoa::div(residual, scalefactor), -8, 8);
+							const int quantized = qoa::QuantTab[scaled + 8];
+							const int dequantized = qoa::DequantTab[scalefactor][quantized];
+							const int reconstructed = qoa::clampS16(predicted + dequantized);
+							const long long delta = sample - reconstructed;
+							error += uint64(delta * delta);
+							if (error > bestError) { break; }
+							qoa::update(lms, reconstructed, dequantized);
+							slice = (slice << 3) | uint64(quantized);
+						}
+						if (error < bestError) {
+							bestError = error;
+							bestSlice = slice;
+							bestLms = lms;
+							bestScaleFactor = scalefactor;
+						}
+					}
+					previousScaleFactor[c] = bestScaleFactor;
+					mLms[c] = bestLms;
+					// Short slices in the last frame are left aligned
+					bestSlice <<= (QOA_SLICE_LEN - sliceLength) * 3;
+					qoa::writeU64(bestSlice, bytes);
+					bytes += 8;
+				}
+			}
+
+			mPendingCount = 0;
+			return mSink->write(mFrameBuffer.data(), frameSize) == frameSize;
+		}
+
+		bool writeFileHeader(Size samples) {
+			uchar header[8];
+			qoa::writeU64((uint64(QOA_MAGIC) << 32) | uint64(samples), header);
+			return mSink->write(header, 8) == 8;
+		}
+
+	public:
+		QoaCodecTpl() = default;
+		QoaCodecTpl(const QoaCodecTpl&) = delete;
+		QoaCodecTpl& operator=(const QoaCodecTpl&) = delete;
+
+		~QoaCodecTpl() { close(); }
+
+		Result open(ICodecSource& source) override {
+			close();
+			uchar header[16];
+			if (!source.seek(0) || source.read(header, 16) != 16) {
+				return Result::InvalidFormat;
+			}
+			const uint64 file = qoa::readU64(header);
+			const uint64 frame = qoa::readU64(header + 8);
+			mLength = Size(file & 0xffffffff);
+			mChannels = Channel((frame >> 56) & 0x0000ff);
+			mSampleRate = Size((frame >> 32) & 0xffffff);
+			if (
+				(file >> 32) != QOA_MAGIC || mLength == 0 ||
+				mChannels == 0 || MaxChannels < mChannels || mSampleRate == 0
+			) {
+				return Result::InvalidFormat; // ! Streaming qoa files aren't supported
+			}
+
+			mSource = &source;
+			mData = static_cast<const uchar*>(source.data());
+			mDataSize = source.size();
+			if (mData == nullptr) {
+				mFrameBuffer.resize(Size(qoa::fullFrameSize(mChannels)));
+			}
+			mMode = Mode::Reading;
+			mPosition = 0;
+			if (!loadFrame(0)) {
+				close();
+				return Result::InvalidFormat;
+			}
+			return Result::Success;
+		}
+
+		Result create(ICodecSink& sink, Size sampleRate, Channel channels) override {
+			close();
+			if (channels == 0 || MaxChannels < channels) { return Result::InvalidFormat; }
+			if (sampleRate == 0 || 0xffffff < sampleRate) { return Result::InvalidFormat; }
+			mSink = &sink;
+			mChannels = channels;
+			mSampleRate = sampleRate;
+			mLength = 0;
+			mPendingCount = 0;
+			if (!mPending.resize(FrameLength * channels)) { return Result::GenericError; }
+			if (!mFrameBuffer.resize(Size(qoa::fullFrameSize(channels)))) { return Result::GenericError; }
+
+			for (Channel c = 0; c < channels; c++) {
+				// Helps predicting the first few ms
+				mLms[c].weights[0] = 0;
+				mLms[c].weights[1] = 0;
+				mLms[c].weights[2] = -(1 << 13);
+				mLms[c].weights[3] = (1 << 14);
+				for (int i = 0; i < QOA_LMS_LEN; i++) { mLms[c].history[i] = 0; }
+			}
+			// The length is only known when closing
+			if (!writeFileHeader(0)) { return Result::GenericError; }
+			mMode = Mode::Writing;
+			return Result::Success;
+		}
+
+		Result close() override {
+			Result result = Result::Success;
+			if (mMode == Mode::Writing) {
+				if (0 < mPendingCount && !encodeFrame()) {
+					result = Result::GenericError;
+				}
+				const SizeT end = mSink->tell();
+				if (!mSink->seek(0) || !writeFileHeader(mLength) || !mSink->seek(end)) {
+					result = Result::GenericError;
+				}
+				mPending.resize(0);
+			}
+			mMode = Mode::Closed;
+			mSource = nullptr;
+			mSink = nullptr;
+			mData = nullptr;
+			mFrame = nullptr;
+			mFrameBuffer.resize(0);
+			return result;
+		}
+
+		Result readAll(Buffer& result) override {
+			if (mMode != Mode::Reading) { return Result::NotOpen; }
+			const Size remaining = mLength - mPosition;
+			if (remaining == 0) {
+				result.setValidSize(0);
+				return Result::Success;
+			}
+			return read(remaining, result) == remaining ? Result::Success : Result::GenericError;
+		}
+
+		Size read(Size count, Buffer& result) override {
+			if (mMode != Mode::Reading) { return 0; }
+			if (result.size() < count || result.channels() != mChannels) {
+				result.resize(count, mChannels);
+			}
+			result.sampleRate = typename Buffer::SampleRate(mSampleRate);
+			Size done = 0;
+			while (done < count) {
+				if (mFrameOffset == mFrameSamples) {
+					if (!loadFrame(mFrameIndex + 1)) { break; } // ! End of stream
+				}
+				const Size chunk = min(count - done, mFrameSamples - mFrameOffset);
+				for (Channel c = 0; c < mChannels; c++) {
+					decodeChannel(c, result[c] + done, mFrameOffset, chunk);
+				}
+				mFrameOffset += chunk;
+				done += chunk;
+			}
+			mPosition += done;
+			result.setValidSize(done);
+			return done;
+		}
+
+		Result write(const Buffer& audio) override {
+			if (mMode != Mode::Writing) { return Result::NotOpen; }
+			TKLB_ASSERT(audio.channels() == mChannels)
+			const Size frames = audio.validSize();
+			Size done = 0;
+			while (done < frames) {
+				const Size chunk = min(frames - done, FrameLength - mPendingCount);
+				for (Channel c = 0; c < mChannels; c++) {
+					const T* in = audio[c] + done;
+					short* out = mPending.data() + c * FrameLength + mPendingCount;
+					for (Size i = 0; i < chunk; i++) {
+						out[i] = short(clamp(int(in[i] * T(32767)), -32768, 32767));
+					}
+				}
+				mPendingCount += chunk;
+				mLength += chunk;
+				done += chunk;
+				if (mPendingCount == FrameLength && !encodeFrame()) {
+					return Result::GenericError;
+				}
+			}
+			return Result::Success;
+		}
+
+		Result scrub(Size index) override {
+			if (mMode != Mode::Reading) { return Result::NotOpen; }
+			if (mLength < index) { return Result::OutOfRange; }
+			const Size frame = index / FrameLength;
+			if (index == mLength && index % FrameLength == 0) {
+				// Exactly at the end, there's no frame to load
+				if (!loadFrame(frame - 1)) { return Result::GenericError; }
+				mFrameOffset = mFrameSamples;
+				mPosition = index;
+				return Result::Success;
+			}
+			if (!loadFrame(frame)) { return Result::GenericError; }
+			// The filter state is only stored per frame, decode up to the position
+			const Size skip = index - frame * FrameLength;
+			for (Channel c = 0; c < mChannels; c++) {
+				decodeChannel(c, nullptr, 0, skip);
+			}
+			mFrameOffset = skip;
+			mPosition = index;
+			return Result::Success;
+		}
+
+		Size length() const override { return mLength; }
+
+		Size position() const override {
+			return mMode == Mode::Writing ? mLength : mPosition;
+		}
+
+		Size sampleRate() const override { return mMode == Mode::Closed ? 0 : mSampleRate; }
+
+		Channel channels() const override { return mMode == Mode::Closed ? 0 : mChannels; }
+	};
+
+	// Default type
+	#ifdef TKLB_SAMPLE_FLOAT
+		using QoaCodec = QoaCodecTpl<float>;
+	#else
+		using QoaCodec = QoaCodecTpl<double>;
+	#endif
+
+	namespace qoa {
+		/**
+		 * @brief Decode a whole qoa file from any source
+		 * @param source Source to decode, e.g. a FileSource
+		 * @param out The buffer to store the result in
+		 */
+		template <typename T, class Buffer = AudioBufferTpl<T>>
+		bool load(ICodecSource& source, Buffer& out) {
+			using Codec = QoaCodecTpl<T, Buffer>;
+			Codec codec;
+			if (codec.open(source) != Codec::Result::Success) {
+				return false;
+			}
+			return codec.readAll(out) == Codec::Result::Success;
+		}
+
+		/**
+		 * @brief Decode qoa from memory
+		 * @param data The qoa file buffer
+		 * @param length The length of the qoa file buffer
+		 * @param out The buffer to store the result in
+		 */
+		template <typename T, class Buffer = AudioBufferTpl<T>>
+		bool load(const char* data, typename Buffer::Size length, Buffer& out) {
+			MemorySource source(data, length);
+			return load<T, Buffer>(source, out);
+		}
+
+		/**
+		 * @brief Encode a buffer to qoa in memory
+		 * @param in The audio to encode, needs the samplerate set
+		 * @param out Buffer to write the qoa file to
+		 */
+		template <typename T, class Buffer = AudioBufferTpl<T>>
+		bool write(const Buffer& in, HeapBuffer<char>& out) {
+			using Codec = QoaCodecTpl<T, Buffer>;
+			out.resize(0);
+			HeapBufferSink sink(out);
+			Codec codec;
+			if (codec.create(sink, in.sampleRate, in.channels()) != Codec::Result::Success) {
+				return false;
+			}
+			if (codec.write(in) != Codec::Result::Success) {
+				codec.close();
+				return false;
+			}
+			return codec.close() == Codec::Result::Success;
+		}
+	} // namespace qoa
+} // namespace tklb
+
+#endif // _TKLB_QOA
@@ -1,81 +1,295 @@
+/**
+ * @file TVorbis.hpp
+ * @author Tobias Kozel
+ * @brief Wrapper around stb_vorbis
+ * @version 0.2
+ * @date 2022-08-15
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+
 #ifndef _TKLB_VORBIS
 #define _TKLB_VORBIS
 
-#include "./TAudioBuffer.hpp"
-
+#include "./TICodec.hpp"
+#include "../TAudioBuffer.hpp"
 
 #define STB_VORBIS_NO_PUSHDATA_API // Don't need this
 #define STB_VORBIS_NO_INTEGER_CONVERSION // don't need either
-// #define STB_VORBIS_NO_CRT // TODO hook the allocations
 #define STB_VORBIS_NO_STDIO
 #ifndef TKLB_IMPL
 	// Works inverted
 	#define STB_VORBIS_HEADER_ONLY
 #endif
-#include "../../../external/stb_vorbis.c"
+#include "../../../../external/stb_vorbis.c"
 
-namespace tklb { namespace vorbis {
+namespace tklb {
 	/**
-	 * @brief Decode ogg/vorbis from memory or
-	 * @param data The path or the wav file buffer if length is non 0
-	 * @param length The length of the wav file buffer if not reading from file
-	 * @param out The buffer to store the result in
+	 * @brief Streaming ogg/vorbis decoder using stb_vorbis.
+	 * @details Decodes on demand, the only decoded audio held is the
+	 *          current vorbis frame inside stb_vorbis, which acts as the
+	 *          ring buffer between the packets and read().
+	 *          stb_vorbis allocates from a single arena owned by the codec,
+	 *          so the decoder memory is fixed after open() and can be
+	 *          queried with decoderMemory().
+	 *          stb_vorbis needs random access to the compressed data, sources
+	 *          not providing data() are copied into memory once.
+	 * @tparam T Sample type
+	 * @tparam Buffer AudioBuffer type
 	 */
 	template <typename T, class Buffer = AudioBufferTpl<T>>
-	bool load(const char* data, typename Buffer::Size length, Buffer& out) {
-		using Size = typename Buffer::Size;
-
-		stb_vorbis* vorbis;
-		int error = 0;
-		vorbis = stb_vorbis_open_memory(
-			reinterpret_cast<const unsigned char*>(data), length, &error, nullptr
-		);
-
-		if (error != VORBIS__no_error) {
-			stb_vorbis_close(vorbis);
-			return false;
+	class VorbisCodecTpl : public ICodecTpl<T, Buffer> {
+		using Base = ICodecTpl<T, Buffer>;
+	public:
+		using Result = typename Base::Result;
+		using Size = typename Base::Size;
+		using Channel = typename Base::Channel;
+
+		/**
+		 * @brief Frames converted at once when T isn't float
+		 */
+		static constexpr Size ChunkSize = 512;
+
+		/**
+		 * @brief First arena size tried, doubled until the setup fits
+		 */
+		static constexpr SizeT ArenaStart = 64 * 1024;
+
+		/**
+		 * @brief Give up if the decoder needs more than this
+		 */
+		static constexpr SizeT ArenaLimit = 16 * 1024 * 1024;
+
+	private:
+		stb_vorbis* mVorbis = nullptr;
+		stb_vorbis_info mInfo;
+		Size mLength = 0;
+		Size mPosition = 0;
+
+		HeapBuffer<char, 16> mArena;				///< stb_vorbis allocates from here
+		HeapBuffer<unsigned char> mCompressed;		///< Copy of the stream if the source isn't in memory
+		AudioBufferTpl<float> mScratch;				///< Conversion space if T isn't float
+
+		/**
+		 * @brief Reads until the end, the size might not be known
+		 */
+		bool copySource(ICodecSource& source) {
+			using CSize = typename HeapBuffer<unsigned char>::Size;
+			constexpr CSize chunk = 64 * 1024;
+			mCompressed.resize(0);
+			if (!source.seek(0)) { return false; }
+			CSize filled = 0;
+			while (true) {
+				if (!mCompressed.resize(filled + chunk, false)) { return false; }
+				const CSize got = CSize(source.read(mCompressed.data() + filled, chunk));
+				filled += got;
+				if (got < chunk) { break; }
+			}
+			mCompressed.resize(filled, false);
+			return true;
 		}
 
-		const stb_vorbis_info info = stb_vorbis_get_info(vorbis);
-		const Size streamLength = stb_vorbis_stream_length_in_samples(vorbis);
-
-		out.sampleRate = info.sample_rate;
-		out.resize(streamLength, Size(info.channels)); // will fail at channels higher than allowed
-
-		if (std::is_same<float, T>::value) {
-			HeapBuffer<T*> buffer;
-			buffer.resize(info.channels);
-			out.getRaw(buffer.data());
-			// seems evil but we're only here if it's alredy a float**
-			float** fbuf = reinterpret_cast<float**>(buffer.data());
-			Size got = stb_vorbis_get_samples_float(
-				vorbis, info.channels, fbuf, streamLength
-			);
-			out.setValidSize(got);
-			stb_vorbis_close(vorbis);
-			return got == streamLength;
+		/**
+		 * @brief Decodes into float channels
+		 */
+		Size decode(float** out, Channel channels, Size count) {
+			Size done = 0;
+			float* offset[256];
+			while (done < count) {
+				for (Channel c = 0; c < channels; c++) { offset[c] = out[c] + done; }
+				const int got = stb_vorbis_get_samples_float(
+					mVorbis, channels, offset, int(count - done)
+				);
+				if (got <= 0) { break; } // ! End of stream
+				done += Size(got);
+			}
+			mPosition += done;
+			return done;
 		}
 
-		Size read = 0;
+	public:
+		VorbisCodecTpl() = default;
+		VorbisCodecTpl(const VorbisCodecTpl&) = delete;
+		VorbisCodecTpl& operator=(const VorbisCodecTpl&) = delete;
+
+		~VorbisCodecTpl() { close(); }
 
-		int channels = info.channels;
-		float** bufferPtr = nullptr;
-		while (read < streamLength) {
-			Size got = stb_vorbis_get_frame_float(vorbis, &channels, &bufferPtr);
-			out.set(bufferPtr, got, channels, 0, read);
-			read += got;
+		Result open(ICodecSource& source) override {
+			close();
+			const unsigned char* data = static_cast<const unsigned char*>(source.data());
+			SizeT size = source.size();
+			if (data == nullptr) {
+				if (!copySource(source)) { return Result::GenericError; }
+				data = mCompressed.data();
+				size = mCompressed.size();
+			}
+
+			SizeT arena = max(SizeT(ArenaStart), SizeT(mArena.size()));
+			while (arena <= ArenaLimit) {
+				if (!mArena.resize(typename HeapBuffer<char, 16>::Size(arena))) {
+					return Result::GenericError;
+				}
+				stb_vorbis_alloc alloc;
+				alloc.alloc_buffer = mArena.data();
+				alloc.alloc_buffer_length_in_bytes = int(mArena.size());
+				int error = VORBIS__no_error;
+				mVorbis = stb_vorbis_open_memory(data, int(size), &error, &alloc);
+				if (mVorbis != nullptr) { break; }
+				if (error != VORBIS_outofmem) {
+					mCompressed.resize(0);
+					return Result::InvalidFormat;
+				}
+				arena *= 2;
+			}
+			if (mVorbis == nullptr) { return Result::GenericError; } // ! Needs a lot of memory
+
+			mInfo = stb_vorbis_get_info(mVorbis);
+			mLength = Size(stb_vorbis_stream_length_in_samples(mVorbis));
+			mPosition = 0;
+			if (!traits::IsSame<T, float>::value) {
+				mScratch.resize(ChunkSize, Channel(mInfo.channels));
+			}
+			return Result::Success;
+		}
+
+		/**
+		 * @brief There's no vorbis encoder
+		 */
+		Result create(ICodecSink& sink, Size sampleRate, Channel channels) override {
+			(void) sink; (void) sampleRate; (void) channels;
+			return Result::NotImplemented;
 		}
 
-		out.setValidSize(read);
+		Result close() override {
+			if (mVorbis != nullptr) {
+				stb_vorbis_close(mVorbis);
+				mVorbis = nullptr;
+			}
+			mCompressed.resize(0);
+			mLength = mPosition = 0;
+			return Result::Success;
+		}
+
+		Result readAll(Buffer& result) override {
+			if (mVorbis == nullptr) { return Result::NotOpen; }
+			const Size remaining = mLength - mPosition;
+			if (remaining == 0) {
+				result.setValidSize(0);
+				return Result::Success;
+			}
+			return read(remaining, result) == remaining ? Result::Success : Result::GenericError;
+		}
 
-		stb_vorbis_close(vorbis);
+		Size read(Size count, Buffer& result) override {
+			if (mVorbis == nullptr) { return 0; }
+			const Channel chan = channels();
+			if (result.size() < count || result.channels() != chan) {
+				result.resize(count, chan);
+			}
+			result.sampleRate = typename Buffer::SampleRate(mInfo.sample_rate);
 
-		if (read == 0) {
-			return false;
+			Size done = 0;
+			if (traits::IsSame<T, float>::value) {
+				float* raw[256];
+				// Only reached when T is float
+				result.getRaw(reinterpret_cast<T**>(raw));
+				done = decode(raw, chan, count);
+			} else {
+				float* raw[256];
+				mScratch.getRaw(raw);
+				while (done < count) {
+					const Size got = decode(raw, chan, min(Size(ChunkSize), count - done));
+					if (got == 0) { break; }
+					mScratch.setValidSize(got);
+					result.set(mScratch, got, 0, done);
+					done += got;
+				}
+			}
+			result.setValidSize(done);
+			return done;
 		}
 
-		return true;
-	}
-} } // tklb::vorbis
+		Result write(const Buffer& audio) override {
+			(void) audio;
+			return Result::NotImplemented;
+		}
+
+		Result scrub(Size index) override {
+			if (mVorbis == nullptr) { return Result::NotOpen; }
+			if (mLength < index) { return Result::OutOfRange; }
+			const int ok = (index == 0) ?
+				stb_vorbis_seek_start(mVorbis) : stb_vorbis_seek(mVorbis, index);
+			if (!ok) { return Result::GenericError; }
+			mPosition = index;
+			return Result::Success;
+		}
+
+		Size length() const override { return mLength; }
+
+		Size position() const override { return mPosition; }
+
+		Size sampleRate() const override {
+			return mVorbis == nullptr ? 0 : Size(mInfo.sample_rate);
+		}
+
+		Channel channels() const override {
+			return mVorbis == nullptr ? 0 : Channel(mInfo.channels);
+		}
+
+		/**
+		 * @brief Memory reserved for the stb_vorbis decoder in bytes
+		 */
+		SizeT decoderMemory() const { return mArena.allocated(); }
+
+		/**
+		 * @brief All memory held by this codec in bytes,
+		 *        including the compressed copy and conversion space
+		 */
+		SizeT memory() const {
+			return mArena.allocated() + mCompressed.allocated() +
+				mScratch.size() * mScratch.channels() * sizeof(float);
+		}
+	};
+
+	// Default type
+	#ifdef TKLB_SAMPLE_FLOAT
+		using VorbisCodec = VorbisCodecTpl<float>;
+	#else
+		using VorbisCodec = VorbisCodecTpl<double>;
+	#endif
+
+	namespace vorbis {
+		/**
+		 * @brief Decode a whole ogg file from any source
+		 * @param source Source to decode, e.g. a FileSource
+		 * @param out The buffer to store the result in
+		 */
+		template <typename T, class Buffer = AudioBufferTpl<T>>
+		bool load(ICodecSource& source, Buffer& out) {
+			using Codec = VorbisCodecTpl<T, Buffer>;
+			Codec codec;
+			if (codec.open(source) != Codec::Result::Success) {
+				return false;
+			}
+			if (codec.length() == 0) {
+				return false;
+			}
+			return codec.readAll(out) == Codec::Result::Success;
+		}
+
+		/**
+		 * @brief Decode ogg/vorbis from memory
+		 * @param data The ogg file buffer
+		 * @param length The length of the ogg file buffer
+		 * @param out The buffer to store the result in
+		 */
+		template <typename T, class Buffer = AudioBufferTpl<T>>
+		bool load(const char* data, typename Buffer::Size length, Buffer& out) {
+			MemorySource source(data, length);
+			return load<T, Buffer>(source, out);
+		}
+	} // namespace vorbis
+} // namespace tklb
 
 #endif // _TKLB_VORBIS
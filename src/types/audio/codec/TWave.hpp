@@ -1,8 +1,8 @@
 /**
- * @file TWaveFile.hpp
+ * @file TWave.hpp
  * @author Tobias Kozel
  * @brief Wrapper around dr_wav
- * @version 0.1
+ * @version 0.2
  * @date 2022-08-15
  *
  * @copyright Copyright (c) 2022
@@ -12,23 +12,76 @@
 #ifndef _TKLB_WAVE
 #define _TKLB_WAVE
 
-#include "./TAudioBuffer.hpp"
+#include "./TICodec.hpp"
+#include "../TAudioBuffer.hpp"
 
 #define DR_WAV_NO_STDIO
 
 #ifdef TKLB_IMPL
 	#define DR_WAV_IMPLEMENTATION
 #endif
-#include "../../../external/dr_wav.h"
+#include "../../../../external/dr_wav.h"
 
 
 namespace tklb {
 
 	/**
-	 * @brief Wave decoder/encoder using dr_wav
-	 *
+	 * @brief Small option struct to save wave files
 	 */
-	class Wave {
+	struct WaveOptions {
+		int bitsPerSample = 32;
+		enum Container {
+			riff = drwav_container_riff,
+			w64 = drwav_container_w64,
+			rf64 = drwav_container_rf64
+		};
+		Container container = Container::riff;
+
+		enum Format {
+			PCM = DR_WAVE_FORMAT_PCM,
+			// ADPCM = DR_WAVE_FORMAT_ADPCM,
+			IEEE_FLOAT = DR_WAVE_FORMAT_IEEE_FLOAT,
+			// ALAW = DR_WAVE_FORMAT_ALAW,
+			// MULAW = DR_WAVE_FORMAT_MULAW,
+			// DVI_ADPCM = DR_WAVE_FORMAT_DVI_ADPCM,
+			// EXTENSIBLE = DR_WAVE_FORMAT_EXTENSIBLE
+		};
+		Format format = Format::IEEE_FLOAT;
+	};
+
+	/**
+	 * @brief Streaming wave decoder/encoder using dr_wav.
+	 *        Only a single chunk of interleaved audio is kept in memory,
+	 *        the rest is pulled from the source or pushed to the sink.
+	 * @tparam T Sample type
+	 * @tparam Buffer AudioBuffer type
+	 */
+	template <typename T, class Buffer = AudioBufferTpl<T>>
+	class WaveCodecTpl : public ICodecTpl<T, Buffer> {
+		using Base = ICodecTpl<T, Buffer>;
+	public:
+		using Result = typename Base::Result;
+		using Size = typename Base::Size;
+		using Channel = typename Base::Channel;
+
+		/**
+		 * @brief Frames converted at once, sets the size of the scratch buffer
+		 */
+		static constexpr Size ChunkSize = 512;
+
+	private:
+		enum class Mode { Closed, Reading, Writing };
+
+		drwav mWav;
+		Mode mMode = Mode::Closed;
+		WaveOptions mOptions;
+		Size mWritten = 0;
+
+		/**
+		 * @brief Interleaved scratch space for one chunk
+		 */
+		HeapBuffer<char, DEFAULT_ALIGNMENT_BYTES> mChunk;
+
 		static void* drWavMalloc(SizeT size, void* userData) {
 			(void) userData;
 			return TKLB_MALLOC(size);
@@ -46,80 +99,223 @@ namespace tklb {
 			&drWavFree
 		};
 
-	public:
+		static size_t onRead(void* userData, void* out, size_t bytes) {
+			return size_t(static_cast<ICodecSource*>(userData)->read(out, bytes));
+		}
+
+		static size_t onWrite(void* userData, const void* data, size_t bytes) {
+			return size_t(static_cast<ICodecSink*>(userData)->write(data, bytes));
+		}
 
 		/**
-		 * @brief Decode wav from memory
-		 * @param path The path or the wav file buffer if length is non 0
-		 * @param out The buffer to store the result in
-		 * @param length The length of the wav file buffer if not reading from file
+		 * @brief dr_wav seeks relative, the streams absolute
 		 */
-		template <typename T, class Buffer = AudioBufferTpl<T>>
-		bool load(const char* data, typename Buffer::Size length, Buffer& out) {
+		template <class Stream>
+		static drwav_bool32 onSeek(void* userData, int offset, drwav_seek_origin origin) {
+			Stream* stream = static_cast<Stream*>(userData);
+			const SizeT base = (origin == drwav_seek_origin_current) ? stream->tell() : 0;
+			if (offset < 0 && base < SizeT(-offset)) { return DRWAV_FALSE; }
+			const SizeT target = offset < 0 ? base - SizeT(-offset) : base + SizeT(offset);
+			return stream->seek(target) ? DRWAV_TRUE : DRWAV_FALSE;
+		}
 
+		template <typename T2>
+		Result writeChunked(const Buffer& audio) {
+			const Size frames = audio.validSize();
+			T2* interleaved = reinterpret_cast<T2*>(mChunk.data());
+			Size written = 0;
+			while (written < frames) {
+				const Size count = audio.putInterleaved(interleaved, min(Size(ChunkSize), frames - written), written);
+				const Size got = Size(drwav_write_pcm_frames(&mWav, count, interleaved));
+				written += got;
+				mWritten += got;
+				if (got != count) { return Result::GenericError; } // ! Sink is full
+			}
+			return Result::Success;
+		}
 
-			using Size = typename Buffer::Size;
-			using uchar = unsigned char;
+	public:
+		WaveCodecTpl() = default;
+		WaveCodecTpl(const WaveCodecTpl&) = delete;
+		WaveCodecTpl& operator=(const WaveCodecTpl&) = delete;
 
-			drwav wav;
+		~WaveCodecTpl() { close(); }
 
-			if (!drwav_init_memory(
-				&wav, data, length,
-				&mDrwaveCallbacks
+		Result open(ICodecSource& source) override {
+			close();
+			if (!drwav_init(
+				&mWav, &onRead, &onSeek<ICodecSource>,
+				&source, &mDrwaveCallbacks
 			)) {
-				return false;
+				return Result::InvalidFormat;
 			}
-			constexpr Size chunkSize = 128;
-			Size read = 0;
-			HeapBuffer<float> chunkBuffer;
-			chunkBuffer.resize(chunkSize * wav.channels);
-
-			out.sampleRate = wav.sampleRate;
-			out.resize(Size(wav.totalPCMFrameCount), Size(wav.channels));
-
-			while (read < wav.totalPCMFrameCount) {
-				auto got = (Size) drwav_read_pcm_frames_f32(
-					&wav, chunkSize, chunkBuffer.data()
-				);
-				out.setFromInterleaved(chunkBuffer.data(), got, uchar(wav.channels), 0, read);
-				read += got;
+			if (!mChunk.resize(ChunkSize * mWav.channels * sizeof(float))) {
+				drwav_uninit(&mWav);
+				return Result::GenericError;
 			}
+			mMode = Mode::Reading;
+			return Result::Success;
+		}
 
-			if (read == 0) {
-				return false;
+		Result create(ICodecSink& sink, Size sampleRate, Channel channels) override {
+			return create(sink, sampleRate, channels, mOptions);
+		}
+
+		/**
+		 * @brief Start encoding with the provided options
+		 */
+		Result create(
+			ICodecSink& sink, Size sampleRate, Channel channels,
+			const WaveOptions& options
+		) {
+			close();
+			TKLB_ASSERT(sampleRate != 0 && channels != 0)
+			const bool supported =
+				(options.format == WaveOptions::Format::IEEE_FLOAT && options.bitsPerSample == 32) ||
+				(options.format == WaveOptions::Format::PCM && options.bitsPerSample == 16);
+			if (!supported) { return Result::InvalidFormat; }
+
+			mOptions = options;
+			drwav_data_format format;
+			format.sampleRate = sampleRate;
+			format.channels = channels;
+			format.bitsPerSample = options.bitsPerSample;
+			format.format = options.format;
+			format.container = drwav_container(options.container);
+
+			if (!drwav_init_write(
+				&mWav, &format, &onWrite, &onSeek<ICodecSink>,
+				&sink, &mDrwaveCallbacks
+			)) {
+				return Result::GenericError;
 			}
+			if (!mChunk.resize(ChunkSize * channels * (options.bitsPerSample / 8))) {
+				drwav_uninit(&mWav);
+				return Result::GenericError;
+			}
+			mWritten = 0;
+			mMode = Mode::Writing;
+			return Result::Success;
+		}
 
-			out.setValidSize(read);
-			drwav_uninit(&wav);
-			return true;
+		Result close() override {
+			if (mMode == Mode::Closed) { return Result::Success; }
+			mMode = Mode::Closed;
+			// Writes the final header when encoding
+			return drwav_uninit(&mWav) == DRWAV_SUCCESS ? Result::Success : Result::GenericError;
+		}
+
+		Result readAll(Buffer& result) override {
+			if (mMode != Mode::Reading) { return Result::NotOpen; }
+			const Size remaining = length() - position();
+			if (remaining == 0) {
+				result.setValidSize(0);
+				return Result::Success;
+			}
+			return read(remaining, result) == remaining ? Result::Success : Result::GenericError;
 		}
 
+		Size read(Size count, Buffer& result) override {
+			if (mMode != Mode::Reading) { return 0; }
+			const Channel chan = channels();
+			if (result.size() < count || result.channels() != chan) {
+				result.resize(count, chan);
+			}
+			result.sampleRate = typename Buffer::SampleRate(mWav.sampleRate);
+			float* interleaved = reinterpret_cast<float*>(mChunk.data());
+			Size done = 0;
+			while (done < count) {
+				const Size got = Size(drwav_read_pcm_frames_f32(
+					&mWav, min(Size(ChunkSize), count - done), interleaved
+				));
+				if (got == 0) { break; } // ! End of stream
+				result.setFromInterleaved(interleaved, got, chan, 0, done);
+				done += got;
+			}
+			result.setValidSize(done);
+			return done;
+		}
+
+		Result write(const Buffer& audio) override {
+			if (mMode != Mode::Writing) { return Result::NotOpen; }
+			TKLB_ASSERT(audio.channels() == channels())
+			if (mOptions.format == WaveOptions::Format::PCM) {
+				return writeChunked<short>(audio);
+			}
+			return writeChunked<float>(audio);
+		}
+
+		Result scrub(Size index) override {
+			if (mMode != Mode::Reading) { return Result::NotOpen; }
+			if (length() < index) { return Result::OutOfRange; }
+			return drwav_seek_to_pcm_frame(&mWav, index) ? Result::Success : Result::GenericError;
+		}
+
+		Size length() const override {
+			if (mMode == Mode::Writing) { return mWritten; }
+			return mMode == Mode::Reading ? Size(mWav.totalPCMFrameCount) : 0;
+		}
+
+		Size position() const override {
+			if (mMode == Mode::Writing) { return mWritten; }
+			return mMode == Mode::Reading ? Size(mWav.readCursorInPCMFrames) : 0;
+		}
+
+		Size sampleRate() const override {
+			return mMode == Mode::Closed ? 0 : Size(mWav.sampleRate);
+		}
+
+		Channel channels() const override {
+			return mMode == Mode::Closed ? 0 : Channel(mWav.channels);
+		}
+	};
+
+	// Default type
+	#ifdef TKLB_SAMPLE_FLOAT
+		using WaveCodec = WaveCodecTpl<float>;
+	#else
+		using WaveCodec = WaveCodecTpl<double>;
+	#endif
+
+	/**
+	 * @brief Wave decoder/encoder for complete files in memory
+	 */
+	class Wave {
+	public:
+		using WaveOptions = tklb::WaveOptions;
+
 		/**
-		 * @brief Small option struct to save wave files
+		 * @brief Decode a whole wav file from any source
+		 * @param source Source to decode, e.g. a FileSource
+		 * @param out The buffer to store the result in
 		 */
-		struct WaveOptions {
-			int bitsPerSample = 32;
-			enum Container {
-				riff = drwav_container_riff,
-				w64 = drwav_container_w64,
-				rf64 = drwav_container_rf64
-			};
-			Container container = Container::riff;
-
-			enum Format {
-				PCM = DR_WAVE_FORMAT_PCM,
-				// ADPCM = DR_WAVE_FORMAT_ADPCM,
-				IEEE_FLOAT = DR_WAVE_FORMAT_IEEE_FLOAT,
-				// ALAW = DR_WAVE_FORMAT_ALAW,
-				// MULAW = DR_WAVE_FORMAT_MULAW,
-				// DVI_ADPCM = DR_WAVE_FORMAT_DVI_ADPCM,
-				// EXTENSIBLE = DR_WAVE_FORMAT_EXTENSIBLE
-			};
-			Format format = Format::IEEE_FLOAT;
-		};
+		template <typename T, class Buffer = AudioBufferTpl<T>>
+		bool load(ICodecSource& source, Buffer& out) {
+			using Codec = WaveCodecTpl<T, Buffer>;
+			Codec codec;
+			if (codec.open(source) != Codec::Result::Success) {
+				return false;
+			}
+			if (codec.length() == 0) {
+				return false;
+			}
+			return codec.readAll(out) == Codec::Result::Success;
+		}
+
+		/**
+		 * @brief Decode wav from memory
+		 * @param data The wav file buffer
+		 * @param length The length of the wav file buffer
+		 * @param out The buffer to store the result in
+		 */
+		template <typename T, class Buffer = AudioBufferTpl<T>>
+		bool load(const char* data, typename Buffer::Size length, Buffer& out) {
+			MemorySource source(data, length);
+			return load<T, Buffer>(source, out);
+		}
 
 		/**
-		 * @brief Write audiobuffer to file or memory
+		 * @brief Write audiobuffer to memory
 		 * @param in The audio buffer to write, needs samplerate to be set
 		 * @param out Buffer to write the wave file to
 		 * @param option Wave options to pass
@@ -128,75 +324,24 @@ namespace tklb {
 		bool write(
 			const Buffer& in,
 			HeapBuffer<char>& out,
-			const WaveOptions&& options = {}
+			const WaveOptions& options = {}
 		) {
-			drwav wav;
-
-			// TODO tklb this causes issues somehow
-			// using Size = typename Buffer::Size;
-			using Size = SizeT;
-
-			drwav_data_format droptions;
+			using Codec = WaveCodecTpl<T, Buffer>;
 			TKLB_ASSERT(in.sampleRate != 0) // Set a samplerate
-			droptions.sampleRate = in.sampleRate;
-			droptions.channels = in.channels();
-			droptions.bitsPerSample = options.bitsPerSample;
-			droptions.format = options.format;
-			droptions.container = drwav_container(options.container);
-
-			SizeT outSize = 0;
-			void* memory = nullptr;
-
-			if (!drwav_init_memory_write(
-				&wav, &memory, &outSize,
-				&droptions, &mDrwaveCallbacks)
-			) {
+			// Encodes straight into the output, no intermediate copy
+			out.resize(0);
+			HeapBufferSink sink(out);
+			Codec codec;
+			if (codec.create(sink, in.sampleRate, in.channels(), options) != Codec::Result::Success) {
 				return false;
 			}
-
-			Size written = 0;
-			constexpr Size chunkSize = 128;
-			const Size frames = in.validSize();
-
-			switch (options.format) {
-			case WaveOptions::Format::IEEE_FLOAT:
-				{
-					// TODO benchmark against aligned heapbuffer
-					auto interleaved = new float[chunkSize * in.channels()];
-					while (written < frames) {
-						auto remaining = in.putInterleaved(interleaved, chunkSize, written);
-						written += (Size) drwav_write_pcm_frames(
-							&wav, remaining, interleaved
-						);
-					}
-					delete[] interleaved;
-				}
-				break;
-			case WaveOptions::Format::PCM:
-				{
-					// TODO benchmark against aligned heapbuffer
-					short* interleaved = (short*) TKLB_MALLOC(
-						chunkSize * in.channels() * sizeof(short)
-					);
-					while (written < frames) {
-						auto read = in.putInterleaved(interleaved, chunkSize, written);
-						written += Size(drwav_write_pcm_frames(
-							&wav, read, interleaved)
-						);
-					}
-					TKLB_FREE(interleaved);
-				}
-				break;
-			default:
-				TKLB_ASSERT(false) return false;
+			if (codec.write(in) != Codec::Result::Success) {
+				codec.close();
+				return false;
 			}
-
-			out.set(reinterpret_cast<char*>(memory), Size(outSize));
-			drwav_uninit(&wav);
-			tklb_free(memory);
-			return true;
+			return codec.close() == Codec::Result::Success;
 		}
-	}
-};
+	};
+} // namespace tklb
 
 #endif // _TKLB_WAVE
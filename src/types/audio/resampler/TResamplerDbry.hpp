@@ -1 +1,379 @@
-// https://github.com/dbry/audio-resampler
+/**
+ * @file TResamplerDbry.hpp
+ * @author Tobias Kozel
+ * @brief Windowed sinc resampler using precomputed filter tables
+ * @details Loosely follows the audio-resampler by David Bryant
+ *          https://github.com/dbry/audio-resampler
+ *          A set of blackman-harris windowed sinc filters is generated for
+ *          evenly spaced sub sample positions. Any position in between
+ *          is reached by blending the result of the two closest filters,
+ *          which allows arbitrary (fractional) resampling ratios.
+ * @version 0.1
+ * @date 2023-02-20
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+
+#ifndef _TKLB_RESAMPLER_DBRY
+#define _TKLB_RESAMPLER_DBRY
+
+#include "./TIResampler.hpp"
+#include "../TAudioBuffer.hpp"
+#include "../../../util/TMath.hpp"
+#include "../../../util/TAssert.h"
+
+namespace tklb {
+	/**
+	 * @brief Sinc resampler with a permissive license as an alternative to speex
+	 * @tparam T Input/Output sample type
+	 * @tparam Buffer AudioBuffer
+	 */
+	template <typename T, class Buffer = AudioBufferTpl<T>>
+	class ResamplerDbryTpl : IResamplerTpl<T, Buffer> {
+		using Size = typename Buffer::Size;
+		using Channel = typename Buffer::Channel;
+
+	public:
+		/**
+		 * @brief Filter settings derived from the quality parameter
+		 */
+		struct Preset {
+			Size taps;			///< Filter length, needs to be even
+			Size filters;		///< Number of sub sample positions the filters are computed for
+			double bandwidth;	///< Lowpass cutoff relative to the lower of the two nyquist frequencies
+			bool interpolate;	///< Blend between the two closest filters instead of picking the nearest one
+		};
+
+		/**
+		 * @brief Get the filter settings for a quality from 0-10
+		 */
+		static Preset getPreset(Size quality) {
+			static const Preset presets[] = {
+				{   8,   32, 0.80, false },
+				{  12,   64, 0.83, false },
+				{  16,  128, 0.86, false },
+				{  20,  128, 0.88, true },
+				{  24,  256, 0.90, true },
+				{  32,  256, 0.91, true },
+				{  48,  256, 0.93, true },
+				{  64,  512, 0.94, true },
+				{  96,  512, 0.95, true },
+				{ 128, 1024, 0.96, true },
+				{ 256, 1024, 0.97, true }
+			};
+			return presets[min(quality, Size(10))];
+		}
+
+	private:
+	#ifndef TKLB_NO_SIMD
+		static constexpr Size Stride = xsimd::simd_type<T>::size;
+	#else
+		static constexpr Size Stride = 1;
+	#endif
+
+		Size mRateIn = 0, mRateOut = 0, mQuality = 0;
+		Size mMaxBlock = 0;
+		Preset mPreset = { 0, 0, 0, false };
+		Size mFilterStride = 0;		///< Taps padded to the simd width so every filter starts aligned
+		double mFactor = 1.0;		///< Input samples advanced per output sample
+		double mTime = 0;			///< Position of the first tap in mHistory
+		Size mFill = 0;				///< Valid samples in mHistory
+
+		/**
+		 * @brief Filters for each sub sample position.
+		 *        There's one more filter than Preset::filters to interpolate
+		 *        between the last position and the next full sample.
+		 */
+		HeapBuffer<T, DEFAULT_ALIGNMENT_BYTES> mFilters;
+
+		/**
+		 * @brief Holds the samples of the last block the filters still need
+		 *        followed by the current input block.
+		 */
+		Buffer mHistory;
+
+		static double window(double x) {
+			// 4 term blackman-harris, x from 0 to 1
+			return
+				0.35875
+				- 0.48829 * tklb::cos(2.0 * PI<double> * x)
+				+ 0.14128 * tklb::cos(4.0 * PI<double> * x)
+				- 0.01168 * tklb::cos(6.0 * PI<double> * x);
+		}
+
+		void generateFilters() {
+			const Size taps = mPreset.taps;
+			const Size half = taps / 2;
+			const double cutoff = mPreset.bandwidth * min(1.0, double(mRateOut) / double(mRateIn));
+
+			mFilters.resize(0);
+			mFilters.resize((mPreset.filters + 1) * mFilterStride);
+			memory::set<T>(mFilters.data(), mFilters.size(), T(0)); // padding needs to be 0
+
+			for (Size f = 0; f <= mPreset.filters; f++) {
+				const double offset = double(f) / double(mPreset.filters);
+				T* filter = mFilters.data() + f * mFilterStride;
+				double sum = 0;
+				for (Size i = 0; i < taps; i++) {
+					// distance of the tap to the sample position beeing reconstructed
+					const double x = double(i) - double(half - 1) - offset;
+					const double sinc = (x == 0.0) ?
+						cutoff : tklb::sin(PI<double> * cutoff * x) / (PI<double> * x);
+					const double value = sinc * window((x + double(half)) / double(taps));
+					filter[i] = T(value);
+					sum += value;
+				}
+				// Normalize each filter for unity gain
+				for (Size i = 0; i < taps; i++) {
+					filter[i] = T(filter[i] / sum);
+				}
+			}
+		}
+
+		/**
+		 * @brief Applies a single filter at the given position
+		 */
+		inline T convolve(const T* in, const Size filterIndex) const {
+			const T* filter = mFilters.data() + filterIndex * mFilterStride;
+			#ifndef TKLB_NO_SIMD
+				// The padding is part of the filter, so no scalar tail is needed
+				xsimd::simd_type<T> sum(T(0));
+				for (Size i = 0; i < mFilterStride; i += Stride) {
+					const xsimd::simd_type<T> a = xsimd::load_unaligned(in + i);
+					const xsimd::simd_type<T> b = xsimd::load_aligned(filter + i);
+					sum = xsimd::fma(a, b, sum);
+				}
+				return xsimd::reduce_add(sum);
+			#else
+				T sum = 0;
+				for (Size i = 0; i < mPreset.taps; i++) {
+					sum += in[i] * filter[i];
+				}
+				return sum;
+			#endif
+		}
+
+	public:
+		ResamplerDbryTpl() = default;
+
+		ResamplerDbryTpl(
+			Size rateIn, Size rateOut,
+			Size maxBlock = 512, Channel channels = 2,
+			Size quality = 5
+		) {
+			init(rateIn, rateOut, maxBlock, channels, quality);
+		}
+
+		/**
+		 * @brief setup the resampler
+		 * @param rateIn Input sample rate
+		 * @param rateOut Desired output samplerate
+		 * @param maxBlock Inputs longer than this will be processed in multiple steps
+		 * @param channels Maximum channel count passed to process()
+		 * @param quality Quality from 0-10, @see getPreset()
+		 * @return True on success
+		 */
+		bool init(
+			Size rateIn, Size rateOut,
+			Size maxBlock = 512, Channel channels = 2,
+			Size quality = 5
+		) override {
+			TKLB_ASSERT(0 < rateIn && 0 < rateOut)
+			TKLB_ASSERT(0 < maxBlock && 0 < channels)
+			const bool sameFilters =
+				rateIn == mRateIn && rateOut == mRateOut &&
+				quality == mQuality && isInitialized();
+
+			mRateIn = rateIn;
+			mRateOut = rateOut;
+			mQuality = quality;
+			mMaxBlock = maxBlock;
+			mFactor = double(rateIn) / double(rateOut);
+			mPreset = getPreset(quality);
+			mFilterStride = HeapBuffer<T>::closestChunkSize(mPreset.taps, Stride);
+
+			if (!sameFilters) { generateFilters(); }
+
+			// Room for the history, one block and the filter padding
+			mHistory.resize(mPreset.taps + maxBlock + mFilterStride, channels);
+			reset();
+			return !mFilters.empty();
+		}
+
+		/**
+		 * @brief Clears out the history without recalculating the filters
+		 */
+		void reset() {
+			// 0 is important since the padding past mFill is read too
+			mHistory.set(T(0));
+			// Start with a full history so the latency is exactly half the filter
+			mFill = mPreset.taps - 1;
+			mTime = 0;
+		}
+
+		/**
+		 * @brief Resamples all of in, out needs to be large enough for the result
+		 *        or the rest of the input is lost, @see calculateBufferSize()
+		 */
+		Size process(const Buffer& in, Buffer& out) override {
+			Size consumed = 0;
+			const Size emitted = process(in, out, consumed);
+			TKLB_ASSERT(consumed == in.validSize()) // ! out was too small, input was dropped
+			return emitted;
+		}
+
+		/**
+		 * @brief Resamples until in is used up or out is full.
+		 *        Blocks larger than maxBlock are processed in several steps.
+		 * @param consumed Receives the number of input samples used, smaller than
+		 *        in.validSize() when out ran full. The rest has to be passed in again.
+		 * @return Size Number of samples written to out
+		 */
+		Size process(const Buffer& in, Buffer& out, Size& consumed) {
+			TKLB_ASSERT(in.sampleRate == mRateIn);
+			TKLB_ASSERT(out.sampleRate == mRateOut);
+			TKLB_ASSERT(in.channels() <= mHistory.channels())
+
+			const Size countIn = in.validSize();
+			const Size taps = mPreset.taps;
+			const Size capacity = taps + mMaxBlock;
+			const Channel channels = min(in.channels(), mHistory.channels());
+			Size emitted = 0;
+			consumed = 0;
+
+			while (true) {
+				// Samples left from a call which ran out of space come first
+				// All channels advance in lock step
+				double time = mTime;
+				Size produced = 0;
+				for (Channel c = 0; c < channels; c++) {
+					const T* source = mHistory[c];
+					T* target = out[c] + emitted;
+					const Size space = out.size() - emitted;
+					time = mTime;
+					produced = 0;
+					while (Size(time) + taps <= mFill && produced < space) {
+						const Size index = Size(time);
+						const double position = (time - double(index)) * double(mPreset.filters);
+						const Size filter = Size(position);
+						T sample = convolve(source + index, filter);
+						if (mPreset.interpolate) {
+							const T next = convolve(source + index, filter + 1);
+							sample += T(position - double(filter)) * (next - sample);
+						}
+						target[produced] = sample;
+						produced++;
+						time += mFactor;
+					}
+				}
+				emitted += produced;
+				mTime = time;
+
+				// Move the samples still needed to the start
+				const Size start = min(Size(mTime), mFill);
+				if (0 < start) {
+					for (Channel c = 0; c < channels; c++) {
+						T* history = mHistory[c];
+						// Overlapping, so no memory::copy
+						for (Size i = start; i < mFill; i++) {
+							history[i - start] = history[i];
+						}
+					}
+					mFill -= start;
+					mTime -= double(start);
+				}
+
+				if (consumed == countIn) { break; }
+				// The history only stays full when out has no space left
+				const Size chunk = min(countIn - consumed, capacity - mFill);
+				if (chunk == 0) { break; }
+				for (Channel c = 0; c < channels; c++) {
+					memory::copy(mHistory[c] + mFill, in[c] + consumed, sizeof(T) * chunk);
+				}
+				mFill += chunk;
+				consumed += chunk;
+			}
+
+			out.setValidSize(emitted);
+			return emitted;
+		}
+
+		/**
+		 * @brief Get the latency in input samples, half the filter length.
+		 *        resample() compensates for it.
+		 */
+		Size getLatency() const override { return mPreset.taps / 2; }
+
+		Size estimateNeed(const Size out) const override {
+			return Size(tklb::round(out * mFactor));
+		}
+
+		Size estimateOut(const Size in) const override {
+			return Size(tklb::round(in * (double(mRateOut) / double(mRateIn))));
+		}
+
+		bool isInitialized() const override { return !mFilters.empty(); }
+
+		/**
+		 * @brief Calculate a buffersize fit for the resampled result.
+		 * Also adds a bit of padding.
+		 */
+		Size calculateBufferSize(Size initialSize) const override {
+			return estimateOut(initialSize) + 10;
+		}
+
+		/**
+		 * @brief Memory used by the filter tables in bytes
+		 */
+		Size filterMemory() const { return mFilters.allocated(); }
+
+		/**
+		 * @brief Resamples the provided buffer from its sampleRate
+		 * to the target rate
+		 * @param buffer Audiobuffer to resample, set the rate of the buffer object
+		 * @param rateOut Desired output samplerate in Hz
+		 * @param quality Quality from 0-10
+		 */
+		static void resample(Buffer& buffer, const Size rateOut, const Size quality = 5) {
+			const Size rateIn = buffer.sampleRate;
+			const Size samples = buffer.validSize();
+			TKLB_ASSERT(rateIn > 0)
+			if (samples == 0) {
+				buffer.sampleRate = rateOut;
+				return;
+			}
+
+			ResamplerDbryTpl resampler;
+			const Size latency = getPreset(quality).taps / 2;
+			resampler.init(rateIn, rateOut, samples + latency, buffer.channels(), quality);
+
+			// Pad the end with silence so the filter reaches the last samples
+			Buffer copy;
+			copy.resize(samples + latency, buffer.channels());
+			copy.set(T(0));
+			copy.set(buffer, samples);
+			copy.sampleRate = rateIn;
+			copy.setValidSize(samples + latency);
+
+			// Start reading the history where the first input sample is centered in the filter
+			resampler.mTime = double(latency);
+
+			buffer.sampleRate = rateOut;
+			buffer.resize(resampler.calculateBufferSize(samples));
+			Size consumed = 0; // Stopping early is fine, the padding isn't needed once out is full
+			const Size emitted = resampler.process(copy, buffer, consumed);
+			buffer.setValidSize(min(emitted, resampler.estimateOut(samples)));
+		}
+	};
+
+	// Default type
+	#ifdef TKLB_SAMPLE_FLOAT
+		using ResamplerDbry = ResamplerDbryTpl<float>;
+	#else
+		using ResamplerDbry = ResamplerDbryTpl<double>;
+	#endif
+
+} // namespace
+
+#endif // _TKLB_RESAMPLER_DBRY
@@ -0,0 +1,558 @@
+/**
+ * @file TAsyncLogger.hpp
+ * @brief Moves formatting and printing of log messages to a background thread
+ * @details
+ * Enabled with TKLB_ASYNC_LOG, the TKLB_ERROR etc. macros then go through AsyncLogger::log.
+ * Nothing changes until AsyncLogger::start() is called, the messages are printed
+ * synchronously like before.
+ */
+
+#ifndef _TKLB_ASYNC_LOGGER
+#define _TKLB_ASYNC_LOGGER
+
+#include "./TLogger.hpp"
+
+#if defined(TKLB_ASYNC_LOG) && !defined(TKLB_NO_STDLIB) && !defined(TKLB_NO_LOG)
+
+#include "../types/TTypes.hpp"
+
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <new>
+#include <type_traits>
+
+namespace tklb {
+	/**
+	 * @brief Logger which only copies the format pointer and the arguments at the call site.
+	 * @details Each thread claims a ring of fixed size records on its first message, there's
+	 *          only ever one writer and the background thread as reader per ring, so pushing
+	 *          is wait free. A record holds up to MaxArguments arguments, strings are copied
+	 *          into it as well up to TextSize bytes total. The background thread formats
+	 *          the records with stb_sprintf and hands them to tklb_print.
+	 *
+	 *          A call never allocates, locks or waits. When the ring is full or no ring
+	 *          was left for the thread the message is dropped and counted instead.
+	 *          The format string and path need to outlive the message, which literals
+	 *          and __FILE__ do. Messages of different threads may be printed out of order.
+	 *
+	 *          The rings are allocated with plain new since the memory layer logs itself.
+	 */
+	class AsyncLogger {
+	public:
+		using Size = SizeT;
+		static constexpr Size MaxArguments = 8;
+		static constexpr Size TextSize = 128;		///< Bytes for copies of string arguments per record
+		static constexpr int BufferSize = 1024;		///< Formatted messages are truncated to this
+
+		struct Options {
+			Size threads = 8;		///< Threads which can have a ring at the same time
+			Size records = 128;		///< Records per ring, rounded up to a power of two
+			Size interval = 2;		///< Milliseconds the background thread sleeps when idle
+		};
+
+		struct Stats {
+			Size written = 0;		///< Messages printed by the background thread
+			Size dropped = 0;		///< Messages lost because the ring of the thread was full
+			Size unclaimed = 0;		///< Messages lost because there was no ring left for the thread
+			Size truncated = 0;		///< Messages with arguments or strings cut off
+			Size claimed = 0;		///< Rings currently taken by a thread
+		};
+
+	private:
+		enum class Type : unsigned char {
+			Int = 0,
+			Unsigned,
+			Double,
+			String,		///< Copied into Record::text
+			Pointer,
+			Unknown		///< Not something printf takes
+		};
+
+		template<Type K>
+		using Tag = std::integral_constant<Type, K>;
+
+		union Value {
+			long long i;
+			unsigned long long u;
+			double d;
+			const void* p;
+			Size offset;	///< Of a string in Record::text
+		};
+
+		struct Record {
+			const char* path;
+			const char* format;
+			int level;
+			int line;
+			unsigned char count;		///< Number of arguments
+			unsigned char used;			///< Bytes of text used
+			bool truncated;
+			Type types[MaxArguments];
+			Value values[MaxArguments];
+			char text[TextSize];
+		};
+
+		enum Owner : int {
+			Free = 0,
+			Owned,
+			Orphaned		///< Thread exited, gets freed once the background thread emptied it
+		};
+
+		struct Ring {
+			std::atomic<Size> head = { 0 };		///< Only written by the owning thread
+			char padHead[64];
+			std::atomic<Size> tail = { 0 };		///< Only written by the background thread
+			char padTail[64];
+			std::atomic<int> owner = { Free };
+			Record* records = nullptr;
+		};
+
+		struct State {
+			Ring* rings = nullptr;
+			Record* records = nullptr;
+			Size threads = 0;
+			Size mask = 0;					///< Records per ring - 1
+			Size interval = 0;
+			std::thread* worker = nullptr;
+			std::atomic<bool> running = { false };
+			std::atomic<Size> generation = { 0 };	///< Bumped on start and stop so threads don't keep stale rings
+			std::atomic<Size> written = { 0 };
+			std::atomic<Size> dropped = { 0 };
+			std::atomic<Size> unclaimed = { 0 };
+			std::atomic<Size> truncated = { 0 };
+		};
+
+		/**
+		 * @brief Ring of the calling thread, handed back when the thread exits
+		 */
+		struct Local {
+			Ring* ring = nullptr;
+			Size generation = 0;
+			~Local() {
+				if (ring != nullptr && generation == state().generation.load(std::memory_order_acquire)) {
+					ring->owner.store(Orphaned, std::memory_order_release);
+				}
+			}
+		};
+
+		static State& state() {
+			static State instance;
+			return instance;
+		}
+
+		static Local& local() {
+			static thread_local Local instance;
+			return instance;
+		}
+
+		/**
+		 * @brief Ring of the calling thread, claims a free one if needed
+		 * @return nullptr if all are taken
+		 */
+		static Ring* ring(State& s) {
+			Local& l = local();
+			const Size generation = s.generation.load(std::memory_order_acquire);
+			if (l.ring != nullptr && l.generation == generation) { return l.ring; }
+			l.ring = nullptr;
+			for (Size i = 0; i < s.threads; i++) {
+				int expected = Free;
+				if (s.rings[i].owner.compare_exchange_strong(expected, Owned, std::memory_order_acq_rel)) {
+					l.ring = s.rings + i;
+					l.generation = generation;
+					break;
+				}
+			}
+			return l.ring;
+		}
+
+		template<typename T>
+		static constexpr Type kind() {
+			using D = typename std::decay<T>::type;
+			using Pointee = typename std::remove_cv<typename std::remove_pointer<D>::type>::type;
+			return std::is_floating_point<D>::value ? Type::Double
+				: std::is_enum<D>::value ? Type::Int
+				: std::is_integral<D>::value ? (std::is_signed<D>::value ? Type::Int : Type::Unsigned)
+				: std::is_pointer<D>::value ? (std::is_same<Pointee, char>::value ? Type::String : Type::Pointer)
+				: Type::Unknown;
+		}
+
+		template<typename T>
+		static void store(Record&, Value& value, const T& arg, Tag<Type::Int>) { value.i = (long long) arg; }
+
+		template<typename T>
+		static void store(Record&, Value& value, const T& arg, Tag<Type::Unsigned>) { value.u = (unsigned long long) arg; }
+
+		template<typename T>
+		static void store(Record&, Value& value, const T& arg, Tag<Type::Double>) { value.d = double(arg); }
+
+		template<typename T>
+		static void store(Record&, Value& value, const T& arg, Tag<Type::Pointer>) { value.p = (const void*) arg; }
+
+		template<typename T>
+		static void store(Record&, Value& value, const T&, Tag<Type::Unknown>) { value.u = 0; }
+
+		/**
+		 * @brief Copies the string into the record, the last byte of text is always a terminator
+		 */
+		static void store(Record& record, Value& value, const char* arg, Tag<Type::String>) {
+			if (arg == nullptr) { arg = "(null)"; }
+			if (record.used == TextSize) {
+				value.offset = TextSize - 1;
+				record.truncated = true;
+				return;
+			}
+			value.offset = record.used;
+			while (*arg != '\0') {
+				if (record.used == TextSize - 1) {
+					record.truncated = true;
+					break;
+				}
+				record.text[record.used++] = *arg++;
+			}
+			record.text[record.used++] = '\0';
+		}
+
+		static void capture(Record&) { }
+
+		template<typename T, typename... Rest>
+		static void capture(Record& record, const T& arg, const Rest&... rest) {
+			if (record.count == MaxArguments) {
+				record.truncated = true;
+				return;
+			}
+			constexpr Type type = kind<T>();
+			record.types[record.count] = type;
+			store(record, record.values[record.count], arg, Tag<type>());
+			record.count++;
+			capture(record, rest...);
+		}
+
+		static long long asInt(const Record& record, Size index) {
+			if (record.count <= index) { return 0; }
+			const Value& value = record.values[index];
+			switch (record.types[index]) {
+				case Type::Int:		return value.i;
+				case Type::Unsigned: return (long long) value.u;
+				case Type::Double:	return (long long) value.d;
+				case Type::Pointer:	return (long long) value.p;
+				default:			return 0;
+			}
+		}
+
+		static double asDouble(const Record& record, Size index) {
+			if (record.count <= index) { return 0; }
+			const Value& value = record.values[index];
+			switch (record.types[index]) {
+				case Type::Int:		return double(value.i);
+				case Type::Unsigned: return double(value.u);
+				case Type::Double:	return value.d;
+				default:			return 0;
+			}
+		}
+
+		static const char* asString(const Record& record, Size index) {
+			if (record.count <= index) { return ""; }
+			if (record.types[index] != Type::String) { return "?"; }
+			return record.text + record.values[index].offset;
+		}
+
+		static const void* asPointer(const Record& record, Size index) {
+			if (record.count <= index) { return nullptr; }
+			if (record.types[index] == Type::Pointer) { return record.values[index].p; }
+			return (const void*) asInt(record, index);
+		}
+
+		/**
+		 * @brief Formats the record by handing each conversion to stb_sprintf
+		 *        with the argument converted to what the conversion expects
+		 * @return int Length of the message
+		 */
+		static int format(const Record& record, char* out, int size) {
+			int length = 0;
+			Size argument = 0;
+			const char* it = record.format;
+			while (*it != '\0' && length < size - 1) {
+				if (*it != '%') {
+					out[length++] = *it++;
+					continue;
+				}
+				if (it[1] == '%') {
+					out[length++] = '%';
+					it += 2;
+					continue;
+				}
+
+				// Rebuild the conversion without the length modifier
+				char spec[48];
+				int s = 0;
+				spec[s++] = *it++;
+				while (*it == '-' || *it == '+' || *it == ' ' || *it == '#' || *it == '0' || *it == '\'') {
+					if (s < 8) { spec[s++] = *it; }
+					it++;
+				}
+				if (*it == '*') {
+					s += stbsp_snprintf(spec + s, 12, "%i", int(asInt(record, argument++)));
+					it++;
+				}
+				while ('0' <= *it && *it <= '9') {
+					if (s < 20) { spec[s++] = *it; }
+					it++;
+				}
+				if (*it == '.') {
+					it++;
+					if (*it == '*') {
+						const int precision = int(asInt(record, argument++));
+						if (0 <= precision) { s += stbsp_snprintf(spec + s, 13, ".%i", precision); }
+						it++;
+					} else {
+						spec[s++] = '.';
+					}
+					while ('0' <= *it && *it <= '9') {
+						if (s < 34) { spec[s++] = *it; }
+						it++;
+					}
+				}
+				while (*it == 'h' || *it == 'l' || *it == 'L' || *it == 'q' || *it == 'j' || *it == 'z' || *it == 't') { it++; }
+				const char conversion = *it;
+				if (conversion == '\0') { break; }
+				it++;
+
+				int written = 0;
+				char* cursor = out + length;
+				const int left = size - length;
+				switch (conversion) {
+					case 'd': case 'i':
+						spec[s++] = 'l'; spec[s++] = 'l'; spec[s++] = conversion; spec[s] = '\0';
+						written = stbsp_snprintf(cursor, left, spec, asInt(record, argument++));
+						break;
+					case 'u': case 'o': case 'x': case 'X': case 'b': case 'B':
+						spec[s++] = 'l'; spec[s++] = 'l'; spec[s++] = conversion; spec[s] = '\0';
+						written = stbsp_snprintf(cursor, left, spec, (unsigned long long) asInt(record, argument++));
+						break;
+					case 'c':
+						spec[s++] = conversion; spec[s] = '\0';
+						written = stbsp_snprintf(cursor, left, spec, int(asInt(record, argument++)));
+						break;
+					case 'f': case 'F': case 'e': case 'E': case 'g': case 'G': case 'a': case 'A':
+						spec[s++] = conversion; spec[s] = '\0';
+						written = stbsp_snprintf(cursor, left, spec, asDouble(record, argument++));
+						break;
+					case 's':
+						spec[s++] = conversion; spec[s] = '\0';
+						written = stbsp_snprintf(cursor, left, spec, asString(record, argument++));
+						break;
+					case 'p':
+						spec[s++] = conversion; spec[s] = '\0';
+						written = stbsp_snprintf(cursor, left, spec, asPointer(record, argument++));
+						break;
+					default: // %n and unknown conversions print nothing
+						argument++;
+						break;
+				}
+				length += (written < left - 1) ? written : left - 1;
+			}
+			out[length] = '\0';
+			return length;
+		}
+
+		static void print(const Record& record, char* buffer) {
+			// Strip away the path and only keep the file name
+			const char* file = record.path;
+			for (const char* it = record.path; *it != '\0'; it++) {
+				if (*it == '\\' || *it == '/') { file = it + 1; }
+			}
+			const char* level = "";
+			switch (record.level) {
+				case 0:	level = "DEBUG"; break;
+				case 1:	level = " INFO"; break;
+				case 2:	level = " WARN"; break;
+				case 3:	level = "ERROR"; break;
+				case 4:	level = " CRIT"; break;
+				default: break;
+			}
+			int length = stbsp_snprintf(buffer, BufferSize, "%s | %s:%i \t| ", level, file, record.line);
+			if (BufferSize - 1 < length) { length = BufferSize - 1; }
+			length += format(record, buffer + length, BufferSize - length);
+			tklb_print(record.level, buffer);
+			#ifdef TKLB_PROFILER_MESSAGE
+				TKLB_PROFILER_MESSAGE(buffer, length)
+			#else
+				(void)(length);
+			#endif
+		}
+
+		/**
+		 * @brief Prints everything pushed so far, only called by one thread at a time
+		 * @return Size Number of messages printed
+		 */
+		static Size drain(State& s) {
+			char buffer[BufferSize];
+			Size written = 0;
+			for (Size i = 0; i < s.threads; i++) {
+				Ring& ring = s.rings[i];
+				const int owner = ring.owner.load(std::memory_order_acquire);
+				if (owner == Free) { continue; }
+				Size tail = ring.tail.load(std::memory_order_relaxed);
+				const Size head = ring.head.load(std::memory_order_acquire);
+				for (; tail != head; tail++) {
+					print(ring.records[tail & s.mask], buffer);
+					ring.tail.store(tail + 1, std::memory_order_release);
+					written++;
+				}
+				// The thread is gone, so nothing was pushed since
+				if (owner == Orphaned) { ring.owner.store(Free, std::memory_order_release); }
+			}
+			s.written.fetch_add(written, std::memory_order_relaxed);
+			return written;
+		}
+
+		static void run() {
+			State& s = state();
+			while (s.running.load(std::memory_order_acquire)) {
+				if (drain(s) == 0) {
+					std::this_thread::sleep_for(std::chrono::milliseconds(s.interval));
+				}
+			}
+		}
+
+		static bool empty(State& s) {
+			for (Size i = 0; i < s.threads; i++) {
+				const Ring& ring = s.rings[i];
+				if (ring.head.load(std::memory_order_acquire) != ring.tail.load(std::memory_order_acquire)) {
+					return false;
+				}
+			}
+			return true;
+		}
+
+	public:
+		/**
+		 * @brief Allocates the rings and starts the background thread.
+		 *        Not thread safe, call it before other threads log.
+		 * @return false if already running or the allocation failed
+		 */
+		static bool start(const Options& options) {
+			State& s = state();
+			if (s.running || options.threads == 0) { return false; }
+			Size records = 1;
+			while (records < options.records) { records *= 2; }
+			s.rings = new (std::nothrow) Ring[options.threads];
+			s.records = new (std::nothrow) Record[options.threads * records];
+			if (s.rings == nullptr || s.records == nullptr) {
+				delete[] s.rings;
+				delete[] s.records;
+				s.rings = nullptr;
+				s.records = nullptr;
+				return false;
+			}
+			for (Size i = 0; i < options.threads; i++) {
+				s.rings[i].records = s.records + i * records;
+			}
+			s.threads = options.threads;
+			s.mask = records - 1;
+			s.interval = options.interval;
+			s.generation++;
+			s.running.store(true, std::memory_order_release);
+			s.worker = new std::thread(&AsyncLogger::run);
+			return true;
+		}
+
+		static bool start() { return start(Options()); }
+
+		/**
+		 * @brief Prints the remaining messages, stops the thread and frees the rings.
+		 *        Not thread safe, no other thread may log while this runs.
+		 */
+		static void stop() {
+			State& s = state();
+			if (!s.running) { return; }
+			s.running.store(false, std::memory_order_release);
+			s.worker->join();
+			delete s.worker;
+			s.worker = nullptr;
+			drain(s);
+			s.generation++;
+			delete[] s.rings;
+			delete[] s.records;
+			s.rings = nullptr;
+			s.records = nullptr;
+			s.threads = 0;
+		}
+
+		static bool running() { return state().running.load(std::memory_order_acquire); }
+
+		/**
+		 * @brief Waits until everything pushed so far is printed.
+		 *        Sleeps, so don't call it from a realtime thread.
+		 */
+		static void flush() {
+			State& s = state();
+			if (!running()) { return; }
+			while (!empty(s)) {
+				std::this_thread::sleep_for(std::chrono::milliseconds(1));
+			}
+		}
+
+		static Stats stats() {
+			const State& s = state();
+			Stats stats;
+			stats.written = s.written.load(std::memory_order_relaxed);
+			stats.dropped = s.dropped.load(std::memory_order_relaxed);
+			stats.unclaimed = s.unclaimed.load(std::memory_order_relaxed);
+			stats.truncated = s.truncated.load(std::memory_order_relaxed);
+			for (Size i = 0; i < s.threads; i++) {
+				if (s.rings[i].owner.load(std::memory_order_relaxed) != Free) { stats.claimed++; }
+			}
+			return stats;
+		}
+
+		static void resetStats() {
+			State& s = state();
+			s.written = 0;
+			s.dropped = 0;
+			s.unclaimed = 0;
+			s.truncated = 0;
+		}
+
+		/**
+		 * @brief Pushes the message to the ring of the calling thread,
+		 *        prints it right away with tklb_print_path if the logger isn't started.
+		 *        Costs a copy of the arguments and at most TextSize bytes of strings.
+		 */
+		template<typename... Args>
+		static void log(int level, const char* path, int line, const char* format, const Args&... args) {
+			if (path == nullptr || format == nullptr) { return; }
+			State& s = state();
+			if (!s.running.load(std::memory_order_acquire)) {
+				tklb_print_path(level, path, line, format, args...);
+				return;
+			}
+			Ring* r = ring(s);
+			if (r == nullptr) {
+				s.unclaimed.fetch_add(1, std::memory_order_relaxed);
+				return;
+			}
+			const Size head = r->head.load(std::memory_order_relaxed);
+			if (head - r->tail.load(std::memory_order_acquire) == s.mask + 1) {
+				s.dropped.fetch_add(1, std::memory_order_relaxed);
+				return;
+			}
+			Record& record = r->records[head & s.mask];
+			record.path = path;
+			record.format = format;
+			record.level = level;
+			record.line = line;
+			record.count = 0;
+			record.used = 0;
+			record.truncated = false;
+			capture(record, args...);
+			if (record.truncated) { s.truncated.fetch_add(1, std::memory_order_relaxed); }
+			r->head.store(head + 1, std::memory_order_release);
+		}
+	};
+} // namespace tklb
+
+#endif // TKLB_ASYNC_LOG
+
+#endif // _TKLB_ASYNC_LOGGER
@@ -6,6 +6,7 @@
  * Defining TKLB_NO_STDLIB or TKLB_CUSTOM_PRINT allows using custom print outlet
  * Defining TKLB_RELEASE will only log warnings and above
  * Defining TKLB_FORCE_LOG will override this
+ * Defining TKLB_ASYNC_LOG routes the macros through AsyncLogger, see TAsyncLogger.hpp
  * TODO mention profiler
  * TODO TKLB_NO_STDLIB handling
  * @version 0.1
@@ -31,6 +32,7 @@
 		#define STB_SPRINTF_IMPLEMENTATION
 	#endif
 	#include "../../external/stb_sprintf.h"
+	#include "../types/TSpinLock.hpp"
 
 	/**
 	 * @brief main logging function. This can be overridden by defining TKLB_CUSTOM_PRINT
@@ -65,13 +67,13 @@
 			if (format == nullptr) { return; }
 
 			constexpr int bufferSize = 1024;	// Should be plenty for most purposes, the formating respects this limit.
-			static bool locked = false;			// TODO TKLB properly protect multithread access
+			static tklb::SpinLock lock;			// Guards the buffers, the printing is still done inline
 			static char buffer[bufferSize];
 			static char buffer2[bufferSize];	// Need two buffers, could use a little optimization
 
 			{
 				// Strip away the path and only keep the file name
-				int lastDelimiter = 0;
+				int lastDelimiter = -1;
 
 				for (int i = 0; i < bufferSize; i++) {
 					if (path[i] == '\0') {
@@ -85,8 +87,7 @@
 				path += lastDelimiter + 1;
 			}
 
-			while(locked) { }
-			locked = true;
+			tklb::SpinLock::Lock guard(lock);
 
 			switch (level) {
 				case 0:	stbsp_snprintf(buffer, bufferSize, "DEBUG | %s:%i \t| %s", path, line, format); break;
@@ -109,23 +110,31 @@
 			#else
 				(void)(length);
 			#endif
-			locked = false;
 		}
 	#endif // TKLB_IMPL
 
+	// Where the macros end up, the async logger needs the types of the arguments
+	#if defined(TKLB_ASYNC_LOG) && !defined(TKLB_NO_STDLIB)
+		#define TKLB_LOG_PATH(level, path, line, ...) tklb::AsyncLogger::log(level, path, line, __VA_ARGS__)
+	#else
+		#define TKLB_LOG_PATH(level, path, line, ...) tklb_print_path(level, path, line, __VA_ARGS__)
+	#endif
+
 	// Always print errors and warnings
-	#define TKLB_CRITICAL(msg, ...)	tklb_print_path(4, __FILE__, __LINE__, msg, ## __VA_ARGS__);
-	#define TKLB_ERROR(msg, ...)	tklb_print_path(3, __FILE__, __LINE__, msg, ## __VA_ARGS__);
-	#define TKLB_WARN(msg, ...)		tklb_print_path(2, __FILE__, __LINE__, msg, ## __VA_ARGS__);
+	#define TKLB_CRITICAL(msg, ...)	TKLB_LOG_PATH(4, __FILE__, __LINE__, msg, ## __VA_ARGS__);
+	#define TKLB_ERROR(msg, ...)	TKLB_LOG_PATH(3, __FILE__, __LINE__, msg, ## __VA_ARGS__);
+	#define TKLB_WARN(msg, ...)		TKLB_LOG_PATH(2, __FILE__, __LINE__, msg, ## __VA_ARGS__);
 
 	// Only log these if explicitly requested or in debug mode.
 	#if !defined(TKLB_RELEASE) || defined(TKLB_FORCE_LOG)
-		#define TKLB_INFO(msg, ...)  tklb_print_path(1, __FILE__, __LINE__, msg, ## __VA_ARGS__);
-		#define TKLB_DEBUG(msg, ...) tklb_print_path(0, __FILE__, __LINE__, msg, ## __VA_ARGS__);
+		#define TKLB_INFO(msg, ...)  TKLB_LOG_PATH(1, __FILE__, __LINE__, msg, ## __VA_ARGS__);
+		#define TKLB_DEBUG(msg, ...) TKLB_LOG_PATH(0, __FILE__, __LINE__, msg, ## __VA_ARGS__);
 	#else
 		#define TKLB_INFO(...)
 		#define TKLB_DEBUG(...)
 	#endif
+
+	#include "./TAsyncLogger.hpp"
 #endif // TKLB_NO_LOG
 
 #endif // _TKLB_LOGGER
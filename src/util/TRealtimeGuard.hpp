@@ -0,0 +1,179 @@
+#ifndef _TKLB_REALTIME_GUARD
+#define _TKLB_REALTIME_GUARD
+
+#if defined(TKLB_REALTIME_GUARD) && !defined(TKLB_NO_STDLIB)
+
+#include "../types/TTypes.hpp"
+#include "./TThreadTag.hpp"
+#include "./TAssert.h"
+#include "./TLogger.hpp"
+
+#include <atomic>
+
+namespace tklb {
+	/**
+	 * @brief Debug sanitizer catching allocations, frees and blocking locks
+	 *        on realtime threads. Enabled with TKLB_REALTIME_GUARD.
+	 * @details A thread counts as realtime while it's tagged ThreadTag::Audio,
+	 *          e.g. by a RealtimeGuard::Scope around the audio callback.
+	 *          TKLB_MALLOC, TKLB_FREE, TKLB_NEW, TKLB_DELETE, the DefaultAllocator,
+	 *          Mutex::lock and the operators in TMemoryMonkeyPatch.hpp report here.
+	 *          Every violation is counted and remembered with its call site,
+	 *          setAction() decides whether it's also logged or asserted.
+	 *          The call site is the line of the hook: TKLB_MALLOC and friends
+	 *          report the line using them, but everything going through the
+	 *          DefaultAllocator, e.g. HeapBuffer and AudioBuffer, reports TAllocator.hpp,
+	 *          Mutex::lock TMutex.hpp and global new and delete TMemoryMonkeyPatch.hpp.
+	 *          The callstack of the Assert action shows the actual caller.
+	 */
+	class RealtimeGuard {
+	public:
+		using Size = SizeT;
+
+		enum class Violation {
+			Allocate = 0,
+			Free,
+			Lock,
+			Count
+		};
+
+		/**
+		 * @brief Flags, counting always happens
+		 */
+		enum Action {
+			CountOnly = 0,
+			Log = 1,
+			Assert = 2
+		};
+
+		struct Report {
+			Violation kind = Violation::Count;	///< Count if nothing happened yet
+			const char* file = nullptr;	///< File of the hook, not necessarily of the caller
+			int line = 0;
+		};
+
+		/**
+		 * @brief Marks the calling thread realtime for its lifetime
+		 */
+		class Scope {
+			ThreadTagScope mTag;
+		public:
+			Scope() : mTag(ThreadTag::Audio) { }
+		};
+
+		/**
+		 * @brief Allows violations on the calling thread for its lifetime,
+		 *        for the rare allocation which is known to be fine
+		 */
+		class Allow {
+			bool mPrevious;
+		public:
+			Allow() : mPrevious(allowed()) { allowed() = true; }
+			~Allow() { allowed() = mPrevious; }
+			Allow(const Allow&) = delete;
+			Allow& operator=(const Allow&) = delete;
+		};
+
+	private:
+		struct State {
+			std::atomic<int> action = { Assert | Log };
+			std::atomic<Size> counts[Size(Violation::Count)] = { };
+			std::atomic<int> lastKind = { int(Violation::Count) };
+			std::atomic<const char*> lastFile = { nullptr };
+			std::atomic<int> lastLine = { 0 };
+		};
+
+		static State& state() {
+			static State instance;
+			return instance;
+		}
+
+		static bool& allowed() {
+			static thread_local bool allow = false;
+			return allow;
+		}
+
+		static const char* name(Violation kind) {
+			switch (kind) {
+				case Violation::Allocate:	return "Allocation";
+				case Violation::Free:		return "Free";
+				case Violation::Lock:		return "Blocking lock";
+				default:					return "Violation";
+			}
+		}
+
+	public:
+		/**
+		 * @brief What to do on top of counting, defaults to Assert | Log
+		 */
+		static void setAction(int action) { state().action = action; }
+
+		/**
+		 * @brief Whether the calling thread is realtime and not allowed to violate
+		 */
+		static bool active() {
+			return ThreadTagScope::current() == ThreadTag::Audio && !allowed();
+		}
+
+		/**
+		 * @brief Called by the hooks, use TKLB_REALTIME_CHECK for the call site
+		 */
+		static void check(Violation kind, const char* file, int line) {
+			if (!active()) { return; }
+			State& s = state();
+			s.counts[Size(kind)].fetch_add(1, std::memory_order_relaxed);
+			s.lastKind = int(kind);
+			s.lastFile = file;
+			s.lastLine = line;
+			const int action = s.action;
+			Allow allow; // Logging or asserting might allocate itself
+			#ifndef TKLB_NO_LOG
+				if (action & Log) {
+					TKLB_LOG_PATH(3, file, line, "%s on a realtime thread", name(kind));
+				}
+			#endif
+			if (action & Assert) {
+				TKLB_ASSERT(false) // ! See the log or the callstack for the call site
+			}
+		}
+
+		static Size count(Violation kind) {
+			return state().counts[Size(kind)].load(std::memory_order_relaxed);
+		}
+
+		/**
+		 * @brief The most recent violation, the fields are updated one by one
+		 *        so they may be mixed up when several threads violate at once
+		 */
+		static Report last() {
+			State& s = state();
+			Report report;
+			report.kind = Violation(s.lastKind.load());
+			report.file = s.lastFile;
+			report.line = s.lastLine;
+			return report;
+		}
+
+		static void reset() {
+			State& s = state();
+			for (Size i = 0; i < Size(Violation::Count); i++) { s.counts[i] = 0; }
+			s.lastKind = int(Violation::Count);
+			s.lastFile = nullptr;
+			s.lastLine = 0;
+		}
+	};
+
+} // namespace tklb
+
+/**
+ * @brief Reports a violation of the kind with the call site
+ */
+#define TKLB_REALTIME_CHECK(kind) tklb::RealtimeGuard::check(tklb::RealtimeGuard::Violation::kind, __FILE__, __LINE__)
+
+#else // TKLB_REALTIME_GUARD
+
+#define TKLB_REALTIME_CHECK(kind) ((void) 0)
+
+#endif // TKLB_REALTIME_GUARD
+
+#endif // _TKLB_REALTIME_GUARD
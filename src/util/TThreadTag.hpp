@@ -0,0 +1,42 @@
+#ifndef _TKLB_THREAD_TAG
+#define _TKLB_THREAD_TAG
+
+namespace tklb {
+	/**
+	 * @brief What a thread is used for, set once by the thread itself.
+	 *        Allocation statistics use it to single out the audio thread.
+	 */
+	enum class ThreadTag {
+		None = 0,	///< Untagged, the default for every thread
+		Audio,		///< Realtime audio callback
+		Worker,		///< Streaming, decoding and other background work
+		Ui			///< Control and user interface
+	};
+
+	/**
+	 * @brief Tags the calling thread for its lifetime,
+	 *        restores the previous tag afterwards
+	 */
+	class ThreadTagScope {
+		ThreadTag mPrevious;
+
+		static ThreadTag& local() {
+			static thread_local ThreadTag tag = ThreadTag::None;
+			return tag;
+		}
+
+	public:
+		ThreadTagScope(ThreadTag tag) : mPrevious(local()) { local() = tag; }
+		~ThreadTagScope() { local() = mPrevious; }
+		ThreadTagScope(const ThreadTagScope&) = delete;
+		ThreadTagScope& operator=(const ThreadTagScope&) = delete;
+
+		/**
+		 * @brief Tag of the calling thread
+		 */
+		static ThreadTag current() { return local(); }
+	};
+
+} // namespace tklb
+
+#endif // _TKLB_THREAD_TAG
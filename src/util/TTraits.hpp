@@ -127,6 +127,28 @@ namespace tklb { namespace traits {
 	template<typename T>
 	struct removeReference<T&&> { typedef T type; };
 
+	/**
+	 * @brief Whether T can be copied with memcpy, uses the compiler builtin
+	 *        since it can't be implemented in plain C++
+	 */
+	template<typename T>
+	struct IsTriviallyCopyable : Value<__is_trivially_copyable(T)> { };
+
+	/**
+	 * @brief Whether T can be constructed from an rvalue, uses the compiler builtin
+	 */
+	template<typename T>
+	struct IsMoveConstructible : Value<__is_constructible(T, T&&)> { };
+
+	/**
+	 * @brief Whether T can be moved to another address with memcpy, leaving nothing to destroy
+	 *        at the old one. Containers use it to skip move constructors and destructors.
+	 *        True for trivially copyable types, specialize it for types which only point
+	 *        to memory elsewhere and never to themselves.
+	 */
+	template<typename T>
+	struct IsTriviallyRelocatable : IsTriviallyCopyable<T> { };
+
 	/**
 	 * @brief Reimplementation od the std::move
 	 */
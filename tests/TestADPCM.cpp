@@ -0,0 +1,170 @@
+#include "./TestCommon.hpp"
+
+#include "../src/types/audio/codec/TADPCM.hpp"
+#include "../src/types/audio/codec/TWave.hpp"
+
+using Sample = tklb::AudioBuffer::Sample;
+using Codec = tklb::ADPCMCodec;
+
+/**
+ * Hides the memory so the codec has to read block by block
+ */
+struct StreamSource : public tklb::MemorySource {
+	using tklb::MemorySource::MemorySource;
+	tklb::SizeT size() const override { return 0; }
+	const void* data() const override { return nullptr; }
+};
+
+int compare(const tklb::AudioBuffer& a, const tklb::AudioBuffer& b, int offset, int length, float tolerance) {
+	for (int c = 0; c < a.channels(); c++) {
+		for (int i = 0; i < length; i++) {
+			if (!close(a[c][i], b[c][offset + i], tolerance)) { return 1; }
+		}
+	}
+	return 0;
+}
+
+int test() {
+	const int length = 10000; // partial last block
+	const int channels = 3;
+	const int block = 777;
+
+	tklb::AudioBuffer reference;
+	reference.resize(length, channels);
+	reference.sampleRate = 44100;
+	for (int c = 0; c < channels; c++) {
+		for (int i = 0; i < length; i++) {
+			reference[c][i] = tklb::sin(i * (c + 1) * 0.01) * 0.5;
+		}
+	}
+
+	tklb::HeapBuffer<char> file;
+	{
+		// Encode in chunks not aligned to the blocks
+		tklb::HeapBufferSink sink(file);
+		Codec codec;
+		if (codec.create(sink, reference.sampleRate, channels) != Codec::Result::Success) { return 1; }
+		tklb::AudioBuffer chunk;
+		chunk.resize(block, channels);
+		for (int i = 0; i < length; i += block) {
+			const int count = tklb::min(block, length - i);
+			chunk.set(reference, count, i);
+			chunk.setValidSize(count);
+			if (codec.write(chunk) != Codec::Result::Success) { return 2; }
+		}
+		if (codec.close() != Codec::Result::Success) { return 3; }
+	}
+	// 4 bits per sample plus block headers and padding
+	if (file.size() > length * channels / 2 + 2048) { return 4; }
+
+	tklb::AudioBuffer decoded;
+	if (!tklb::adpcm::load<Sample>(file.data(), file.size(), decoded)) { return 5; }
+	if (decoded.validSize() != length || decoded.channels() != channels) { return 6; }
+	returnNonZero(compare(decoded, reference, 0, length, 0.01) * 7)
+
+	{
+		// Other decoders need to understand the files too, dr_wav only supports stereo
+		tklb::AudioBuffer stereo;
+		stereo.resize(length, 2);
+		stereo.sampleRate = reference.sampleRate;
+		stereo.set(reference);
+		tklb::HeapBuffer<char> stereoFile;
+		if (!tklb::adpcm::write<Sample>(stereo, stereoFile)) { return 8; }
+		tklb::AudioBuffer ours, wave;
+		tklb::Wave wav;
+		if (!tklb::adpcm::load<Sample>(stereoFile.data(), stereoFile.size(), ours)) { return 8; }
+		if (!wav.load<Sample>(stereoFile.data(), stereoFile.size(), wave)) { return 9; }
+		if (wave.validSize() < length) { return 9; } // dr_wav ignores the fact chunk and decodes the padding
+		returnNonZero(compare(wave, ours, 0, length, 0.0001) * 10)
+	}
+
+	tklb::MemorySource memory(file.data(), file.size());
+	StreamSource stream(file.data(), file.size());
+	tklb::ICodecSource* sources[] = { &memory, &stream };
+
+	for (auto source : sources) {
+		Codec codec;
+		if (codec.open(*source) != Codec::Result::Success) { return 11; }
+		if (codec.length() != length || codec.sampleRate() != 44100) { return 12; }
+
+		tklb::AudioBuffer chunk;
+		int read = 0;
+		while (true) {
+			const int got = codec.read(block, chunk);
+			if (got == 0) { break; }
+			returnNonZero(compare(chunk, decoded, read, got, 0.000001) * 13)
+			read += got;
+		}
+		if (read != length) { return 14; }
+
+		// Sample accurate scrubbing, across blocks too
+		const int blockLength = codec.blockSamples();
+		const int positions[] = { 9000, 17, blockLength, blockLength - 5, 0, length - 10, length };
+		for (int position : positions) {
+			if (codec.scrub(position) != Codec::Result::Success) { return 15; }
+			const int got = codec.read(block, chunk);
+			if (got != tklb::min(block, length - position)) { return 16; }
+			returnNonZero(compare(chunk, decoded, position, got, 0.000001) * 17)
+		}
+		if (codec.scrub(length + 1) != Codec::Result::OutOfRange) { return 18; }
+	}
+
+	{
+		// Blocks can be decoded on their own
+		Codec codec;
+		if (codec.open(memory) != Codec::Result::Success) { return 19; }
+		const int blockLength = codec.blockSamples();
+		tklb::AudioBuffer out;
+		out.resize(blockLength, channels);
+		Sample* raw[channels];
+		out.getRaw(raw);
+		const char* second = file.data() + Codec::HeaderSize + codec.blockAlign();
+		tklb::adpcm::decodeBlock(second, channels, raw, blockLength);
+		returnNonZero(compare(out, decoded, blockLength, blockLength, 0.000001) * 20)
+	}
+
+	{
+		// Without a fact chunk a cut off block only decodes whole groups of 4 bytes per channel
+		Codec codec;
+		if (codec.open(memory) != Codec::Result::Success) { return 21; }
+		const int blockLength = codec.blockSamples();
+		const int extra = (tklb::adpcm::ChannelHeaderSize + 4 * 2) * channels - 1;
+		tklb::HeapBuffer<char> truncated;
+		truncated.set(file.data(), Codec::HeaderSize + codec.blockAlign() + extra);
+		truncated[40] = 'x';
+		tklb::MemorySource source(truncated.data(), truncated.size());
+		tklb::AudioBuffer out;
+		if (!tklb::adpcm::load<Sample>(source, out)) { return 21; }
+		if (int(out.validSize()) != blockLength + 9) { return 22; }
+		returnNonZero(compare(out, decoded, 0, blockLength + 9, 0.000001) * 23)
+	}
+
+	{
+		// More blocks than the fact chunk says are ignored
+		Codec codec;
+		if (codec.open(memory) != Codec::Result::Success) { return 24; }
+		const int blockLength = codec.blockSamples();
+		tklb::HeapBuffer<char> oversized;
+		oversized.set(file.data(), file.size());
+		tklb::adpcm::writeU32(blockLength, reinterpret_cast<unsigned char*>(oversized.data()) + 48);
+		tklb::MemorySource oversizedMemory(oversized.data(), oversized.size());
+		StreamSource oversizedStream(oversized.data(), oversized.size());
+		tklb::ICodecSource* oversizedSources[] = { &oversizedMemory, &oversizedStream };
+		for (auto source : oversizedSources) {
+			Codec cut;
+			if (cut.open(*source) != Codec::Result::Success) { return 24; }
+			tklb::AudioBuffer chunk;
+			int read = 0;
+			while (true) {
+				const int got = cut.read(block, chunk);
+				if (got == 0) { break; }
+				read += got;
+			}
+			if (read != blockLength) { return 25; }
+			if (cut.scrub(blockLength) != Codec::Result::Success) { return 26; }
+			if (cut.read(block, chunk) != 0) { return 26; }
+		}
+	}
+
+	return 0;
+}
@@ -0,0 +1,108 @@
+#define TKLB_ALLOC_STATS
+#include "./TestCommon.hpp"
+#include "../src/memory/TAllocator.hpp"
+#include "../src/memory/TSlabPool.hpp"
+#include "../src/types/THeapBuffer.hpp"
+
+#include <thread>
+#include <atomic>
+#include <cstring>
+
+using AllocStats = tklb::memory::AllocStats;
+
+struct VoiceName { static constexpr const char* Name = "Voices"; };
+struct SameName { static constexpr const char* Name = "Voices"; };
+struct ThreadedName { static constexpr const char* Name = "Threaded"; };
+
+int test() {
+	{
+		tklb::HeapBuffer<float, 0, tklb::DefaultAllocator<unsigned char, VoiceName>> buffer;
+		buffer.resize(1000);
+		auto stats = AllocStats::of<VoiceName>().snapshot();
+		if (std::strcmp(stats.name, "Voices") != 0) { return 1; }
+		if (stats.allocations != 1 || stats.bytes != buffer.allocated()) { return 2; }
+		if (stats.histogram[11] != 1) { return 3; } // 4032 bytes are in [2048, 4096)
+
+		buffer.resize(2000);
+		stats = AllocStats::of<VoiceName>().snapshot();
+		if (stats.allocations != 2 || stats.frees != 1) { return 4; }
+		if (stats.bytes != buffer.allocated()) { return 5; }
+		const auto peak = stats.peak;
+
+		buffer.resize(0);
+		stats = AllocStats::of<VoiceName>().snapshot();
+		if (stats.bytes != 0 || stats.outstanding() != 0 || stats.peak != peak) { return 6; }
+		if (stats.audioAllocations != 0) { return 7; }
+
+		// Names are matched by content
+		if (&AllocStats::of<SameName>() != &AllocStats::of<VoiceName>()) { return 8; }
+	}
+
+	{
+		// Allocations from the audio thread are counted separately
+		tklb::ThreadTagScope tag(tklb::ThreadTag::Audio);
+		tklb::DefaultAllocator<float, VoiceName> allocator;
+		float* ptr = allocator.allocate(10);
+		allocator.deallocate(ptr, 10);
+		auto stats = AllocStats::of<VoiceName>().snapshot();
+		if (stats.audioAllocations != 1 || stats.audioFrees != 1) { return 9; }
+	}
+	if (tklb::ThreadTagScope::current() != tklb::ThreadTag::None) { return 10; }
+
+	{
+		// Many threads allocating while another one watches,
+		// the slab pool since the test pool isn't thread safe
+		constexpr int Threads = 4;
+		constexpr int Rounds = 2000;
+		std::atomic<bool> done = { false };
+		int snapshots = 0;
+		bool consistent = true;
+		std::thread monitor([&]() {
+			AllocStats::Snapshot all[AllocStats::MaxNames + 1];
+			while (!done) {
+				const auto count = AllocStats::snapshot(all, AllocStats::MaxNames + 1);
+				for (tklb::SizeT i = 0; i < count; i++) {
+					if (all[i].name == nullptr) { consistent = false; }
+				}
+				snapshots++;
+			}
+		});
+		std::thread threads[Threads];
+		for (int t = 0; t < Threads; t++) {
+			threads[t] = std::thread([t]() {
+				tklb::memory::SlabAllocator<unsigned char, ThreadedName> allocator;
+				for (int i = 0; i < Rounds; i++) {
+					const tklb::SizeT size = 1 + (i * 37 + t) % 4000;
+					auto ptr = allocator.allocate(size);
+					ptr[size - 1] = 1;
+					allocator.deallocate(ptr, size);
+				}
+			});
+		}
+		for (int t = 0; t < Threads; t++) { threads[t].join(); }
+		done = true;
+		monitor.join();
+		if (!consistent || snapshots == 0) { return 11; }
+
+		auto stats = AllocStats::of<ThreadedName>().snapshot();
+		if (stats.allocations != Threads * Rounds || stats.outstanding() != 0) { return 12; }
+		if (stats.bytes != 0 || stats.peak == 0) { return 13; }
+		tklb::SizeT histogram = 0;
+		for (tklb::SizeT i = 0; i < AllocStats::Buckets; i++) { histogram += stats.histogram[i]; }
+		if (histogram != stats.allocations) { return 14; }
+		tklb::memory::SlabPool::instance().release();
+	}
+
+	{
+		// Every registered name shows up
+		AllocStats::Snapshot all[AllocStats::MaxNames];
+		const auto count = AllocStats::snapshot(all, AllocStats::MaxNames);
+		bool voices = false, threaded = false;
+		for (tklb::SizeT i = 0; i < count; i++) {
+			voices = voices || std::strcmp(all[i].name, "Voices") == 0;
+			threaded = threaded || std::strcmp(all[i].name, "Threaded") == 0;
+		}
+		if (!voices || !threaded) { return 15; }
+	}
+	return 0;
+}
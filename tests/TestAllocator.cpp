@@ -1,9 +1,27 @@
 #include "./TestCommon.hpp"
 #include "../src/memory/TAllocator.hpp"
+#include "../src/types/THeapBuffer.hpp"
 
 int test() {
 	tklb::DefaultAllocator<> allocator;
 	auto space = allocator.allocate(16);
 	allocator.deallocate(space, 16);
+
+	for (tklb::SizeT alignment = 1; alignment <= 4096; alignment *= 2) {
+		auto aligned = allocator.allocate(100, alignment);
+		if (aligned == nullptr || tklb::Pointer(aligned) % alignment != 0) { return 1; }
+		tklb::memory::set(aligned, 100, (unsigned char) 1);
+		allocator.deallocate(aligned, 100, alignment);
+
+		void* raw = TKLB_MALLOC_ALIGNED(7, alignment)
+		if (raw == nullptr || tklb::Pointer(raw) % alignment != 0) { return 2; }
+		TKLB_FREE_ALIGNED(raw)
+	}
+
+	tklb::HeapBuffer<float, 64> buffer;
+	for (unsigned int size = 1; size < 1000; size *= 3) {
+		buffer.resize(size);
+		if (tklb::Pointer(buffer.data()) % 64 != 0) { return 3; }
+	}
 	return 0;
 }
@@ -0,0 +1,65 @@
+#include "./TestCommon.hpp"
+#include "../src/memory/TArena.hpp"
+#include "../src/types/audio/TAudioBuffer.hpp"
+
+using Arena = tklb::memory::Arena;
+
+int test() {
+	{
+		Arena arena(1024);
+		if (arena.capacity() != 1024) { return 1; }
+		char* a = (char*) arena.allocate(10);
+		void* b = arena.allocate(100, 64);
+		if (a == nullptr || b == nullptr) { return 2; }
+		if (tklb::Pointer(b) % 64 != 0 || tklb::Pointer(a) % Arena::DefaultAlignment != 0) { return 3; }
+
+		const Arena::Marker marker = arena.mark();
+		void* c = arena.allocate(200);
+		arena.rewind(marker);
+		if (arena.allocate(200) != c) { return 4; }
+
+		const auto before = arena.used();
+		{
+			Arena::Scope scope(arena);
+			arena.create<double>(50);
+			if (arena.used() < before + 50 * sizeof(double)) { return 5; }
+		}
+		if (arena.used() != before) { return 6; }
+
+		if (arena.allocate(2000) != nullptr) { return 7; }
+		const auto peak = arena.peak();
+		arena.reset();
+		if (arena.used() != 0 || arena.peak() != peak) { return 8; }
+		if (arena.allocate(1024, 1) == nullptr) { return 9; }
+	}
+
+	{
+		// Scratch buffers share one arena per block
+		using Sample = tklb::AudioBuffer::Sample;
+		Arena arena(64 * 1024);
+		Arena::Bind bind(arena);
+		if (Arena::current() != &arena) { return 10; }
+		tklb::AudioBuffer result(256, 2);
+		for (int block = 0; block < 4; block++) {
+			arena.reset();
+			tklb::ScratchBuffer temp(256, 2);
+			tklb::ScratchBuffer temp2(256, 2);
+			if (temp.channels() != 2 || arena.used() < 2 * 256 * 2 * sizeof(Sample)) { return 11; }
+			temp.set(Sample(block));
+			temp2.set(Sample(1));
+			temp.add(temp2);
+			result.set(temp);
+			if (result[1][255] != Sample(block + 1)) { return 12; }
+		}
+		const auto used = arena.used();
+		{
+			Arena other(1024);
+			Arena::Bind inner(other);
+			tklb::ScratchBufferTpl<float> small(16, 1);
+			if (other.used() == 0 || arena.used() != used) { return 13; }
+		}
+		if (Arena::current() != &arena) { return 14; }
+	}
+	if (Arena::current() != nullptr) { return 15; }
+	return 0;
+}
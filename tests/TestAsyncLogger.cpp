@@ -0,0 +1,125 @@
+#define TKLB_ASYNC_LOG
+#define TKLB_CUSTOM_PRINT
+#include "./TestCommon.hpp"
+#include "../src/util/TLogger.hpp"
+
+#include <atomic>
+#include <thread>
+#include <cstring>
+
+static constexpr int MaxLines = 16;
+char lines[MaxLines][1024];
+std::atomic<int> printed = { 0 };
+
+void tklb_print(int level, const char* message) {
+	(void) level;
+	const int index = printed.load();
+	if (index < MaxLines) { strcpy(lines[index], message); }
+	printed = index + 1;
+}
+
+using Logger = tklb::AsyncLogger;
+
+int test() {
+	{
+		// Prints right away when not started
+		const int line = __LINE__ + 1;
+		TKLB_WARN("Hello %s %i", "test", 12)
+		if (printed != 1) { return 1; }
+		char expected[1024];
+		stbsp_snprintf(expected, 1024, " WARN | TestAsyncLogger.cpp:%i \t| Hello test 12", line);
+		if (strcmp(lines[0], expected) != 0) { return 2; }
+	}
+
+	Logger::Options options;
+	options.threads = 2;
+	options.records = 4;
+	options.interval = 500;
+	if (!Logger::start(options)) { return 3; }
+	if (Logger::start(options)) { return 4; }
+
+	{
+		// Same output as formatting directly
+		printed = 0;
+		char name[] = "stack";
+		int value = 0;
+		Logger::log(3, "path/File.cpp", 7, "%s %i %u %.2f %c|%-6s|%% %*d", name, -12, 12u, 2.345f, 'a', "left", 4, 3);
+		Logger::log(3, "path/File.cpp", 8, "%.*s %lld %zu %e %5x %p", 2, "abc", -1234567890123ll, size_t(99), 1.5e10, 255, &value);
+		Logger::flush();
+		if (printed != 2) { return 5; }
+		char expected[1024];
+		stbsp_snprintf(expected, 1024, "ERROR | File.cpp:7 \t| stack -12 12 2.35 a|left  |%%    3");
+		if (strcmp(lines[0], expected) != 0) { return 6; }
+		stbsp_snprintf(expected, 1024, "ERROR | File.cpp:8 \t| ab -1234567890123 99 1.500000e+10    ff %p", (void*) &value);
+		if (strcmp(lines[1], expected) != 0) { return 6; }
+	}
+
+	{
+		// Long strings and too many arguments are cut off
+		char text[300];
+		memset(text, 'x', 299);
+		text[299] = '\0';
+		Logger::log(1, "File.cpp", 1, "%s", text);
+		Logger::log(1, "File.cpp", 1, "%i %i %i %i %i %i %i %i %i", 1, 2, 3, 4, 5, 6, 7, 8, 9);
+		Logger::flush();
+		if (printed != 4) { return 7; }
+		if (strlen(strchr(lines[2], '|') + 2) != strlen("File.cpp:1 \t| ") + Logger::TextSize - 1) { return 8; }
+		if (strcmp(strchr(lines[3], '|') + 2, "File.cpp:1 \t| 1 2 3 4 5 6 7 8 0") != 0) { return 9; }
+		if (Logger::stats().truncated != 2) { return 10; }
+	}
+
+	{
+		// Full rings drop instead of waiting, the background thread sleeps in the meantime
+		std::this_thread::sleep_for(std::chrono::milliseconds(50));
+		printed = 0;
+		for (int i = 0; i < 6; i++) { TKLB_INFO("%i", i) }
+		if (Logger::stats().dropped != 2) { return 11; }
+		Logger::flush();
+		if (printed != 4) { return 12; }
+	}
+
+	{
+		// One ring per thread, the third thread gets none
+		std::atomic<bool> done = { false };
+		std::atomic<bool> logged = { false };
+		std::thread owner([&]() {
+			TKLB_ERROR("%s", "owner")
+			logged = true;
+			while (!done) { std::this_thread::yield(); }
+		});
+		while (!logged) { std::this_thread::yield(); }
+		std::thread other([]() { TKLB_ERROR("%s", "other") });
+		other.join();
+		done = true;
+		owner.join();
+		if (Logger::stats().unclaimed != 1) { return 13; }
+	}
+
+	// Wake up more often from here on
+	Logger::stop();
+	options.interval = 1;
+	if (!Logger::start(options)) { return 14; }
+
+	{
+		// Lots of threads one after another reuse the rings
+		printed = 0;
+		Logger::resetStats();
+		for (int i = 0; i < 20; i++) {
+			std::thread thread([]() { TKLB_DEBUG("thread %i", 1) });
+			thread.join();
+			while (Logger::stats().claimed != 0) { std::this_thread::yield(); }
+		}
+		if (Logger::stats().unclaimed != 0 || Logger::stats().written != 20) { return 15; }
+	}
+
+	{
+		// Stopping prints what's left
+		Logger::resetStats();
+		TKLB_WARN("left %s", "over")
+		Logger::stop();
+		if (Logger::running()) { return 16; }
+		if (Logger::stats().written != 1) { return 17; }
+		TKLB_WARN("sync %s", "again")
+	}
+	return 0;
+}
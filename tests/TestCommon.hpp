@@ -3,11 +3,12 @@
 bool heapCorruption = false;
 
 #define TKLB_CUSTOM_MALLOC
+#define TKLB_CUSTOM_REALLOC
 static constexpr unsigned int poolSize = 1024 * 1024 * 64;
 char* poolMemory = new char[poolSize];
 
-#include "../src/memory/TFixedPool.hpp"
-tklb::memory::FixedPool pool = { poolMemory, poolSize };
+#include "../src/memory/TTlsf.hpp"
+tklb::memory::Tlsf pool = { poolMemory, poolSize };
 
 #include "../src/util/TAssert.h"
 #include "../src/memory/TMemoryCheck.hpp"
@@ -29,6 +30,18 @@ void tklb_free(void* ptr) {
 	pool.deallocate(result.ptr);
 }
 
+void* tklb_realloc(void* ptr, tklb::SizeT bytes) {
+	using MagicBlock = tklb::memory::check::MagicBlock;
+	if (ptr == nullptr) { return tklb_malloc(bytes); }
+	auto result = MagicBlock::check(ptr);
+	if (result.overrun || result.underrun) {
+		heapCorruption = true;
+	}
+	auto moved = pool.reallocate(result.ptr, bytes + MagicBlock::sizeNeeded());
+	if (moved == nullptr) { return nullptr; }
+	return MagicBlock::construct(moved, bytes); // The contents stay where they are
+}
+
 #ifdef TKLB_NO_STDLIB
 	void tklb_print(int level, const char* message) { (void) level; (void) message; }
 #endif
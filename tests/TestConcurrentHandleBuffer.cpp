@@ -0,0 +1,109 @@
+#include "./TestCommon.hpp"
+#include "../src/types/TConcurrentHandleBuffer.hpp"
+
+#include <thread>
+#include <atomic>
+
+struct Voice {
+	static constexpr int Valid = 0x5EED;
+	int magic = Valid;
+	~Voice() { magic = 0; }
+};
+
+int test() {
+	using Buffer = tklb::ConcurrentHandleBuffer<Voice>;
+
+	{
+		Buffer buffer(4);
+		unsigned int handles[5];
+		for (int i = 0; i < 5; i++) { handles[i] = buffer.create(); }
+		if (handles[4] != Buffer::InvalidHandle || buffer.count() != 4) { return 1; }
+		if (!buffer.remove(handles[0]) || buffer.remove(handles[0])) { return 2; }
+		if (buffer.has(handles[0]) || buffer.count() != 3) { return 3; }
+
+		// Retired elements stay until nobody reads
+		{
+			Buffer::ReadScope read(buffer);
+			if (buffer.collect() != 0) { return 4; }
+		}
+		if (buffer.create() != Buffer::InvalidHandle) { return 5; }
+		if (buffer.collect() != 1) { return 6; }
+
+		// The slot comes back with a new generation
+		const unsigned int reused = buffer.create();
+		if (reused == Buffer::InvalidHandle || reused == handles[0]) { return 7; }
+		if ((reused & 0xFFFFFF) != (handles[0] & 0xFFFFFF)) { return 8; }
+		if (buffer.has(handles[0]) || !buffer.has(reused)) { return 9; }
+
+		int visited = 0;
+		buffer.iterate([&](Voice& voice, unsigned int handle) {
+			if (voice.magic == Voice::Valid && buffer.at(handle) == &voice) { visited++; }
+		});
+		if (visited != 4) { return 10; }
+
+		// Only readers from before the remove hold it back, overlapping ones don't
+		Buffer::ReadScope* older = new Buffer::ReadScope(buffer);
+		buffer.remove(reused);
+		if (buffer.collect() != 0) { return 14; }
+		Buffer::ReadScope* newer = new Buffer::ReadScope(buffer);
+		delete older;
+		if (buffer.collect() != 1) { return 15; }
+		const unsigned int second = buffer.create();
+		buffer.remove(second);
+		if (buffer.collect() != 0) { return 16; }
+		older = newer;
+		newer = new Buffer::ReadScope(buffer);
+		delete older;
+		if (buffer.collect() != 1) { return 17; }
+		delete newer;
+	}
+
+	{
+		// Control thread creates, audio thread reads, another thread removes
+		Buffer buffer(256);
+		std::atomic<bool> done = { false };
+		std::atomic<int> broken = { 0 };
+		std::atomic<int> removed = { 0 };
+		int created = 0;
+
+		std::thread audio([&]() {
+			while (!done) {
+				buffer.iterate([&](Voice& voice, unsigned int handle) {
+					(void) handle;
+					if (voice.magic != Voice::Valid) { broken++; }
+				});
+			}
+		});
+
+		std::thread streaming([&]() {
+			while (!done) {
+				buffer.iterate([&](Voice& voice, unsigned int handle) {
+					(void) voice;
+					if (buffer.remove(handle)) { removed++; }
+				});
+			}
+		});
+
+		for (int i = 0; i < 20000; i++) {
+			if (buffer.create() != Buffer::InvalidHandle) { created++; }
+			if (i % 64 == 0) { buffer.collect(); }
+		}
+		done = true;
+		audio.join();
+		streaming.join();
+
+		buffer.iterate([&](Voice& voice, unsigned int handle) {
+			(void) voice;
+			if (buffer.remove(handle)) { removed++; }
+		});
+		buffer.collect();
+		if (broken != 0) { return 11; }
+		if (created == 0 || removed != created || buffer.count() != 0) { return 12; }
+		unsigned int all[256];
+		for (int i = 0; i < 256; i++) {
+			all[i] = buffer.create();
+			if (all[i] == Buffer::InvalidHandle) { return 13; }
+		}
+	}
+	return 0;
+}
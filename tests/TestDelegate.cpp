@@ -0,0 +1,77 @@
+#include "./TestCommon.hpp"
+#include "../src/types/TDelegate.hpp"
+
+static int twice(int value) { return value * 2; }
+
+struct Counter {
+	int count = 0;
+	int add(int value) { count += value; return count; }
+	int get(int offset) const { return count + offset; }
+	void reset() { count = 0; }
+};
+
+int test() {
+	using Func = tklb::Delegate<int(int)>;
+	static_assert(tklb::traits::IsTriviallyCopyable<Func>::value, "Delegate needs to be trivially copyable");
+
+	{
+		Func empty;
+		if (empty.valid()) { return 1; }
+	}
+
+	{
+		// Free functions, known at compile or runtime
+		Func compile = Func::function<&twice>();
+		Func runtime(&twice);
+		Func name = twice;
+		if (compile(3) != 6 || runtime(4) != 8 || name(5) != 10) { return 2; }
+	}
+
+	{
+		// Members, const ones too
+		Counter counter;
+		auto add = TKLB_DELEGATE(&Counter::add, counter);
+		auto get = TKLB_DELEGATE(&Counter::get, counter);
+		if (add(2) != 2 || add(3) != 5) { return 3; }
+		if (get(1) != 6) { return 4; }
+		const Counter& constant = counter;
+		Func member = Func::member<Counter, &Counter::get>(&constant);
+		if (member(0) != 5) { return 5; }
+		auto reset = TKLB_DELEGATE(&Counter::reset, counter);
+		reset();
+		if (counter.count != 0) { return 6; }
+	}
+
+	{
+		// Lambdas are stored inline and copied with the delegate
+		int base = 10;
+		int calls = 0;
+		Func lambda = [&](int value) { calls++; return base + value; };
+		Func copy = lambda;
+		base = 20;
+		if (lambda(1) != 21 || copy(2) != 22 || calls != 2) { return 7; }
+
+		const int offset = 7;
+		Func captured = [offset](int value) { return offset * value; };
+		if (captured(3) != 21) { return 8; }
+
+		// Bigger lambdas need more storage
+		const double a = 1, b = 2, c = 3;
+		tklb::Delegate<int(int), sizeof(double) * 3> big = [a, b, c](int value) {
+			return int(a + b + c) + value;
+		};
+		if (big(4) != 10) { return 9; }
+	}
+
+	{
+		// Context and callback like before
+		int value = 5;
+		tklb::Delegate<void(int)> legacy(&value, [](void* context, int add) {
+			*static_cast<int*>(context) += add;
+		});
+		legacy(3);
+		if (value != 8) { return 10; }
+	}
+
+	return 0;
+}
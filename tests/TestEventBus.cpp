@@ -1,5 +1,9 @@
 #include "./TestCommon.hpp"
 #include "../src/types/TEventBus.hpp"
+#include "../src/types/TMutex.hpp"
+
+#include <thread>
+#include <atomic>
 
 int test() {
 	enum EventList {
@@ -36,5 +40,150 @@ int test() {
 	bus.fireEvent<tklb::SizeT>(ADD, 1);
 	bus.fireEvent<tklb::SizeT>(MUL, 2);
 
-	return ret.ret == 8 ? 0 : 1;
+	if (ret.ret != 8) { return 1; }
+
+	{
+		auto second = Bus::Subscription<tklb::SizeT>(
+			&bus, ADD, TKLB_DELEGATE(&Class::add, ret)
+		);
+		bus.fireEvent<tklb::SizeT>(ADD, 1);
+		if (ret.ret != 10) { return 2; }
+	}
+	bus.fireEvent<tklb::SizeT>(ADD, 1);
+	if (ret.ret != 11) { return 3; }
+
+	{
+		// Firing on one thread while another one subscribes and unsubscribes
+		using SharedBus = tklb::EventBus<TOTAL_COUNT, EventList, tklb::Mutex>;
+		SharedBus shared;
+
+		struct Listener {
+			std::atomic<int> alive = { 1 };
+			std::atomic<int> calls = { 0 };
+			std::atomic<int> broken = { 0 };
+			void on(int) {
+				if (alive != 1) { broken++; }
+				calls++;
+			}
+		};
+
+		Listener always;
+		auto sub = SharedBus::Subscription<int>(&shared, ADD, TKLB_DELEGATE(&Listener::on, always));
+		std::atomic<bool> done = { false };
+		std::atomic<int> broken = { 0 };
+
+		std::thread audio([&]() {
+			while (!done) { shared.fireEvent<int>(ADD, 1); }
+		});
+
+		while (always.calls == 0) { std::this_thread::yield(); }
+		for (int i = 0; i < 2000; i++) {
+			Listener listener;
+			{
+				auto temporary = SharedBus::Subscription<int>(&shared, ADD, TKLB_DELEGATE(&Listener::on, listener));
+				auto other = SharedBus::Subscription<int>(&shared, MUL, TKLB_DELEGATE(&Listener::on, listener));
+			}
+			// No callback may run once the subscription is gone
+			listener.alive = 0;
+			broken += listener.broken;
+		}
+		done = true;
+		audio.join();
+		if (broken != 0 || always.broken != 0) { return 4; }
+	}
+
+	{
+		// Queued and coalesced delivery
+		Bus queued(4);
+		queued.setDelivery(ADD, Bus::Delivery::Queued);
+		queued.setDelivery(MUL, Bus::Delivery::Coalesced);
+		Class target;
+		auto add = Bus::Subscription<tklb::SizeT>(&queued, ADD, TKLB_DELEGATE(&Class::add, target));
+		auto mul = Bus::Subscription<tklb::SizeT>(&queued, MUL, TKLB_DELEGATE(&Class::mul, target));
+
+		for (tklb::SizeT i = 1; i <= 6; i++) { queued.fireEvent<tklb::SizeT>(ADD, i); }
+		if (target.ret != 3 || queued.overflows() != 2) { return 5; }
+		if (queued.dispatch() != 4 || target.ret != 3 + 1 + 2 + 3 + 4) { return 6; }
+		if (queued.dispatch() != 0) { return 7; }
+
+		queued.fireEvent<tklb::SizeT>(MUL, 5);
+		queued.fireEvent<tklb::SizeT>(MUL, 7);
+		queued.fireEvent<tklb::SizeT>(MUL, 2);
+		queued.fireEvent<tklb::SizeT>(ADD, 1);
+		if (queued.coalesced() != 2) { return 8; }
+		// Queued events come first
+		if (queued.dispatch() != 2 || target.ret != (13 + 1) * 2) { return 9; }
+		if (queued.dispatch() != 0) { return 10; }
+	}
+
+	{
+		// Several producers, one dispatching thread
+		using SharedBus = tklb::EventBus<TOTAL_COUNT, EventList, tklb::Mutex>;
+		SharedBus shared(64);
+		shared.setDelivery(ADD, SharedBus::Delivery::Queued);
+		shared.setDelivery(MUL, SharedBus::Delivery::Coalesced);
+		struct Consumer {
+			tklb::SizeT sum = 0;
+			tklb::SizeT last = 0;
+			void add(tklb::SizeT v) { sum += v; }
+			void set(tklb::SizeT v) { last = v; }
+		};
+		Consumer consumer;
+		auto add = SharedBus::Subscription<tklb::SizeT>(&shared, ADD, TKLB_DELEGATE(&Consumer::add, consumer));
+		auto set = SharedBus::Subscription<tklb::SizeT>(&shared, MUL, TKLB_DELEGATE(&Consumer::set, consumer));
+
+		const int producers = 3;
+		const tklb::SizeT events = 5000;
+		std::atomic<int> running = { producers };
+		std::thread threads[producers];
+		for (int i = 0; i < producers; i++) {
+			threads[i] = std::thread([&]() {
+				for (tklb::SizeT j = 1; j <= events; j++) {
+					shared.fireEvent<tklb::SizeT>(ADD, 1);
+					shared.fireEvent<tklb::SizeT>(MUL, j);
+				}
+				running--;
+			});
+		}
+		tklb::SizeT delivered = 0;
+		while (running != 0) { delivered += shared.dispatch(); }
+		for (int i = 0; i < producers; i++) { threads[i].join(); }
+		delivered += shared.dispatch();
+		if (consumer.sum == 0 || consumer.last == 0 || delivered == 0) { return 11; }
+		// Every queued event is either delivered or counted
+		if (consumer.sum + shared.overflows() < producers * events) { return 12; }
+	}
+
+	{
+		// Producers racing on a coalesced event, the last value fired wins
+		using SharedBus = tklb::EventBus<TOTAL_COUNT, EventList, tklb::Mutex>;
+		SharedBus shared;
+		shared.setDelivery(MUL, SharedBus::Delivery::Coalesced);
+		struct Consumer {
+			tklb::SizeT last = 0;
+			void set(tklb::SizeT v) { last = v; }
+		};
+		Consumer consumer;
+		auto set = SharedBus::Subscription<tklb::SizeT>(&shared, MUL, TKLB_DELEGATE(&Consumer::set, consumer));
+
+		const int producers = 4;
+		const tklb::SizeT events = 20000;
+		std::atomic<int> ready = { 0 };
+		std::thread threads[producers];
+		for (int i = 0; i < producers; i++) {
+			threads[i] = std::thread([&]() {
+				ready++;
+				while (ready != producers) { }
+				for (tklb::SizeT j = 1; j <= events; j++) {
+					shared.fireEvent<tklb::SizeT>(MUL, j);
+				}
+			});
+		}
+		for (int i = 0; i < producers; i++) { threads[i].join(); }
+		if (shared.dispatch() != 1) { return 13; }
+		// Only a producer preempted in the middle of writing can make a value go missing
+		if (consumer.last != events && shared.overflows() == 0) { return 14; }
+	}
+
+	return 0;
 }
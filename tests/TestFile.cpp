@@ -0,0 +1,98 @@
+#include "./TestCommon.hpp"
+
+#include "../src/types/audio/codec/TFileSource.hpp"
+#include "../src/types/audio/codec/TWave.hpp"
+#include "../src/types/audio/codec/TVorbis.hpp"
+
+using Sample = tklb::AudioBuffer::Sample;
+
+int compare(const tklb::AudioBuffer& a, const tklb::AudioBuffer& b) {
+	if (a.validSize() != b.validSize() || a.channels() != b.channels()) { return 1; }
+	for (int c = 0; c < a.channels(); c++) {
+		for (tklb::AudioBuffer::Size i = 0; i < a.validSize(); i++) {
+			if (!close(a[c][i], b[c][i], 0.0001)) { return 1; }
+		}
+	}
+	return 0;
+}
+
+int test() {
+	{
+		tklb::MappedFile mapped;
+		tklb::FileStream stream;
+		if (mapped.open("./test_folder/does_not_exist")) { return 1; }
+		if (stream.open("./test_folder/does_not_exist")) { return 2; }
+
+		if (!mapped.open("./test_folder/sine.ogg")) { return 3; }
+		if (!stream.open("./test_folder/sine.ogg")) { return 4; }
+		if (mapped.size() != stream.size() || mapped.size() == 0) { return 5; }
+		mapped.prefetch(0, mapped.size());
+
+		// Both read the same bytes, also after seeking
+		char chunk[1000];
+		const tklb::SizeT offsets[] = { 0, 1234, mapped.size() - 500 };
+		for (auto offset : offsets) {
+			if (!stream.seek(offset)) { return 6; }
+			const tklb::SizeT got = stream.read(chunk, sizeof(chunk));
+			if (got != tklb::min(sizeof(chunk), mapped.size() - offset)) { return 7; }
+			for (tklb::SizeT i = 0; i < got; i++) {
+				if (chunk[i] != mapped.data()[offset + i]) { return 8; }
+			}
+		}
+		if (stream.seek(mapped.size() + 1)) { return 9; }
+	}
+
+	{
+		// Codecs decode the same from a mapped and a streamed file
+		tklb::FileSource mapped("./test_folder/sine.ogg");
+		tklb::FileSource streamed("./test_folder/sine.ogg", false);
+		if (!mapped.isMapped() || mapped.data() == nullptr) { return 10; }
+		if (streamed.isMapped() || !streamed.isOpen()) { return 11; }
+		tklb::AudioBuffer a, b;
+		if (!tklb::vorbis::load<Sample>(mapped, a)) { return 12; }
+		if (!tklb::vorbis::load<Sample>(streamed, b)) { return 13; }
+		if (a.validSize() != 44100 * 2) { return 14; }
+		returnNonZero(compare(a, b) * 15)
+	}
+
+	{
+		// A sample bank with several files packed after each other
+		const int count = 3;
+		tklb::AudioBuffer samples[count];
+		tklb::HeapBuffer<char> encoded[count];
+		const char* path = "./test_folder/bank.tmp";
+		FILE* bank = fopen(path, "wb");
+		if (bank == nullptr) { return 16; }
+		for (int s = 0; s < count; s++) {
+			samples[s].resize(1000 * (s + 1), s + 1);
+			samples[s].sampleRate = 48000;
+			for (int c = 0; c < samples[s].channels(); c++) {
+				for (tklb::AudioBuffer::Size i = 0; i < samples[s].size(); i++) {
+					samples[s][c][i] = tklb::sin(i * (c + s + 1) * 0.01) * 0.5;
+				}
+			}
+			tklb::Wave wave;
+			if (!wave.write<Sample>(samples[s], encoded[s])) { return 17; }
+			fwrite(encoded[s].data(), 1, encoded[s].size(), bank);
+		}
+		fclose(bank);
+
+		tklb::MappedFile mapped(path);
+		tklb::SizeT offset = 0;
+		int result = 0;
+		for (int s = 0; s < count && result == 0; s++) {
+			// Views into the mapping, nothing gets copied before decoding
+			tklb::MemorySource view(mapped.data() + offset, encoded[s].size());
+			tklb::AudioBuffer decoded;
+			tklb::Wave wave;
+			if (!wave.load<Sample>(view, decoded)) { result = 18; }
+			else if (compare(decoded, samples[s])) { result = 19; }
+			offset += encoded[s].size();
+		}
+		mapped.close();
+		remove(path);
+		returnNonZero(result)
+	}
+
+	return 0;
+}
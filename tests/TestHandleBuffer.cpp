@@ -10,6 +10,7 @@ int test()
 {
 	const unsigned int size = 4;
 	tklb::HandleBuffer<ClassToStore> handleBuf(size);
+	handleBuf.setLimit(size);
 	auto e0 = handleBuf.create();
 	auto e1 = handleBuf.create();
 	auto e2 = handleBuf.create();
@@ -71,8 +72,65 @@ int test()
 	if (handleBuf.has(e1)) {
 		return 9;
 	}
-	if (handleBuf.free() != size) {
+	if (handleBuf.count() != 0 || handleBuf.free() != handleBuf.size()) {
 		return 10;
 	}
+
+	{
+		// Growing keeps handles and element addresses valid
+		tklb::HandleBuffer<ClassToStore> grow;
+		const int count = 1000;
+		unsigned int handles[count];
+		ClassToStore* pointers[count];
+		for (int i = 0; i < count; i++) {
+			handles[i] = grow.create();
+			if (handles[i] == grow.InvalidHandle) { return 11; }
+			grow[handles[i]].number = i;
+			pointers[i] = &grow[handles[i]];
+		}
+		for (int i = 0; i < count; i++) {
+			if (grow.at(handles[i]) != pointers[i] || pointers[i]->number != i) { return 12; }
+		}
+
+		// Free slots aren't reachable, not even with a handle of the same generation
+		for (int i = 0; i < count; i += 2) { grow.remove(handles[i]); }
+		if (grow.count() != count / 2) { return 13; }
+		if (grow.has(handles[0]) || grow.has((handles[0] & 0xFFFFFF) | (1u << 24))) { return 14; }
+
+		int sum = 0;
+		int visited = 0;
+		grow.iterate([&](ClassToStore& element, unsigned int handle) {
+			if (grow.at(handle) != &element) { sum = -1; }
+			if (sum >= 0) { sum += element.number; }
+			visited++;
+		});
+		if (visited != count / 2 || sum != count * count / 4) { return 15; }
+
+		// Removing the visited element while iterating
+		grow.iterate([&](ClassToStore& element, unsigned int handle) {
+			if (element.number % 4 == 1) { grow.remove(handle); }
+		});
+		if (grow.count() != count / 4) { return 16; }
+		for (int i = 3; i < count; i += 4) {
+			if (grow.at(handles[i]) != pointers[i]) { return 17; }
+		}
+	}
+
+	{
+		// Batch create and remove
+		tklb::HandleBuffer<ClassToStore> batch;
+		batch.setLimit(100);
+		unsigned int handles[128];
+		if (batch.create(handles, 64) != 64) { return 18; }
+		if (batch.create(handles + 64, 64) != 36) { return 19; }
+		if (batch.count() != 100) { return 20; }
+		if (batch.remove(handles, 50) != 50) { return 21; }
+		if (batch.remove(handles, 50) != 0) { return 22; }
+		if (batch.count() != 50 || !batch.has(handles[50])) { return 23; }
+		const unsigned int* live = batch.handles();
+		for (unsigned int i = 0; i < batch.count(); i++) {
+			if (!batch.has(live[i])) { return 24; }
+		}
+	}
 	return 0;
 }
@@ -1,5 +1,6 @@
 #include "./TestCommon.hpp"
 #include "../src/types/THeapBuffer.hpp"
+#include "../src/types/audio/TAudioBuffer.hpp"
 
 template <class T>
 using HeapBufferType = tklb::HeapBuffer<T>;
@@ -22,6 +23,29 @@ public:
 	}
 };
 
+/**
+ * Owns memory, so it has to be moved
+ */
+class MoveOnly {
+public:
+	static int Moves;
+	static int Alive;
+	int* value = nullptr;
+	MoveOnly(int v = 0) : value(new int(v)) { Alive++; }
+	MoveOnly(MoveOnly&& source) : value(source.value) {
+		source.value = nullptr;
+		Moves++;
+		Alive++;
+	}
+	MoveOnly(const MoveOnly&) = delete;
+	~MoveOnly() {
+		delete value;
+		Alive--;
+	}
+};
+int MoveOnly::Moves = 0;
+int MoveOnly::Alive = 0;
+
 template <class Buffer>
 int runTest() {
 	{
@@ -90,5 +114,82 @@ int test() {
 	res = runTest<tklb::HeapBuffer<LifeCycleTest, 16>>();
 	if (res) return res;
 	res = runTest<tklb::HeapBuffer<LifeCycleTest, 32, tklb::DefaultAllocator<unsigned char>, tklb::SizeT>>();
-	return res;
+	if (res) return res;
+	res = runTest<tklb::HeapBuffer<LifeCycleTest, 0, tklb::DefaultAllocator<unsigned char>, unsigned int, 4>>();
+	if (res) return res;
+
+	{
+		// Short lists stay inline
+		tklb::HeapBuffer<int, 0, tklb::DefaultAllocator<>, unsigned int, 8> list;
+		const auto allocated = pool.allocated();
+		for (int i = 0; i < 8; i++) { list.push(i); }
+		if (!list.isInline() || pool.allocated() != allocated) { return 20; }
+		list.push(8);
+		if (list.isInline() || list[8] != 8 || list[0] != 0) { return 21; }
+		list.resize(3);
+		if (!list.isInline() || list[2] != 2 || pool.allocated() != allocated) { return 22; }
+
+		// Moving copies inline elements
+		decltype(list) moved(tklb::traits::move(list));
+		if (!moved.isInline() || moved.size() != 3 || moved[1] != 1) { return 23; }
+		if (list.size() != 0 || list.data() != nullptr) { return 24; }
+	}
+
+	{
+		// Pushing grows geometrically
+		tklb::HeapBuffer<int> list;
+		int growths = 0;
+		auto capacity = list.reserved();
+		for (int i = 0; i < 100000; i++) {
+			list.push(i);
+			if (list.reserved() != capacity) {
+				capacity = list.reserved();
+				growths++;
+			}
+		}
+		if (30 < growths) { return 25; }
+		for (int i = 0; i < 100000; i++) {
+			if (list[i] != i) { return 26; }
+		}
+	}
+
+	{
+		// Elements owning memory are moved, never copied or lost
+		tklb::HeapBuffer<MoveOnly> list;
+		for (int i = 0; i < 100; i++) { list.push(MoveOnly(i)); }
+		if (MoveOnly::Alive != 100) { return 27; }
+		list.remove(tklb::HeapBuffer<MoveOnly>::Size(10));
+		if (*list[10].value != 99 || MoveOnly::Alive != 99) { return 28; }
+		list.resize(20);
+		list.resize(1000);
+		for (int i = 0; i < 10; i++) {
+			if (*list[i].value != i) { return 29; }
+		}
+
+		tklb::HeapBuffer<MoveOnly, 0, tklb::DefaultAllocator<>, unsigned int, 4> small;
+		small.push(MoveOnly(1));
+		const int moves = MoveOnly::Moves;
+		decltype(small) moved(tklb::traits::move(small));
+		if (MoveOnly::Moves != moves + 1 || *moved[0].value != 1) { return 30; }
+		small = tklb::traits::move(moved);
+		if (*small[0].value != 1) { return 31; }
+	}
+	if (MoveOnly::Alive != 0) { return 32; }
+
+	{
+		// Audio buffers are relocated without touching their samples
+		tklb::HeapBuffer<tklb::AudioBuffer> segments;
+		segments.resize(3);
+		const tklb::AudioBuffer::Sample* samples[3];
+		for (int i = 0; i < 3; i++) {
+			segments[i].resize(64, 2);
+			segments[i][1][63] = i;
+			samples[i] = segments[i][1];
+		}
+		segments.resize(1000);
+		for (int i = 0; i < 3; i++) {
+			if (segments[i][1] != samples[i] || segments[i][1][63] != i) { return 33; }
+		}
+	}
+	return 0;
 }
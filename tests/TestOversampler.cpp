@@ -0,0 +1,66 @@
+
+#include "./TestCommon.hpp"
+
+#include "../src/types/audio/TOversampler.hpp"
+
+template <int CHANNELS>
+int doTest(unsigned char factor, bool direct = false) {
+	using T = tklb::AudioBuffer::Sample;
+	const int length = 4096;
+	const int blockSize = 128;
+
+	tklb::Oversampler<CHANNELS, blockSize> oversampler;
+	oversampler.setFactor(factor);
+	if (oversampler.getFactor() != factor) { return 1; }
+	auto copy = [](T** in, T** out, tklb::AudioBuffer::Size frames) {
+		for (int c = 0; c < CHANNELS; c++) {
+			for (tklb::AudioBuffer::Size i = 0; i < frames; i++) {
+				out[c][i] = in[c][i];
+			}
+		}
+	};
+	oversampler.setProcessFunc(copy);
+
+	tklb::AudioBuffer input, output;
+	input.resize(length, CHANNELS);
+	output.resize(length, CHANNELS);
+	for (int c = 0; c < CHANNELS; c++) {
+		for (int i = 0; i < length; i++) {
+			input[c][i] = tklb::sin(i * (c + 1) * 0.0005); // Fairly low frequency
+		}
+	}
+
+	T* in[CHANNELS];
+	T* out[CHANNELS];
+	for (int i = 0; i < length; i += blockSize) {
+		for (int c = 0; c < CHANNELS; c++) {
+			in[c] = input[c] + i;
+			out[c] = output[c] + i;
+		}
+		if (direct) {
+			oversampler.process(in, out, blockSize, copy);
+		} else {
+			oversampler.process(in, out, blockSize);
+		}
+	}
+
+	const int latency = int(tklb::round(oversampler.getLatency()));
+	for (int c = 0; c < CHANNELS; c++) {
+		for (int i = 100; i < length - latency; i++) { // skip the filters settling
+			if (!close(output[c][i + latency], input[c][i], 0.02)) {
+				return 2;
+			}
+		}
+	}
+	return 0;
+}
+
+int test() {
+	for (unsigned char factor = 1; factor <= 16; factor *= 2) {
+		returnNonZero(doTest<1>(factor))
+		returnNonZero(doTest<3>(factor))
+		returnNonZero(doTest<20>(factor))
+		returnNonZero(doTest<3>(factor, true))
+	}
+	return 0;
+}
@@ -0,0 +1,150 @@
+#include "./TestCommon.hpp"
+
+#include "../src/types/audio/codec/TQoa.hpp"
+
+using Sample = tklb::AudioBuffer::Sample;
+using Codec = tklb::QoaCodec;
+
+/**
+ * Hides the memory so the codec has to read frame by frame
+ */
+struct StreamSource : public tklb::MemorySource {
+	using tklb::MemorySource::MemorySource;
+	tklb::SizeT size() const override { return 0; }
+	const void* data() const override { return nullptr; }
+};
+
+int compare(const tklb::AudioBuffer& a, const tklb::AudioBuffer& b, int offset, int length, float tolerance) {
+	for (int c = 0; c < a.channels(); c++) {
+		for (int i = 0; i < length; i++) {
+			if (!close(a[c][i], b[c][offset + i], tolerance)) { return 1; }
+		}
+	}
+	return 0;
+}
+
+int test() {
+	const int length = Codec::FrameLength * 2 + 1234; // partial last frame
+	const int channels = 3;
+	const int block = 1000;
+
+	tklb::AudioBuffer reference;
+	reference.resize(length, channels);
+	reference.sampleRate = 44100;
+	for (int c = 0; c < channels; c++) {
+		for (int i = 0; i < length; i++) {
+			reference[c][i] = tklb::sin(i * (c + 1) * 0.01) * 0.5;
+		}
+	}
+
+	tklb::HeapBuffer<char> file;
+	{
+		// Encode in blocks not aligned to the frames
+		tklb::HeapBufferSink sink(file);
+		Codec codec;
+		if (codec.create(sink, reference.sampleRate, channels) != Codec::Result::Success) { return 1; }
+		tklb::AudioBuffer chunk;
+		chunk.resize(block, channels);
+		for (int i = 0; i < length; i += block) {
+			const int count = tklb::min(block, length - i);
+			chunk.set(reference, count, i);
+			chunk.setValidSize(count);
+			if (codec.write(chunk) != Codec::Result::Success) { return 2; }
+		}
+		if (codec.close() != Codec::Result::Success) { return 3; }
+	}
+	// 3.2 bits per sample plus headers
+	if (file.size() > length * channels / 2 + 1024) { return 4; }
+
+	tklb::AudioBuffer decoded;
+	if (!tklb::qoa::load<Sample>(file.data(), file.size(), decoded)) { return 5; }
+	if (decoded.validSize() != length || decoded.channels() != channels) { return 6; }
+	returnNonZero(compare(decoded, reference, 0, length, 0.01) * 7)
+
+	tklb::MemorySource memory(file.data(), file.size());
+	StreamSource stream(file.data(), file.size());
+	tklb::ICodecSource* sources[] = { &memory, &stream };
+
+	for (auto source : sources) {
+		Codec codec;
+		if (codec.open(*source) != Codec::Result::Success) { return 8; }
+		if (codec.length() != length || codec.sampleRate() != 44100) { return 9; }
+
+		tklb::AudioBuffer chunk;
+		int read = 0;
+		while (true) {
+			const int got = codec.read(block, chunk);
+			if (got == 0) { break; }
+			returnNonZero(compare(chunk, decoded, read, got, 0.000001) * 10)
+			read += got;
+		}
+		if (read != length) { return 11; }
+
+		// Sample accurate scrubbing, across frames too
+		const int positions[] = { 11000, 17, Codec::FrameLength, Codec::FrameLength - 5, 0, length - 10, length };
+		for (int position : positions) {
+			if (codec.scrub(position) != Codec::Result::Success) { return 12; }
+			const int got = codec.read(block, chunk);
+			if (got != tklb::min(block, length - position)) { return 13; }
+			returnNonZero(compare(chunk, decoded, position, got, 0.000001) * 14)
+		}
+		if (codec.scrub(length + 1) != Codec::Result::OutOfRange) { return 15; }
+	}
+
+	{
+		// A frame header claiming less than the header itself stops reading at that frame
+		const tklb::SizeT second = 8 + tklb::qoa::fullFrameSize(channels);
+		tklb::HeapBuffer<char> corrupt;
+		corrupt.set(file.data(), file.size());
+		corrupt[second + 6] = 0;
+		corrupt[second + 7] = 8;
+		// A file cut off in the middle of the second frame
+		tklb::HeapBuffer<char> truncated;
+		truncated.set(file.data(), second + 100);
+		// Last frame one slice short for the last channel, but enough slices for the samples in total
+		const tklb::SizeT third = 8 + 2 * tklb::qoa::fullFrameSize(channels);
+		const int shortSize = (((unsigned char)(file[third + 6]) << 8) | (unsigned char)(file[third + 7])) - 8;
+		const int shortSamples = 1221;
+		tklb::HeapBuffer<char> missing;
+		missing.set(file.data(), third + shortSize);
+		missing[third + 4] = char(shortSamples >> 8);
+		missing[third + 5] = char(shortSamples & 0xff);
+		missing[third + 6] = char(shortSize >> 8);
+		missing[third + 7] = char(shortSize & 0xff);
+
+		tklb::MemorySource corruptMemory(corrupt.data(), corrupt.size());
+		StreamSource corruptStream(corrupt.data(), corrupt.size());
+		tklb::MemorySource truncatedMemory(truncated.data(), truncated.size());
+		StreamSource truncatedStream(truncated.data(), truncated.size());
+		tklb::MemorySource missingMemory(missing.data(), missing.size());
+		StreamSource missingStream(missing.data(), missing.size());
+		tklb::ICodecSource* broken[] = { &corruptMemory, &corruptStream, &truncatedMemory, &truncatedStream };
+		for (auto source : broken) {
+			Codec codec;
+			if (codec.open(*source) != Codec::Result::Success) { return 16; }
+			tklb::AudioBuffer chunk;
+			int read = 0;
+			while (true) {
+				const int got = codec.read(block, chunk);
+				if (got == 0) { break; }
+				read += got;
+			}
+			if (read != Codec::FrameLength) { return 17; }
+		}
+		tklb::ICodecSource* lacking[] = { &missingMemory, &missingStream };
+		for (auto source : lacking) {
+			Codec codec;
+			if (codec.open(*source) != Codec::Result::Success) { return 18; }
+			tklb::AudioBuffer chunk;
+			int read = 0;
+			while (true) {
+				const int got = codec.read(block, chunk);
+				if (got == 0) { break; }
+				read += got;
+			}
+			if (read != Codec::FrameLength * 2) { return 19; }
+		}
+	}
+
+	return 0;
+}
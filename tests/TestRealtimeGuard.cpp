@@ -0,0 +1,90 @@
+#define TKLB_REALTIME_GUARD
+#include "./TestCommon.hpp"
+#include "../src/util/TRealtimeGuard.hpp"
+#include "../src/types/THeapBuffer.hpp"
+#include "../src/types/audio/TAudioBuffer.hpp"
+#include "../src/types/TMutex.hpp"
+
+#include <thread>
+#include <cstring>
+
+using Guard = tklb::RealtimeGuard;
+using Violation = Guard::Violation;
+
+int test() {
+	Guard::setAction(Guard::CountOnly);
+
+	{
+		// Nothing is reported outside of realtime threads
+		void* ptr = TKLB_MALLOC(16)
+		TKLB_FREE(ptr)
+		tklb::HeapBuffer<int> list;
+		list.push(1);
+		if (Guard::count(Violation::Allocate) != 0 || Guard::count(Violation::Free) != 0) { return 1; }
+	}
+
+	{
+		Guard::Scope realtime;
+		const int line = __LINE__ + 1;
+		void* ptr = TKLB_MALLOC(16)
+		if (Guard::count(Violation::Allocate) != 1) { return 2; }
+		auto report = Guard::last();
+		if (report.kind != Violation::Allocate || report.line != line) { return 3; }
+		TKLB_FREE(ptr)
+		if (Guard::count(Violation::Free) != 1) { return 4; }
+
+		// Growing a buffer goes through the allocator
+		tklb::HeapBuffer<int> list;
+		list.reserve(16);
+		for (int i = 0; i < 16; i++) { list.push(i); }
+		if (Guard::count(Violation::Allocate) != 2) { return 5; }
+		list.push(16);
+		if (Guard::count(Violation::Allocate) != 3) { return 6; }
+		// The call site is the one in the allocator, not this file
+		report = Guard::last();
+		if (report.kind != Violation::Allocate || strstr(report.file, "TAllocator.hpp") == nullptr) { return 14; }
+
+		// Aligned storage like the one of AudioBuffer too
+		tklb::HeapBuffer<float, 16> aligned;
+		aligned.resize(64);
+		if (Guard::count(Violation::Allocate) != 4) { return 12; }
+		tklb::AudioBufferTpl<float> audio;
+		audio.resize(1024, 2);
+		if (Guard::count(Violation::Allocate) != 5) { return 13; }
+
+		tklb::Mutex mutex;
+		{
+			tklb::Mutex::TryLock lock(mutex); // Never blocks
+		}
+		if (Guard::count(Violation::Lock) != 0) { return 7; }
+		{
+			tklb::Mutex::Lock lock(mutex);
+		}
+		if (Guard::count(Violation::Lock) != 1) { return 8; }
+
+		const auto frees = Guard::count(Violation::Free);
+		{
+			Guard::Allow allow;
+			list.resize(0);
+			aligned.resize(0);
+			audio.resize(0, 0);
+		}
+		if (Guard::count(Violation::Free) != frees) { return 9; }
+
+		// Other threads are unaffected
+		std::thread other([&]() {
+			tklb::Mutex::Lock lock(mutex);
+		});
+		other.join();
+		if (Guard::count(Violation::Lock) != 1) { return 10; }
+
+		Guard::setAction(Guard::Log);
+		ptr = TKLB_MALLOC(8)
+		TKLB_FREE(ptr)
+	}
+
+	Guard::reset();
+	if (Guard::count(Violation::Allocate) != 0 || Guard::last().file != nullptr) { return 11; }
+	Guard::setAction(Guard::Assert | Guard::Log);
+	return 0;
+}
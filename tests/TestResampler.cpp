@@ -3,6 +3,7 @@
 
 #include "../src/types/audio/resampler/TResamplerHold.hpp"
 #include "../src/types/audio/resampler/TResamplerLinear.hpp"
+#include "../src/types/audio/resampler/TResamplerDbry.hpp"
 
 
 
@@ -60,6 +61,77 @@ int doTest() {
 	return 0;
 }
 
+/**
+ * Blocks larger than maxBlock, running out of output space and delay compensation
+ */
+int testDbry() {
+	using Resampler = tklb::ResamplerDbry;
+	const int rateIn = 44100;
+	const int rateOut = 48000;
+	const int length = 1000;
+	const int channels = 2;
+
+	tklb::AudioBuffer in;
+	in.sampleRate = rateIn;
+	in.resize(length, channels);
+	for (int c = 0; c < channels; c++) {
+		for (int i = 0; i < length; i++) {
+			in[c][i] = tklb::sin(i * (c + 1) * 0.01);
+		}
+	}
+	in.setValidSize(length);
+
+	// Everything in one go, four times the max block
+	Resampler whole(rateIn, rateOut, length / 4, channels);
+	tklb::AudioBuffer reference;
+	reference.sampleRate = rateOut;
+	reference.resize(whole.calculateBufferSize(length), channels);
+	tklb::AudioBuffer::Size consumed = 0;
+	const int expected = whole.process(in, reference, consumed);
+	if (consumed != length || expected + 2 < int(whole.estimateOut(length))) { return 1; }
+
+	// Output too small, the input which didn't fit is reported and passed in again
+	Resampler split(rateIn, rateOut, length / 4, channels);
+	tklb::AudioBuffer out;
+	out.sampleRate = rateOut;
+	out.resize(300, channels);
+	const int first = split.process(in, out, consumed);
+	if (first != int(out.size()) || length <= consumed) { return 2; }
+	for (int c = 0; c < channels; c++) {
+		for (int i = 0; i < first; i++) {
+			if (!close(out[c][i], reference[c][i], 0.0001)) { return 3; }
+		}
+	}
+	tklb::AudioBuffer rest;
+	rest.sampleRate = rateIn;
+	rest.resize(length - consumed, channels);
+	rest.set(in, length - consumed, consumed);
+	rest.setValidSize(length - consumed);
+	out.resize(split.calculateBufferSize(length), channels);
+	const int second = split.process(rest, out, consumed);
+	if (consumed != rest.validSize() || first + second != expected) { return 4; }
+	for (int c = 0; c < channels; c++) {
+		for (int i = 0; i < second; i++) {
+			if (!close(out[c][i], reference[c][first + i], 0.0001)) { return 5; }
+		}
+	}
+
+	// resample() lines the result up with the input
+	tklb::AudioBuffer offline;
+	offline.clone(in);
+	offline.sampleRate = rateIn;
+	offline.setValidSize(length);
+	Resampler::resample(offline, rateOut);
+	if (offline.validSize() != whole.estimateOut(length)) { return 6; }
+	const double step = double(rateIn) / double(rateOut);
+	for (int c = 0; c < channels; c++) {
+		for (int i = 20; i < int(offline.validSize()) - 20; i++) {
+			if (!close(offline[c][i], tklb::sin(i * step * (c + 1) * 0.01), 0.01)) { return 7; }
+		}
+	}
+	return 0;
+}
+
 int test() {
 	if (doTest<tklb::ResamplerHold>() != 0) {
 		return 1;
@@ -67,5 +139,9 @@ int test() {
 	if (doTest<tklb::ResamplerLinear>() != 0) {
 		return 2;
 	}
+	if (doTest<tklb::ResamplerDbry>() != 0) {
+		return 3;
+	}
+	returnNonZero(testDbry() * 10)
 	return 0;
 }
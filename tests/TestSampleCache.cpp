@@ -0,0 +1,115 @@
+#include "./TestCommon.hpp"
+
+#include "../src/types/audio/TSampleCache.hpp"
+
+using Cache = tklb::SampleCache;
+using Buffer = tklb::AudioBuffer;
+using Size = Buffer::Size;
+
+constexpr Size Length = 4800;
+constexpr Size Channels = 2;
+constexpr tklb::SizeT Bytes = tklb::SizeT(Length) * Channels * sizeof(Buffer::Sample);
+
+std::atomic<int> loads = { 0 };
+
+bool loader(Cache::Asset asset, Buffer& out) {
+	if (asset == 0) { return false; } // Missing file
+	loads++;
+	out.resize(Length, Channels);
+	out.sampleRate = 48000;
+	for (Size c = 0; c < Channels; c++) {
+		for (Size i = 0; i < Length; i++) {
+			out[c][i] = tklb::sin(i * asset * 0.001) * 0.5;
+		}
+	}
+	return true;
+}
+
+int test() {
+	{
+		Cache::Options options;
+		options.budget = Bytes * 3;
+		options.entries = 8;
+		options.workers = 0;
+		Cache cache(loader, options);
+
+		Cache::Sample a = cache.get(1);
+		if (!a.ready() || a->validSize() != Length || a->sampleRate != 48000) { return 1; }
+		if ((*a)[1][100] != Buffer::Sample(tklb::sin(100 * 0.001) * 0.5)) { return 2; }
+		if (cache.get(1).get() != a.get() || loads != 1) { return 3; }
+		if (cache.hits() != 1 || cache.misses() != 1) { return 4; }
+		if (cache.used() != a->size() * a->channels() * sizeof(Buffer::Sample)) { return 5; }
+
+		if (!cache.get(0).failed()) { return 6; }
+
+		// Same rate shares the original
+		Cache::Sample same = cache.get(1, 48000);
+		if (same.get() != a.get() || loads != 1) { return 7; }
+
+		// Resampled once and cached
+		Cache::Sample low = cache.get(1, 24000);
+		if (!low.ready() || low->sampleRate != 24000 || loads != 1) { return 8; }
+		if (low->validSize() < Length / 2 - 2 || Length / 2 + 2 < low->validSize()) { return 9; }
+		if (cache.get(1, 24000).get() != low.get()) { return 10; }
+
+		// Fill the budget while everything is referenced, the load can't evict anything
+		Cache::Sample b = cache.get(2);
+		if (!b.ready()) { return 11; }
+		Cache::Sample c = cache.get(3);
+		if (!c.failed() || cache.budget() < cache.used()) { return 12; }
+
+		// Unreferenced entries get evicted, least recently used first
+		c.reset();
+		low.reset();
+		cache.get(2);			// 2 is now newer than 1
+		a.reset();
+		same.reset();
+		b.reset();
+		const int before = loads;
+		c = cache.get(3);
+		if (!c.ready() || loads != before + 1) { return 13; }
+		if (cache.budget() < cache.used()) { return 14; }
+		cache.get(2);
+		if (loads != before + 1) { return 15; } // 2 survived
+		cache.get(1);
+		if (loads != before + 2) { return 16; } // 1 was evicted
+
+		// Requests get loaded by work() or when waited on
+		Cache::Sample r1 = cache.request(4);
+		Cache::Sample r2 = cache.request(5);
+		if (r1.ready() || r2.ready()) { return 17; }
+		if (!cache.work() || !r1.ready() || r2.ready()) { return 18; }
+		if (!r2.wait() || cache.work() || cache.work()) { return 19; }
+		c.reset();
+		r1.reset();
+		r2.reset();
+		cache.clear();
+		if (cache.used() != 0 || cache.count() != 0) { return 20; }
+	}
+
+	{
+		// Many threads requesting the same assets concurrently
+		loads = 0;
+		Cache::Options options;
+		options.budget = Bytes * 64;
+		options.entries = 64;
+		options.workers = 2;
+		Cache cache(loader, options);
+		std::thread threads[4];
+		std::atomic<int> errors = { 0 };
+		for (int t = 0; t < 4; t++) {
+			threads[t] = std::thread([&, t]() {
+				for (int i = 0; i < 50; i++) {
+					const Cache::Asset asset = 1 + (i + t) % 8;
+					Cache::Sample sample = (i % 2) ? cache.request(asset, i % 3 == 0 ? 24000 : 0) : cache.get(asset);
+					if (!sample.wait()) { errors++; }
+					else if ((*sample)[0][10] != Buffer::Sample(tklb::sin(10 * asset * 0.001) * 0.5) && sample->sampleRate == 48000) { errors++; }
+				}
+			});
+		}
+		for (int t = 0; t < 4; t++) { threads[t].join(); }
+		if (errors != 0) { return 21; }
+		if (loads != 8) { return 22; }
+	}
+	return 0;
+}
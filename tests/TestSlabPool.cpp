@@ -0,0 +1,80 @@
+#include "./TestCommon.hpp"
+#include "../src/memory/TSlabPool.hpp"
+#include "../src/types/THeapBuffer.hpp"
+
+#include <thread>
+
+using SlabPool = tklb::memory::SlabPool;
+using Buffer = tklb::HeapBuffer<float, 0, tklb::memory::SlabAllocator<>>;
+
+int test() {
+	{
+		SlabPool slabs;
+		void* a = slabs.allocate(10);
+		void* b = slabs.allocate(16);
+		void* c = slabs.allocate(3000);
+		if (a == nullptr || b == nullptr || c == nullptr) { return 1; }
+		if (slabs.slabs() != 2) { return 2; } // Classes share slabs lazily, one per class used
+		tklb::memory::set((unsigned char*) c, 3000, (unsigned char) 7);
+		slabs.deallocate(b);
+		// Same class comes from the thread cache right away
+		if (slabs.allocate(12) != b) { return 3; }
+
+		// Too large for the classes
+		void* large = slabs.allocate(100000);
+		if (large == nullptr) { return 4; }
+		tklb::memory::set((unsigned char*) large, 100000, (unsigned char) 1);
+		slabs.deallocate(large);
+
+		// Many objects of one class spill to the shared list and come back
+		void* many[1000];
+		for (int i = 0; i < 1000; i++) { many[i] = slabs.allocate(48); }
+		const auto used = slabs.slabs();
+		for (int i = 0; i < 1000; i++) { slabs.deallocate(many[i]); }
+		slabs.flush();
+		for (int i = 0; i < 1000; i++) { many[i] = slabs.allocate(48); }
+		if (slabs.slabs() != used) { return 5; }
+		for (int i = 0; i < 1000; i++) { slabs.deallocate(many[i]); }
+
+		slabs.deallocate(a);
+		slabs.deallocate(b);
+		slabs.deallocate(c);
+	}
+
+	{
+		// Voices created and destroyed across threads
+		constexpr int Threads = 4;
+		constexpr int Voices = 64;
+		Buffer* handover[Threads][Voices] = { };
+		std::thread threads[Threads];
+		int errors[Threads] = { };
+		for (int t = 0; t < Threads; t++) {
+			threads[t] = std::thread([&, t]() {
+				for (int round = 0; round < 200; round++) {
+					Buffer* voices[Voices];
+					for (int v = 0; v < Voices; v++) {
+						voices[v] = new Buffer();
+						voices[v]->resize(16 * (1 + (v + round) % 20));
+						tklb::memory::set(voices[v]->data(), voices[v]->size(), float(t + v));
+					}
+					for (int v = 0; v < Voices; v++) {
+						if ((*voices[v])[voices[v]->size() - 1] != float(t + v)) { errors[t]++; }
+						if (round == 199) {
+							handover[t][v] = voices[v]; // Freed by another thread
+						} else {
+							delete voices[v];
+						}
+					}
+				}
+			});
+		}
+		for (int t = 0; t < Threads; t++) { threads[t].join(); }
+		for (int t = 0; t < Threads; t++) {
+			if (errors[t] != 0) { return 6; }
+			for (int v = 0; v < Voices; v++) { delete handover[t][v]; }
+		}
+		SlabPool::instance().flush();
+	}
+	SlabPool::instance().release();
+	return 0;
+}
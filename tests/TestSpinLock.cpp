@@ -0,0 +1,77 @@
+#define TKLB_SPINLOCK_STATS
+#include "./TestCommon.hpp"
+#include "../src/types/TSpinLock.hpp"
+
+#include <thread>
+
+int test() {
+	const int threads = 4;
+	const int increments = 20000;
+
+	{
+		tklb::SpinLock lock;
+		if (!lock.try_lock()) { return 1; }
+		if (lock.try_lock()) { return 2; }
+		lock.unlock();
+		{
+			tklb::SpinLock::TryLock guard(lock);
+			if (!guard.isLocked()) { return 3; }
+		}
+
+		lock.resetStats();
+		int counter = 0;
+		std::thread workers[threads];
+		for (int i = 0; i < threads; i++) {
+			workers[i] = std::thread([&]() {
+				for (int j = 0; j < increments; j++) {
+					tklb::SpinLock::Lock guard(lock);
+					counter++;
+				}
+			});
+		}
+		for (int i = 0; i < threads; i++) { workers[i].join(); }
+		if (counter != threads * increments) { return 4; }
+		const auto stats = lock.stats();
+		if (stats.acquired != tklb::SizeT(threads * increments)) { return 5; }
+		if (stats.contended > stats.acquired) { return 6; }
+	}
+
+	{
+		tklb::RWSpinLock lock;
+		lock.lock_shared();
+		if (!lock.try_lock_shared()) { return 7; }
+		if (lock.try_lock()) { return 8; } // Readers are in
+		lock.unlock_shared();
+		lock.unlock_shared();
+		if (!lock.try_lock()) { return 9; }
+		if (lock.try_lock_shared()) { return 10; }
+		lock.unlock();
+
+		// Writers see consistent pairs, readers never see a half written one
+		int a = 0;
+		int b = 0;
+		std::atomic<int> torn = { 0 };
+		std::atomic<int> reads = { 0 };
+		std::thread workers[threads];
+		for (int i = 0; i < threads; i++) {
+			const bool writer = i == 0;
+			workers[i] = std::thread([&, writer]() {
+				for (int j = 0; j < increments; j++) {
+					if (writer) {
+						tklb::RWSpinLock::Lock guard(lock);
+						a++;
+						b++;
+					} else {
+						tklb::RWSpinLock::ReadLock guard(lock);
+						if (a != b) { torn++; }
+						reads++;
+					}
+				}
+			});
+		}
+		for (int i = 0; i < threads; i++) { workers[i].join(); }
+		if (torn != 0 || a != increments || b != increments) { return 11; }
+		if (reads != (threads - 1) * increments) { return 12; }
+	}
+	return 0;
+}
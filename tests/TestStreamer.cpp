@@ -0,0 +1,172 @@
+#include "./TestCommon.hpp"
+
+#include "../src/types/audio/TStreamer.hpp"
+#include "../src/types/audio/codec/TWave.hpp"
+
+using Sample = tklb::AudioBuffer::Sample;
+using Streamer = tklb::Streamer;
+using Size = tklb::AudioBuffer::Size;
+
+constexpr int Count = 6;
+constexpr int Block = 512;
+
+struct Source {
+	tklb::AudioBuffer reference;
+	tklb::HeapBuffer<char> file;
+	tklb::MemorySource* source = nullptr;
+	tklb::WaveCodec codec;
+
+	bool init(int index) {
+		const int length = 5000 + index * 3777;
+		const int channels = 1 + index % 2;
+		reference.resize(length, channels);
+		reference.sampleRate = 48000;
+		for (int c = 0; c < channels; c++) {
+			for (int i = 0; i < length; i++) {
+				reference[c][i] = tklb::sin(i * (c + index + 1) * 0.001) * 0.5;
+			}
+		}
+		tklb::Wave wave;
+		if (!wave.write<Sample>(reference, file)) { return false; }
+		source = new tklb::MemorySource(file.data(), file.size());
+		return codec.open(*source) == tklb::WaveCodec::Result::Success;
+	}
+
+	~Source() { codec.close(); delete source; }
+};
+
+/**
+ * Plays all streams to the end and compares them against the reference
+ * @param wait Wait for the workers before each block instead of calling work()
+ */
+int playAll(Streamer& streamer, Source* sources, int* ids, bool wait) {
+	tklb::AudioBuffer out;
+	const Size underruns = streamer.underruns();
+	int played[Count] = { 0 };
+	bool playing = true;
+	while (playing) {
+		playing = false;
+		for (int s = 0; s < Count; s++) {
+			if (!streamer.isPlaying(ids[s])) { continue; }
+			playing = true;
+			const int remaining = sources[s].reference.validSize() - played[s];
+			while (int(streamer.buffered(ids[s])) < tklb::min(Block, remaining)) {
+				if (wait) { std::this_thread::sleep_for(std::chrono::microseconds(100)); }
+				else { streamer.work(); }
+			}
+			out.resize(Block, sources[s].reference.channels());
+			const int got = streamer.read(ids[s], out, Block);
+			for (int c = 0; c < out.channels(); c++) {
+				for (int i = 0; i < got; i++) {
+					if (!close(out[c][i], sources[s].reference[c][played[s] + i], 0.0001)) { return 1; }
+				}
+			}
+			played[s] += got;
+		}
+	}
+	for (int s = 0; s < Count; s++) {
+		if (played[s] != int(sources[s].reference.validSize())) { return 2; }
+	}
+	return streamer.underruns() == underruns ? 0 : 3;
+}
+
+int test() {
+	Source sources[Count];
+	for (int s = 0; s < Count; s++) {
+		if (!sources[s].init(s)) { return 1; }
+	}
+
+	{
+		// Without workers everything is deterministic
+		Streamer::Options options;
+		options.workers = 0;
+		options.bufferFrames = 4096;
+		options.blockFrames = 1024;
+		options.headFrames = 1000;
+		Streamer streamer(options);
+		int ids[Count];
+		for (int s = 0; s < Count; s++) {
+			ids[s] = streamer.prepare(sources[s].codec);
+			if (ids[s] < 0) { return 2; }
+			if (streamer.buffered(ids[s]) != 1000) { return 3; }
+		}
+
+		// The head is there right away, the rest is an underrun
+		if (!streamer.start(ids[0])) { return 4; }
+		tklb::AudioBuffer out;
+		out.resize(1500, 1);
+		if (streamer.read(ids[0], out, 1500) != 1500) { return 5; }
+		if (streamer.underruns(ids[0]) != 1 || streamer.underruns() != 1) { return 6; }
+		if (out[0][1200] != 0) { return 7; }
+		streamer.stop(ids[0]);
+		if (streamer.start(ids[0])) { return 8; } // Not rewound yet
+		while (streamer.work()) { }
+		if (!streamer.isReady(ids[0])) { return 9; }
+		// Prefetched before starting
+		if (streamer.buffered(ids[0]) != tklb::min(sources[0].reference.validSize(), Size(1000 + 4096))) { return 10; }
+
+		for (int s = 0; s < Count; s++) {
+			if (!streamer.start(ids[s])) { return 11; }
+		}
+		returnNonZero(playAll(streamer, sources, ids, false) * 12)
+
+		// Ended streams rewind and play again
+		while (streamer.work()) { }
+		for (int s = 0; s < Count; s++) {
+			if (!streamer.start(ids[s])) { return 13; }
+		}
+		returnNonZero(playAll(streamer, sources, ids, false) * 14)
+		for (int s = 0; s < Count; s++) { streamer.release(ids[s]); }
+	}
+
+	{
+		Streamer::Options options;
+		options.workers = 2;
+		options.bufferFrames = 2048;
+		options.blockFrames = 512;
+		Streamer streamer(options);
+		int ids[Count];
+		for (int s = 0; s < Count; s++) {
+			ids[s] = streamer.prepare(sources[s].codec);
+			if (ids[s] < 0) { return 15; }
+		}
+		for (int s = 0; s < Count; s++) {
+			// Wait until the workers rewound the codecs after the last run
+			while (!streamer.start(ids[s])) { std::this_thread::yield(); }
+		}
+		returnNonZero(playAll(streamer, sources, ids, true) * 16)
+		for (int s = 0; s < Count; s++) { streamer.release(ids[s]); }
+	}
+
+	{
+		// Releasing while the audio thread keeps starting, reading and stopping the stream
+		Streamer::Options options;
+		options.workers = 1;
+		options.bufferFrames = 2048;
+		options.blockFrames = 512;
+		Streamer streamer(options);
+		for (int round = 0; round < 20; round++) {
+			const int id = streamer.prepare(sources[0].codec);
+			if (id != 0) { return 17; } // The slot was freed
+			std::atomic<bool> done = { false };
+			std::thread audio([&]() {
+				tklb::AudioBuffer out;
+				out.resize(Block, 1);
+				while (!done) {
+					streamer.start(id);
+					streamer.read(id, out, Block);
+					streamer.stop(id);
+				}
+			});
+			std::this_thread::sleep_for(std::chrono::microseconds(200));
+			streamer.release(id);
+			// A pending rewind doesn't bring it back
+			std::this_thread::sleep_for(std::chrono::microseconds(200));
+			if (streamer.isReady(id) || streamer.isPlaying(id)) { return 18; }
+			done = true;
+			audio.join();
+		}
+	}
+
+	return 0;
+}
@@ -0,0 +1,106 @@
+#include "./TestCommon.hpp"
+#include "../src/memory/TTlsf.hpp"
+#include "../src/types/THeapBuffer.hpp"
+
+using Tlsf = tklb::memory::Tlsf;
+using Size = tklb::SizeT;
+
+constexpr Size PoolSize = 1024 * 1024;
+char localMemory[PoolSize];
+
+struct LocalPool {
+	static Tlsf& pool() {
+		static Tlsf instance(localMemory, PoolSize);
+		return instance;
+	}
+};
+
+int test() {
+	{
+		Tlsf tlsf(localMemory, PoolSize);
+		const Size capacity = tlsf.free();
+		if (capacity < PoolSize - 64) { return 1; }
+
+		// Everything merges back into one block
+		void* a = tlsf.allocate(100);
+		void* b = tlsf.allocate(2000);
+		void* c = tlsf.allocate(30000);
+		if (a == nullptr || b == nullptr || c == nullptr) { return 2; }
+		if (Tlsf::usableSize(b) < 2000) { return 3; }
+		if (!tlsf.check()) { return 4; }
+		tlsf.deallocate(b);
+		tlsf.deallocate(a);
+		tlsf.deallocate(c);
+		if (tlsf.allocated() != 0 || !tlsf.check()) { return 5; }
+		void* all = tlsf.allocate(capacity - 2 * sizeof(void*) - capacity / 32);
+		if (all == nullptr) { return 6; }
+		if (tlsf.allocate(capacity) != nullptr) { return 7; }
+		tlsf.deallocate(all);
+
+		// Aligned allocations
+		for (Size align = 16; align <= 4096; align *= 2) {
+			void* small = tlsf.allocate(3);
+			void* aligned = tlsf.allocate(align + 5, align);
+			if (aligned == nullptr || tklb::Pointer(aligned) % align != 0) { return 8; }
+			tlsf.deallocate(small);
+			tlsf.deallocate(aligned);
+		}
+		if (tlsf.allocated() != 0 || !tlsf.check()) { return 9; }
+
+		// Reallocation grows in place when the next block is free
+		char* grow = (char*) tlsf.allocate(64);
+		for (int i = 0; i < 64; i++) { grow[i] = char(i); }
+		char* grown = (char*) tlsf.reallocate(grow, 4000);
+		if (grown != grow) { return 10; }
+		char* blocker = (char*) tlsf.allocate(16);
+		char* moved = (char*) tlsf.reallocate(grown, 8000);
+		if (moved == grown) { return 11; }
+		for (int i = 0; i < 64; i++) {
+			if (moved[i] != char(i)) { return 12; }
+		}
+		if (tlsf.reallocate(moved, 100) != moved || !tlsf.check()) { return 13; }
+		tlsf.deallocate(blocker);
+		tlsf.deallocate(moved);
+		if (tlsf.allocated() != 0) { return 14; }
+
+		// Random sizes, the pool stays consistent and nothing is lost
+		constexpr int Slots = 512;
+		void* slots[Slots] = { };
+		Size sizes[Slots] = { };
+		unsigned int seed = 1234;
+		for (int i = 0; i < 20000; i++) {
+			seed = seed * 1664525 + 1013904223;
+			const int slot = (seed >> 8) % Slots;
+			if (slots[slot] != nullptr) {
+				const unsigned char* data = (unsigned char*) slots[slot];
+				for (Size j = 0; j < sizes[slot]; j++) {
+					if (data[j] != (unsigned char) slot) { return 15; }
+				}
+				tlsf.deallocate(slots[slot]);
+				slots[slot] = nullptr;
+				continue;
+			}
+			sizes[slot] = 1 + (seed >> 16) % ((seed & 1) ? 64 : 4096);
+			slots[slot] = tlsf.allocate(sizes[slot]);
+			if (slots[slot] == nullptr) { return 16; }
+			tklb::memory::set((unsigned char*) slots[slot], sizes[slot], (unsigned char) slot);
+		}
+		if (!tlsf.check()) { return 17; }
+		for (int i = 0; i < Slots; i++) { tlsf.deallocate(slots[i]); }
+		if (tlsf.allocated() != 0 || !tlsf.check()) { return 18; }
+		all = tlsf.allocate(capacity - 2 * sizeof(void*) - capacity / 32);
+		if (all == nullptr) { return 19; }
+		tlsf.deallocate(all);
+	}
+
+	{
+		// As allocator for a HeapBuffer
+		tklb::HeapBuffer<float, 0, tklb::memory::TlsfAllocator<LocalPool>> buffer;
+		buffer.resize(1000);
+		buffer[999] = 1;
+		if (LocalPool::pool().allocated() == 0) { return 20; }
+		buffer.resize(0, true);
+		if (LocalPool::pool().allocated() != 0) { return 21; }
+	}
+	return 0;
+}
@@ -141,5 +141,35 @@ int main() {
 			return 28;
 		}
 	}
+
+	{
+		struct MoveOnly {
+			int* data = nullptr;
+			MoveOnly() = default;
+			MoveOnly(MoveOnly&&) = default;
+			MoveOnly(const MoveOnly&) = delete;
+			~MoveOnly() { }
+		};
+		struct Pinned {
+			Pinned() = default;
+			Pinned(Pinned&&) = delete;
+		};
+		using namespace tklb::traits;
+		if (IsTriviallyCopyable<TestStruct>::value != std::is_trivially_copyable<TestStruct>::value) {
+			return 29;
+		}
+		if (IsTriviallyCopyable<MoveOnly>::value != std::is_trivially_copyable<MoveOnly>::value) {
+			return 30;
+		}
+		if (IsMoveConstructible<MoveOnly>::value != std::is_move_constructible<MoveOnly>::value) {
+			return 31;
+		}
+		if (IsMoveConstructible<Pinned>::value != std::is_move_constructible<Pinned>::value) {
+			return 32;
+		}
+		if (!IsTriviallyRelocatable<int*>::value || IsTriviallyRelocatable<MoveOnly>::value) {
+			return 33;
+		}
+	}
 	return 0;
 }
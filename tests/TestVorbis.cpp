@@ -0,0 +1,82 @@
+#include "./TestCommon.hpp"
+
+#include "../src/types/audio/codec/TVorbis.hpp"
+#include <cstdio>
+
+using Sample = tklb::AudioBuffer::Sample;
+using Codec = tklb::VorbisCodec;
+
+/**
+ * Hides the memory so the codec has to copy it
+ */
+struct StreamSource : public tklb::MemorySource {
+	using tklb::MemorySource::MemorySource;
+	tklb::SizeT size() const override { return 0; }
+	const void* data() const override { return nullptr; }
+};
+
+int compare(const tklb::AudioBuffer& a, const tklb::AudioBuffer& b, int offset, int length) {
+	for (int c = 0; c < a.channels(); c++) {
+		for (int i = 0; i < length; i++) {
+			if (!close(a[c][i], b[c][offset + i], 0.0001)) { return 1; }
+		}
+	}
+	return 0;
+}
+
+int test() {
+	auto file = fopen("./test_folder/sine.ogg", "rb");
+	if (!file) { return 1; }
+	fseek(file, 0, SEEK_END);
+	const long fileSize = ftell(file);
+	fseek(file, 0, SEEK_SET);
+	tklb::HeapBuffer<char> content;
+	content.resize(fileSize);
+	if (fread(content.data(), fileSize, 1, file) != 1) { return 2; }
+	fclose(file);
+
+	tklb::AudioBuffer reference;
+	if (!tklb::vorbis::load<Sample>(content.data(), content.size(), reference)) { return 3; }
+	const int length = 44100 * 2;
+	if (reference.validSize() != length || reference.channels() != 2) { return 4; }
+
+	tklb::MemorySource memory(content.data(), content.size());
+	StreamSource stream(content.data(), content.size());
+	tklb::ICodecSource* sources[] = { &memory, &stream };
+
+	for (auto source : sources) {
+		Codec codec;
+		if (codec.open(*source) != Codec::Result::Success) { return 5; }
+		if (codec.length() != length || codec.sampleRate() != 44100) { return 6; }
+		if (codec.decoderMemory() == 0) { return 7; }
+
+		// Decode in blocks
+		const int block = 1000;
+		tklb::AudioBuffer chunk;
+		int read = 0;
+		while (true) {
+			const int got = codec.read(block, chunk);
+			if (got == 0) { break; }
+			returnNonZero(compare(chunk, reference, read, got) * 10)
+			read += got;
+		}
+		if (read != length) { return 11; }
+
+		// Sample accurate seeking
+		const int positions[] = { 12345, 50000, 0, length - 10 };
+		for (int position : positions) {
+			if (codec.scrub(position) != Codec::Result::Success) { return 12; }
+			const int got = codec.read(block, chunk);
+			if (got != tklb::min(block, length - position)) { return 13; }
+			returnNonZero(compare(chunk, reference, position, got) * 14)
+		}
+
+		// Memory doesn't grow with the amount decoded
+		const tklb::SizeT memoryUsed = codec.memory();
+		codec.scrub(0);
+		while (codec.read(block, chunk) != 0) { }
+		if (codec.memory() != memoryUsed) { return 15; }
+	}
+
+	return 0;
+}
@@ -0,0 +1,93 @@
+#include "./TestCommon.hpp"
+
+#include "../src/types/audio/codec/TWave.hpp"
+
+using Sample = tklb::AudioBuffer::Sample;
+using Codec = tklb::WaveCodec;
+
+int test() {
+	const int length = 10000;
+	const int channels = 3;
+	const int block = 777;
+
+	tklb::AudioBuffer reference;
+	reference.resize(length, channels);
+	reference.sampleRate = 48000;
+	for (int c = 0; c < channels; c++) {
+		for (int i = 0; i < length; i++) {
+			reference[c][i] = tklb::sin(i * (c + 1) * 0.01) * 0.5;
+		}
+	}
+
+	tklb::HeapBuffer<char> file;
+
+	{
+		// Encode in blocks
+		tklb::HeapBufferSink sink(file);
+		Codec codec;
+		if (codec.create(sink, reference.sampleRate, channels) != Codec::Result::Success) {
+			return 1;
+		}
+		tklb::AudioBuffer chunk;
+		chunk.resize(block, channels);
+		for (int i = 0; i < length; i += block) {
+			const int count = tklb::min(block, length - i);
+			chunk.set(reference, count, i);
+			chunk.setValidSize(count);
+			if (codec.write(chunk) != Codec::Result::Success) { return 2; }
+		}
+		if (codec.length() != length) { return 3; }
+		if (codec.close() != Codec::Result::Success) { return 4; }
+	}
+
+	{
+		// Decode in blocks
+		tklb::MemorySource source(file.data(), file.size());
+		Codec codec;
+		if (codec.open(source) != Codec::Result::Success) { return 5; }
+		if (codec.length() != length || codec.channels() != channels) { return 6; }
+		if (codec.sampleRate() != reference.sampleRate) { return 7; }
+
+		tklb::AudioBuffer chunk;
+		int read = 0;
+		while (true) {
+			const int got = codec.read(block, chunk);
+			if (got == 0) { break; }
+			for (int c = 0; c < channels; c++) {
+				for (int i = 0; i < got; i++) {
+					if (!close(chunk[c][i], reference[c][read + i])) { return 8; }
+				}
+			}
+			read += got;
+		}
+		if (read != length) { return 9; }
+
+		// Sample accurate scrubbing
+		const int index = 4321;
+		if (codec.scrub(index) != Codec::Result::Success) { return 10; }
+		if (codec.position() != index) { return 11; }
+		if (codec.read(10, chunk) != 10) { return 12; }
+		if (!close(chunk[2][0], reference[2][index])) { return 13; }
+		if (codec.scrub(length + 1) != Codec::Result::OutOfRange) { return 14; }
+	}
+
+	{
+		// Whole file helpers with 16 bit pcm
+		tklb::Wave wave;
+		tklb::WaveOptions options;
+		options.format = tklb::WaveOptions::Format::PCM;
+		options.bitsPerSample = 16;
+		tklb::HeapBuffer<char> pcm;
+		if (!wave.write<Sample>(reference, pcm, options)) { return 15; }
+		tklb::AudioBuffer decoded;
+		if (!wave.load<Sample>(pcm.data(), pcm.size(), decoded)) { return 16; }
+		if (decoded.validSize() != length) { return 17; }
+		for (int c = 0; c < channels; c++) {
+			for (int i = 0; i < length; i++) {
+				if (!close(decoded[c][i], reference[c][i], 0.001)) { return 18; }
+			}
+		}
+	}
+
+	return 0;
+}
@@ -0,0 +1,84 @@
+#define TKLB_IMPL
+#define ITERATIONS 10
+#include "../../src/types/TDelegate.hpp"
+
+#include "./BenchmarkCommon.hpp"
+#include <functional>
+#include <cstdio>
+
+constexpr int calls = 10000000;
+
+struct Accumulator {
+	int sum = 0;
+	int add(int value) { sum += value; return sum; }
+};
+
+int main() {
+	int sink = 0;
+	Accumulator accumulator;
+
+	{
+		std::function<int(int)> function = [&](int value) { return accumulator.add(value); };
+		printf("std::function\t");
+		TIMER(Microseconds);
+		for (int i = 0; i < ITERATIONS; i++) {
+			for (int j = 0; j < calls; j++) { sink += function(j); }
+		}
+	}
+
+	{
+		Delegate<int(int)> delegate = [&](int value) { return accumulator.add(value); };
+		printf("Delegate lambda\t");
+		TIMER(Microseconds);
+		for (int i = 0; i < ITERATIONS; i++) {
+			for (int j = 0; j < calls; j++) { sink += delegate(j); }
+		}
+	}
+
+	{
+		auto delegate = TKLB_DELEGATE(&Accumulator::add, accumulator);
+		printf("Delegate member\t");
+		TIMER(Microseconds);
+		for (int i = 0; i < ITERATIONS; i++) {
+			for (int j = 0; j < calls; j++) { sink += delegate(j); }
+		}
+	}
+
+	{
+		auto lambda = [&](int value) { return accumulator.add(value); };
+		printf("Direct lambda\t");
+		TIMER(Microseconds);
+		for (int i = 0; i < ITERATIONS; i++) {
+			for (int j = 0; j < calls; j++) { sink += lambda(j); }
+		}
+	}
+
+	{
+		// Copying is where std::function may allocate
+		auto lambda = [&accumulator, &sink](int value) { return accumulator.add(value) + sink; };
+		printf("std::function copy\t");
+		TIMER(Microseconds);
+		for (int i = 0; i < ITERATIONS; i++) {
+			for (int j = 0; j < calls / 100; j++) {
+				std::function<int(int)> function = lambda;
+				std::function<int(int)> copy = function;
+				sink += copy(j);
+			}
+		}
+	}
+
+	{
+		auto lambda = [&accumulator, &sink](int value) { return accumulator.add(value) + sink; };
+		printf("Delegate copy\t");
+		TIMER(Microseconds);
+		for (int i = 0; i < ITERATIONS; i++) {
+			for (int j = 0; j < calls / 100; j++) {
+				Delegate<int(int)> delegate = lambda;
+				Delegate<int(int)> copy = delegate;
+				sink += copy(j);
+			}
+		}
+	}
+
+	return sink == 0 ? 1 : 0;
+}
@@ -0,0 +1,95 @@
+#define TKLB_IMPL
+#define ITERATIONS 10
+#include "../../src/types/THeapBuffer.hpp"
+
+#include "./BenchmarkCommon.hpp"
+#include <vector>
+#include <cstdio>
+
+constexpr int elements = 20000;
+constexpr int shortLists = 200000;
+
+struct Event { void* subscriber; int id; };
+
+int main() {
+	int sink = 0;
+
+	{
+		// Growth like before, one chunk at a time through reserve.
+		// Aligned so every step allocates and copies instead of reallocating.
+		using Aligned = HeapBuffer<Event, 16>;
+		printf("Chunked push\t");
+		TIMER(Microseconds);
+		for (int i = 0; i < ITERATIONS; i++) {
+			Aligned list;
+			for (int j = 0; j < elements; j++) {
+				list.reserve(Aligned::closestChunkSize(list.size() + 1, Aligned::ChunkSize));
+				list.push({ nullptr, j });
+			}
+			sink += list.last().id;
+		}
+	}
+
+	{
+		printf("Geometric push\t");
+		TIMER(Microseconds);
+		for (int i = 0; i < ITERATIONS; i++) {
+			HeapBuffer<Event, 16> list;
+			for (int j = 0; j < elements; j++) {
+				list.push({ nullptr, j });
+			}
+			sink += list.last().id;
+		}
+	}
+
+	{
+		printf("Realloc push\t");
+		TIMER(Microseconds);
+		for (int i = 0; i < ITERATIONS; i++) {
+			HeapBuffer<Event> list;
+			for (int j = 0; j < elements; j++) {
+				list.push({ nullptr, j });
+			}
+			sink += list.last().id;
+		}
+	}
+
+	{
+		printf("std::vector\t");
+		TIMER(Microseconds);
+		for (int i = 0; i < ITERATIONS; i++) {
+			std::vector<Event> list;
+			for (int j = 0; j < elements; j++) {
+				list.push_back({ nullptr, j });
+			}
+			sink += list.back().id;
+		}
+	}
+
+	{
+		// Many short lists, like subscribers of a single event
+		printf("Short heap\t");
+		TIMER(Microseconds);
+		for (int i = 0; i < ITERATIONS; i++) {
+			for (int j = 0; j < shortLists; j++) {
+				HeapBuffer<Event> list;
+				for (int k = 0; k < 4; k++) { list.push({ nullptr, k }); }
+				sink += list.last().id;
+			}
+		}
+	}
+
+	{
+		printf("Short inline\t");
+		TIMER(Microseconds);
+		for (int i = 0; i < ITERATIONS; i++) {
+			for (int j = 0; j < shortLists; j++) {
+				HeapBuffer<Event, 0, DefaultAllocator<>, unsigned int, 4> list;
+				for (int k = 0; k < 4; k++) { list.push({ nullptr, k }); }
+				sink += list.last().id;
+			}
+		}
+	}
+
+	return sink == 0 ? 1 : 0;
+}
@@ -1,44 +1,95 @@
+#define TKLB_IMPL
 #include "../../src/types/audio/TOversampler.hpp"
+#include "../../src/types/TDelegate.hpp"
 
 #include "./BenchmarkCommon.hpp"
 #include <cmath>
+#include <cstdio>
+#include <functional>
+
+constexpr int channels = 16;
+using Sampler = tklb::Oversampler<channels>;
+
+/**
+ * Simple gain, enough work to see the call overhead
+ * without being dominated by memory bandwidth
+ */
+struct Gain {
+	Sampler::T gain = 0.5;
+	void process(Sampler::T** in, Sampler::T** out, Sampler::Size len) {
+		for (int c = 0; c < channels; c++) {
+			for (Sampler::Size i = 0; i < len; i++) {
+				out[c][i] = in[c][i] * gain;
+			}
+		}
+	}
+};
 
 int main() {
 	const int length = 490; // must be less than the max block size
-	const int channels = 16;
 	using uchar = unsigned char;
-	using uint = unsigned int;
 
-	{
-		Oversampler<> oversampler;
+	Sampler oversampler;
+	oversampler.setFactor(4);
+	Gain gain;
 
-		oversampler.setFactor(4);
-		oversampler.setProcessFunc(
-			[&](Oversampler<>::T** in, Oversampler<>::T** out, uint len) {
-				for(uchar c = 0; c < channels; c++) {
-					// memcpy(out[c], in[c], sizeof(Oversampler<>::T) * len);
-				}
-		});
+	AudioBuffer in, out;
 
-		AudioBuffer in, out;
+	in.resize(length, channels);
+	out.resize(in);
 
-		in.resize(length, channels);
-		out.resize(in);
+	for (uchar c = 0; c < channels; c++) {
+		for (int i = 0; i < length; i++) {
+			in[c][i] = sin(i * c * 0.001); // Failry low frequency
+		}
+	}
 
-		for (uchar c = 0; c < channels; c++) {
-			for (int i = 0; i < length; i++) {
-				in[c][i] = sin(i * c * 0.001); // Failry low frequency
-			}
+	{
+		// std::function, like setProcessFunc used to store
+		std::function<void(Sampler::T**, Sampler::T**, Sampler::Size)> function =
+			[&](Sampler::T** in, Sampler::T** out, Sampler::Size len) {
+				gain.process(in, out, len);
+		};
+		printf("std::function\t");
+		TIMER(Microseconds);
+		for (int i = 0; i < ITERATIONS; i++) {
+			oversampler.process(in, out, function);
 		}
+	}
 
-		{
-			TIMER(Microseconds);
-			for (int i = 0; i < ITERATIONS; i++) {
-				oversampler.process(in, out);
-			}
+	{
+		// Lambda stored inline in the Delegate of setProcessFunc
+		oversampler.setProcessFunc(
+			[&](Sampler::T** in, Sampler::T** out, Sampler::Size len) {
+				gain.process(in, out, len);
+		});
+		printf("setProcessFunc\t");
+		TIMER(Microseconds);
+		for (int i = 0; i < ITERATIONS; i++) {
+			oversampler.process(in, out);
+		}
+	}
+
+	{
+		// Delegate, no allocation but still an indirect call
+		auto delegate = TKLB_DELEGATE(&Gain::process, gain);
+		printf("Delegate\t");
+		TIMER(Microseconds);
+		for (int i = 0; i < ITERATIONS; i++) {
+			oversampler.process(in, out, delegate);
 		}
-		int i = 0;
+	}
 
+	{
+		// Lambda passed directly, can be inlined
+		printf("Lambda\t\t");
+		TIMER(Microseconds);
+		for (int i = 0; i < ITERATIONS; i++) {
+			oversampler.process(in, out,
+				[&](Sampler::T** in, Sampler::T** out, Sampler::Size len) {
+					gain.process(in, out, len);
+			});
+		}
 	}
 
 	return 0;
@@ -0,0 +1,72 @@
+#define TKLB_IMPL
+#define ITERATIONS 100
+#include "./BenchmarkCommon.hpp"
+#include "../../src/types/audio/codec/TQoa.hpp"
+#include "../../src/types/audio/codec/TWave.hpp"
+#include "../../src/types/audio/codec/TVorbis.hpp"
+#include <cstdio>
+
+/**
+ * Decodes 2 seconds of stereo audio with each codec
+ */
+int main() {
+	using Sample = AudioBuffer::Sample;
+	const int length = 44100 * 2;
+	const int channels = 2;
+
+	AudioBuffer signal;
+	signal.resize(length, channels);
+	signal.sampleRate = 44100;
+	for (int c = 0; c < channels; c++) {
+		for (int i = 0; i < length; i++) {
+			signal[c][i] = sin(i * (c + 1) * 0.06) * 0.5;
+		}
+	}
+
+	HeapBuffer<char> qoaFile, waveFile, vorbisFile;
+	qoa::write<Sample>(signal, qoaFile);
+	Wave wave;
+	WaveOptions options;
+	options.format = WaveOptions::Format::PCM;
+	options.bitsPerSample = 16;
+	wave.write<Sample>(signal, waveFile, options);
+
+	// There's no vorbis encoder, so it's a similar file
+	auto file = fopen("../test_folder/sine.ogg", "rb");
+	if (file) {
+		fseek(file, 0, SEEK_END);
+		vorbisFile.resize(ftell(file));
+		fseek(file, 0, SEEK_SET);
+		if (fread(vorbisFile.data(), vorbisFile.size(), 1, file) != 1) {
+			vorbisFile.resize(0);
+		}
+		fclose(file);
+	}
+
+	AudioBuffer out;
+	{
+		printf("qoa\t");
+		TIMER(Microseconds);
+		for (int i = 0; i < ITERATIONS; i++) {
+			qoa::load<Sample>(qoaFile.data(), qoaFile.size(), out);
+		}
+	}
+
+	{
+		printf("wave\t");
+		TIMER(Microseconds);
+		for (int i = 0; i < ITERATIONS; i++) {
+			wave.load<Sample>(waveFile.data(), waveFile.size(), out);
+		}
+	}
+
+	if (!vorbisFile.empty()) {
+		printf("vorbis\t");
+		TIMER(Microseconds);
+		for (int i = 0; i < ITERATIONS; i++) {
+			vorbis::load<Sample>(vorbisFile.data(), vorbisFile.size(), out);
+		}
+	}
+
+	return 0;
+}
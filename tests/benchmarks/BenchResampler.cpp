@@ -1,5 +1,6 @@
-#include "../../src/types/audio/resampler/TResampler.hpp"
+#define TKLB_IMPL
 #include "./BenchmarkCommon.hpp"
+#include "../../src/types/audio/resampler/TResamplerSpeex.hpp"
 
 int main() {
 	{
@@ -7,15 +8,15 @@ int main() {
 		const int channels = 16;
 		const int rate1 = 44100;
 		const int rate2 = 48000;
-		Resampler up(rate1, rate2, length);
-		Resampler down(rate2, rate1, length * 2); // Bigger max block obviously
+		ResamplerSpeex up(rate1, rate2, length, channels);
+		ResamplerSpeex down(rate2, rate1, length * 2, channels); // Bigger max block obviously
 
 		AudioBuffer in, out;
 		in.sampleRate = rate1;
 		out.sampleRate = rate2;
 
-		in.resize(Resampler::calculateBufferSize(rate1, rate1, length), channels);
-		out.resize(Resampler::calculateBufferSize(rate1, rate2, length) , channels); // same here
+		in.resize(down.calculateBufferSize(length * 2), channels);
+		out.resize(up.calculateBufferSize(length), channels);
 
 		// generate sine test signal
 		for (int c = 0; c < channels; c++) {
@@ -30,6 +31,7 @@ int main() {
 			for (int i = 0; i < ITERATIONS; i++) {
 				up.process(in, out);
 				down.process(out, in);
+				in.setValidSize(length);
 			}
 		}
 
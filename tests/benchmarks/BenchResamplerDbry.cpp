@@ -0,0 +1,40 @@
+#define TKLB_IMPL
+#include "./BenchmarkCommon.hpp"
+#include "../../src/types/audio/resampler/TResamplerDbry.hpp"
+
+int main() {
+	{
+		const int length = 530;
+		const int channels = 16;
+		const int rate1 = 44100;
+		const int rate2 = 48000;
+		ResamplerDbry up(rate1, rate2, length, channels);
+		ResamplerDbry down(rate2, rate1, length * 2, channels); // Bigger max block obviously
+
+		AudioBuffer in, out;
+		in.sampleRate = rate1;
+		out.sampleRate = rate2;
+
+		in.resize(down.calculateBufferSize(length * 2), channels);
+		out.resize(up.calculateBufferSize(length), channels);
+
+		// generate sine test signal
+		for (int c = 0; c < channels; c++) {
+			for (int i = 0; i < length; i++) {
+				in[c][i] = sin(i * c * 0.001); // Failry low frequency
+			}
+		}
+		in.setValidSize(length);
+
+		{
+			TIMER(Microseconds);
+			for (int i = 0; i < ITERATIONS; i++) {
+				up.process(in, out);
+				down.process(out, in);
+				in.setValidSize(length);
+			}
+		}
+
+	}
+	return 0;
+}
@@ -7,15 +7,15 @@
 
 #ifdef TKLB_NO_SIMD
 	#ifdef TKLB_SAMPLE_FLOAT
-		#define TIMER(unit) SectionTimer timer(__FILE__ "\tNo SIMD\tfloat\t", SectionTimer::unit, ITERATIONS)
+		#define TIMER(unit) SectionTimer timer(__FILE__ "\tNo SIMD\tfloat\t", SectionTimer::Unit::unit, ITERATIONS)
 	#else
-		#define TIMER(unit) SectionTimer timer(__FILE__ "\tNo SIMD\tdouble\t", SectionTimer::unit, ITERATIONS)
+		#define TIMER(unit) SectionTimer timer(__FILE__ "\tNo SIMD\tdouble\t", SectionTimer::Unit::unit, ITERATIONS)
 	#endif
 #else
 	#ifdef TKLB_SAMPLE_FLOAT
-		#define TIMER(unit) SectionTimer timer(__FILE__ "\tSIMD\tfloat\t", SectionTimer::unit, ITERATIONS)
+		#define TIMER(unit) SectionTimer timer(__FILE__ "\tSIMD\tfloat\t", SectionTimer::Unit::unit, ITERATIONS)
 	#else
-		#define TIMER(unit) SectionTimer timer(__FILE__ "\tSIMD\tdouble\t", SectionTimer::unit, ITERATIONS)
+		#define TIMER(unit) SectionTimer timer(__FILE__ "\tSIMD\tdouble\t", SectionTimer::Unit::unit, ITERATIONS)
 	#endif
 #endif
 